@@ -0,0 +1,202 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Thread pool processing images in row bands, shared by all grabbers of the process
+ */
+
+#include "BandPool.h"
+
+#include <algorithm>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+#include <log4cpp/Category.hh>
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+namespace Ubitrack { namespace Drivers {
+
+struct BandPool::Job
+{
+	const BandFunction* pFunction;
+	int rows;
+	int bandRows;
+	int bands;
+
+	/** next band to be taken */
+	boost::atomic< int > next;
+
+	/** bands done and threads working on the job, protected by m_mutex */
+	int finished;
+	int users;
+};
+
+
+boost::shared_ptr< BandPool > BandPool::get( int threads )
+{
+	static boost::mutex s_mutex;
+	static boost::weak_ptr< BandPool > s_pool;
+
+	boost::mutex::scoped_lock l( s_mutex );
+	boost::shared_ptr< BandPool > pPool = s_pool.lock();
+	if ( !pPool )
+	{
+		pPool.reset( new BandPool );
+		s_pool = pPool;
+	}
+	pPool->reserve( threads );
+	return pPool;
+}
+
+
+BandPool::BandPool()
+	: m_bStop( false )
+{
+}
+
+
+BandPool::~BandPool()
+{
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		m_bStop = true;
+	}
+	m_workCond.notify_all();
+	for ( std::size_t i = 0; i < m_threads.size(); i++ )
+		m_threads[ i ]->join();
+}
+
+
+int BandPool::threads() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	return int( m_threads.size() );
+}
+
+
+void BandPool::reserve( int threads )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( int( m_threads.size() ) >= threads )
+		return;
+
+	LOG4CPP_INFO( logger, "Band processing with " << threads << " threads" );
+	while ( int( m_threads.size() ) < threads )
+		m_threads.push_back( boost::shared_ptr< boost::thread >( new boost::thread( boost::bind( &BandPool::workerThread, this ) ) ) );
+}
+
+
+void BandPool::run( int rows, int bands, int alignment, const BandFunction& function )
+{
+	if ( rows <= 0 )
+		return;
+
+	Job job;
+	job.pFunction = &function;
+	job.rows = rows;
+	job.bandRows = ( rows + std::max( bands, 1 ) - 1 ) / std::max( bands, 1 );
+	if ( alignment > 1 )
+		job.bandRows = ( job.bandRows + alignment - 1 ) / alignment * alignment;
+	job.bands = ( rows + job.bandRows - 1 ) / job.bandRows;
+	job.next = 0;
+	job.finished = 0;
+	job.users = 0;
+
+	if ( job.bands == 1 )
+	{
+		function( cv::Range( 0, rows ) );
+		return;
+	}
+
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		if ( !m_threads.empty() )
+			m_jobs.push_back( &job );
+	}
+	m_workCond.notify_all();
+
+	int done = work( job );
+
+	// the job must not be in the queue anymore when it goes out of scope
+	boost::mutex::scoped_lock l( m_mutex );
+	job.finished += done;
+	std::deque< Job* >::iterator it = std::find( m_jobs.begin(), m_jobs.end(), &job );
+	if ( it != m_jobs.end() )
+		m_jobs.erase( it );
+	while ( job.finished < job.bands || job.users > 0 )
+		m_doneCond.wait( l );
+}
+
+
+int BandPool::work( Job& job )
+{
+	int done = 0;
+	for ( int band = job.next++; band < job.bands; band = job.next++ )
+	{
+		cv::Range rows( band * job.bandRows, std::min( job.rows, ( band + 1 ) * job.bandRows ) );
+		try
+		{
+			( *job.pFunction )( rows );
+		}
+		catch ( const std::exception& e )
+		{
+			LOG4CPP_ERROR( logger, "Processing rows " << rows.start << "-" << rows.end << " failed: " << e.what() );
+		}
+		done++;
+	}
+	return done;
+}
+
+
+void BandPool::workerThread()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	for ( ; ; )
+	{
+		while ( !m_bStop && m_jobs.empty() )
+			m_workCond.wait( l );
+		if ( m_bStop )
+			return;
+
+		// a job whose bands have all been taken leaves the queue, its remaining bands are in progress
+		Job* pJob = m_jobs.front();
+		if ( pJob->next >= pJob->bands )
+		{
+			m_jobs.pop_front();
+			continue;
+		}
+
+		pJob->users++;
+		l.unlock();
+		int done = work( *pJob );
+		l.lock();
+		pJob->finished += done;
+		pJob->users--;
+		if ( pJob->finished == pJob->bands && pJob->users == 0 )
+			m_doneCond.notify_all();
+	}
+}
+
+} } // namespace Ubitrack::Drivers
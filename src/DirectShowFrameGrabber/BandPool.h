@@ -0,0 +1,110 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Thread pool processing images in row bands, shared by all grabbers of the process
+ */
+
+#ifndef __UBITRACK_DRIVERS_BANDPOOL_H_INCLUDED__
+#define __UBITRACK_DRIVERS_BANDPOOL_H_INCLUDED__
+
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <opencv2/core/core.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Splits image operations into bands of rows and processes the bands in parallel.
+ *
+ * Every call of \c run queues a job, and idle threads take bands of the oldest job that still has
+ * some, so the threads go where the work is when several grabbers process frames at the same time.
+ * The calling thread works on its own job as well and only waits for the bands taken by other
+ * threads, so a pool without threads processes the bands sequentially.
+ *
+ * All methods are thread-safe.
+ */
+class BandPool
+	: private boost::noncopyable
+{
+public:
+
+	/** processes the given rows of an image */
+	typedef boost::function< void ( const cv::Range& rows ) > BandFunction;
+
+	/**
+	 * the pool of the process, with at least \c threads threads. The pool is shared, so it has as many
+	 * threads as the largest request, and lives as long as a component uses it.
+	 */
+	static boost::shared_ptr< BandPool > get( int threads );
+
+	/** stops the threads */
+	~BandPool();
+
+	/** number of threads, not counting the callers of \c run */
+	int threads() const;
+
+	/**
+	 * processes \c rows rows in \c bands bands and returns when all are done. The band heights are
+	 * multiples of \c alignment, e.g. 2 for the chroma rows of NV12. Exceptions of \c function are
+	 * logged, the band is then left as it is.
+	 */
+	void run( int rows, int bands, int alignment, const BandFunction& function );
+
+protected:
+
+	BandPool();
+
+	/** adds threads until there are \c threads */
+	void reserve( int threads );
+
+	struct Job;
+
+	/** processes bands of a job until none is left, returns how many */
+	static int work( Job& job );
+
+	/** thread method */
+	void workerThread();
+
+	mutable boost::mutex m_mutex;
+	boost::condition_variable m_workCond;
+	boost::condition_variable m_doneCond;
+
+	/** jobs that may have bands left, oldest first */
+	std::deque< Job* > m_jobs;
+
+	std::vector< boost::shared_ptr< boost::thread > > m_threads;
+	bool m_bStop;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Camera parameters and automatic exposure control
+ */
+
+#include "CameraControl.h"
+
+#include <cmath>
+
+namespace Ubitrack { namespace Drivers {
+
+/** brightness ratio to the target tolerated before exposure or gain are changed, more than one exposure step apart */
+static const double LUMA_TOLERANCE = 1.5;
+
+/** weight of a new frame in the smoothed brightness */
+static const double LUMA_WEIGHT = 0.3;
+
+/** frames ignored after a change until the camera has applied it */
+static const int SETTLE_FRAMES = 4;
+
+/** the gain moves in steps of this fraction of its range */
+static const long GAIN_STEPS = 16;
+
+
+const char* cameraParameterName( CameraParameter parameter )
+{
+	switch ( parameter )
+	{
+	case PARAM_EXPOSURE: return "exposure";
+	case PARAM_GAIN: return "gain";
+	case PARAM_BRIGHTNESS: return "brightness";
+	case PARAM_CONTRAST: return "contrast";
+	case PARAM_SATURATION: return "saturation";
+	case PARAM_SHARPNESS: return "sharpness";
+	case PARAM_GAMMA: return "gamma";
+	case PARAM_WHITEBALANCE: return "white balance";
+	case PARAM_BACKLIGHT_COMPENSATION: return "backlight compensation";
+	case PARAM_FOCUS: return "focus";
+	default: return "?";
+	}
+}
+
+
+long exposureFromMilliseconds( double ms )
+{
+	return long( std::floor( std::log( ms * 1e-3 ) / std::log( 2.0 ) ) );
+}
+
+
+ExposureController::ExposureController()
+	: m_bConfigured( false )
+	, m_bSuspended( false )
+	, m_targetLuma( 0 )
+	, m_minExposure( 0 )
+	, m_maxExposure( 0 )
+	, m_minGain( 0 )
+	, m_maxGain( 0 )
+	, m_gainStep( 1 )
+	, m_exposure( 0 )
+	, m_gain( 0 )
+	, m_luma( -1 )
+	, m_settleFrames( 0 )
+{
+}
+
+
+void ExposureController::configure( double targetLuma, long minExposure, long maxExposure, long minGain, long maxGain, long gainStep )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_bConfigured = targetLuma > 0 && maxExposure >= minExposure;
+	m_targetLuma = targetLuma;
+	m_minExposure = minExposure;
+	m_maxExposure = maxExposure;
+	m_minGain = minGain;
+	m_maxGain = maxGain > minGain ? maxGain : minGain;
+
+	m_gainStep = ( m_maxGain - m_minGain ) / GAIN_STEPS;
+	if ( m_gainStep < gainStep )
+		m_gainStep = gainStep;
+	if ( m_gainStep < 1 )
+		m_gainStep = 1;
+}
+
+
+bool ExposureController::enabled() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	return m_bConfigured && !m_bSuspended;
+}
+
+
+void ExposureController::suspend( bool bSuspended )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_bSuspended = bSuspended;
+	m_luma = -1;
+	m_settleFrames = SETTLE_FRAMES;
+}
+
+
+void ExposureController::setCurrent( long exposure, long gain )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_exposure = exposure;
+	m_gain = gain;
+}
+
+
+bool ExposureController::update( double meanLuma, long& exposure, long& gain )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( !m_bConfigured || m_bSuspended )
+		return false;
+
+	if ( m_settleFrames > 0 )
+	{
+		m_settleFrames--;
+		return false;
+	}
+
+	m_luma = m_luma < 0 ? meanLuma : LUMA_WEIGHT * meanLuma + ( 1 - LUMA_WEIGHT ) * m_luma;
+	double ratio = m_targetLuma / ( m_luma > 1.0 ? m_luma : 1.0 );
+
+	long newExposure = m_exposure;
+	long newGain = m_gain;
+	if ( ratio > LUMA_TOLERANCE )
+	{
+		// too dark: longer exposure up to the bound, then more gain
+		if ( m_exposure < m_maxExposure )
+			newExposure = m_exposure < m_minExposure ? m_minExposure : m_exposure + 1;
+		else if ( m_gain < m_maxGain )
+			newGain = m_gain + m_gainStep < m_maxGain ? m_gain + m_gainStep : m_maxGain;
+	}
+	else if ( ratio < 1.0 / LUMA_TOLERANCE )
+	{
+		// too bright: less gain first, then shorter exposure
+		if ( m_gain > m_minGain )
+			newGain = m_gain - m_gainStep > m_minGain ? m_gain - m_gainStep : m_minGain;
+		else if ( m_exposure > m_minExposure )
+			newExposure = m_exposure > m_maxExposure ? m_maxExposure : m_exposure - 1;
+	}
+
+	// an exposure above the bound, e.g. left by the camera's own auto exposure, is corrected right away
+	if ( newExposure > m_maxExposure )
+		newExposure = m_maxExposure;
+
+	if ( newExposure == m_exposure && newGain == m_gain )
+		return false;
+
+	m_exposure = exposure = newExposure;
+	m_gain = gain = newGain;
+	m_luma = -1;
+	m_settleFrames = SETTLE_FRAMES;
+	return true;
+}
+
+} } // namespace Ubitrack::Drivers
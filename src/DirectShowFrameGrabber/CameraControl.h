@@ -0,0 +1,126 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Camera parameters and automatic exposure control
+ */
+
+#ifndef __UBITRACK_DRIVERS_CAMERACONTROL_H_INCLUDED__
+#define __UBITRACK_DRIVERS_CAMERACONTROL_H_INCLUDED__
+
+#include <string>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+/** camera parameters that can be changed while capturing, the values are used by the \c CameraControl port */
+enum CameraParameter
+{
+	PARAM_EXPOSURE,
+	PARAM_GAIN,
+	PARAM_BRIGHTNESS,
+	PARAM_CONTRAST,
+	PARAM_SATURATION,
+	PARAM_SHARPNESS,
+	PARAM_GAMMA,
+	PARAM_WHITEBALANCE,
+	PARAM_BACKLIGHT_COMPENSATION,
+	PARAM_FOCUS,
+	PARAM_COUNT
+};
+
+/** human readable name of a camera parameter */
+const char* cameraParameterName( CameraParameter parameter );
+
+/** DirectShow exposure value (log2 of seconds) of the longest exposure not exceeding \c ms milliseconds */
+long exposureFromMilliseconds( double ms );
+
+/**
+ * Software auto exposure driven by the mean brightness of the frames.
+ *
+ * Unlike the auto exposure of most webcams, which lengthens the exposure until the image is bright
+ * enough, the exposure is bounded so that motion blur and the shutter latency stay within the
+ * tracking budget. When the exposure is at its bound the gain is raised instead, and when the image
+ * is too bright the gain is lowered first to keep the noise down.
+ *
+ * Exposure values are log2 of seconds as used by DirectShow, so every exposure step doubles or halves
+ * the brightness. After each change the controller waits for a few frames, since cameras take some
+ * frames until new settings show in the images.
+ *
+ * All methods are thread-safe.
+ */
+class ExposureController
+	: private boost::noncopyable
+{
+public:
+
+	ExposureController();
+
+	/** enables the controller with a target mean brightness (0-255) and the ranges it may use */
+	void configure( double targetLuma, long minExposure, long maxExposure, long minGain, long maxGain, long gainStep );
+
+	bool enabled() const;
+
+	/** suspends the controller while exposure or gain are set manually */
+	void suspend( bool bSuspended );
+
+	/** current settings of the camera, the starting point of the controller */
+	void setCurrent( long exposure, long gain );
+
+	/**
+	 * feeds the mean brightness of a frame.
+	 * @return true if exposure or gain should be changed to the returned values
+	 */
+	bool update( double meanLuma, long& exposure, long& gain );
+
+protected:
+
+	bool m_bConfigured;
+	bool m_bSuspended;
+
+	double m_targetLuma;
+	long m_minExposure;
+	long m_maxExposure;
+	long m_minGain;
+	long m_maxGain;
+	long m_gainStep;
+
+	long m_exposure;
+	long m_gain;
+
+	/** smoothed brightness, negative until the first frame */
+	double m_luma;
+
+	/** frames to wait until the last change has taken effect */
+	int m_settleFrames;
+
+	mutable boost::mutex m_mutex;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Measuring the capture modes of a camera, for choosing its configuration
+ */
+
+#include "CaptureProbe.h"
+
+#include <cmath>
+#include <fstream>
+
+#include <utUtil/CleanWindows.h>
+#include <utMeasurement/Measurement.h>
+#include <log4cpp/Category.hh>
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+namespace Ubitrack { namespace Drivers {
+
+/** first line of a report, changed whenever the format changes */
+static const char* REPORT_HEADER = "# DirectShowFrameGrabber probe report 1";
+
+/** user and kernel time of all threads of the process in 100ns units */
+static unsigned long long processCPUTime()
+{
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if ( !GetProcessTimes( GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime ) )
+		return 0;
+	return ( ( (unsigned long long)kernelTime.dwHighDateTime << 32 ) | kernelTime.dwLowDateTime ) +
+		( ( (unsigned long long)userTime.dwHighDateTime << 32 ) | userTime.dwLowDateTime );
+}
+
+
+CaptureProbe::CaptureProbe()
+	: m_active( false )
+	, m_start( 0 )
+	, m_startCPU( 0 )
+	, m_arrivals( 0 )
+	, m_lastArrival( 0 )
+	, m_intervalSum( 0 )
+	, m_intervalSquares( 0 )
+	, m_processed( 0 )
+	, m_latencySum( 0 )
+	, m_maxLatency( 0 )
+{
+}
+
+
+void CaptureProbe::begin()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_start = Measurement::now();
+	m_startCPU = processCPUTime();
+	m_arrivals = 0;
+	m_lastArrival = 0;
+	m_intervalSum = 0;
+	m_intervalSquares = 0;
+	m_processed = 0;
+	m_latencySum = 0;
+	m_maxLatency = 0;
+	m_active = true;
+}
+
+
+void CaptureProbe::sampleArrived( Measurement::Timestamp now )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( !m_active )
+		return;
+
+	if ( m_lastArrival && now > m_lastArrival )
+	{
+		double interval = double( now - m_lastArrival );
+		m_intervalSum += interval;
+		m_intervalSquares += interval * interval;
+	}
+	m_lastArrival = now;
+	m_arrivals++;
+}
+
+
+void CaptureProbe::frameProcessed( Measurement::Timestamp latency )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( !m_active )
+		return;
+
+	m_processed++;
+	m_latencySum += double( latency );
+	if ( latency > m_maxLatency )
+		m_maxLatency = latency;
+}
+
+
+void CaptureProbe::end( ProbeResult& result )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_active = false;
+
+	double duration = double( Measurement::now() - m_start );
+	unsigned long long cpuTime = processCPUTime() - m_startCPU;
+
+	result.frames = m_processed;
+	result.frameRate = duration > 0 ? m_arrivals * 1e9 / duration : 0;
+	if ( m_arrivals > 2 )
+	{
+		double n = double( m_arrivals - 1 );
+		double mean = m_intervalSum / n;
+		double variance = m_intervalSquares / n - mean * mean;
+		result.jitter = variance > 0 ? std::sqrt( variance ) * 1e-6 : 0;
+	}
+	result.cpuPerFrame = m_processed ? cpuTime * 1e-4 / m_processed : 0;
+	result.latency = m_processed ? m_latencySum * 1e-6 / m_processed : 0;
+	result.maxLatency = m_maxLatency * 1e-6;
+}
+
+
+ProbeGoal probeGoalFromName( const std::string& name )
+{
+	if ( name == "throughput" )
+		return PROBE_THROUGHPUT;
+	if ( name == "latency" )
+		return PROBE_LATENCY;
+	return PROBE_REPORT;
+}
+
+
+/** true if \c a is better than \c b for the goal */
+static bool betterProbeResult( const ProbeResult& a, const ProbeResult& b, ProbeGoal goal )
+{
+	double throughputA = a.frameRate * a.mode.width * std::abs( a.mode.height );
+	double throughputB = b.frameRate * b.mode.width * std::abs( b.mode.height );
+	if ( goal == PROBE_LATENCY )
+		return a.latency < b.latency || ( a.latency == b.latency && throughputA > throughputB );
+	return throughputA > throughputB || ( throughputA == throughputB && a.latency < b.latency );
+}
+
+
+int selectProbeResult( const std::vector< ProbeResult >& results, ProbeGoal goal, double minFrameRate, double latencyBudget,
+	bool& bConstraintsMet )
+{
+	int iBest = -1;
+	bConstraintsMet = false;
+	for ( int i = 0; i < (int)results.size(); i++ )
+	{
+		const ProbeResult& result = results[ i ];
+		if ( !result.opened || result.frames == 0 )
+			continue;
+
+		bool bMeets = ( minFrameRate <= 0 || result.frameRate >= 0.9 * minFrameRate ) &&
+			( latencyBudget <= 0 || result.latency <= latencyBudget );
+
+		// a result meeting the constraints always wins over one that does not
+		bool bBetter = iBest < 0;
+		if ( !bBetter && bMeets != bConstraintsMet )
+			bBetter = bMeets;
+		else if ( !bBetter )
+			bBetter = betterProbeResult( result, results[ iBest ], goal );
+
+		if ( bBetter )
+		{
+			iBest = i;
+			bConstraintsMet = bMeets;
+		}
+	}
+	return iBest;
+}
+
+
+void writeProbeReport( const std::string& file, const std::string& camera, const std::vector< ProbeResult >& results, int selected )
+{
+	std::ofstream out( file.c_str() );
+	out << REPORT_HEADER << std::endl;
+	out << "# mode\tindex\tformat\twidth\theight\trequested fps\topened\tframes\tfps\tjitter ms\tcpu ms/frame\tlatency ms\tmax latency ms\tselected" << std::endl;
+	out << "camera\t" << camera << std::endl;
+	for ( std::size_t i = 0; i < results.size(); i++ )
+	{
+		const ProbeResult& result = results[ i ];
+		out << "mode\t" << result.mode.index << "\t" << sampleFormatName( result.mode.format ) << "\t" << result.mode.width << "\t" <<
+			result.mode.height << "\t" << result.requestedRate << "\t" << ( result.opened ? 1 : 0 ) << "\t" << result.frames << "\t" <<
+			result.frameRate << "\t" << result.jitter << "\t" << result.cpuPerFrame << "\t" << result.latency << "\t" <<
+			result.maxLatency << "\t" << ( int( i ) == selected ? 1 : 0 ) << std::endl;
+	}
+
+	if ( !out )
+		LOG4CPP_WARN( logger, "Unable to write the probe report " << file );
+	else
+		LOG4CPP_INFO( logger, "Wrote the probe report of " << results.size() << " capture modes to " << file );
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,160 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Measuring the capture modes of a camera, for choosing its configuration
+ */
+
+#ifndef __UBITRACK_DRIVERS_CAPTUREPROBE_H_INCLUDED__
+#define __UBITRACK_DRIVERS_CAPTUREPROBE_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <utMeasurement/Timestamp.h>
+
+#include "DeviceCache.h"
+
+namespace Ubitrack { namespace Drivers {
+
+/** measurements of one capture mode */
+struct ProbeResult
+{
+	ProbeResult()
+		: requestedRate( 0 )
+		, opened( false )
+		, frames( 0 )
+		, frameRate( 0 )
+		, jitter( 0 )
+		, cpuPerFrame( 0 )
+		, latency( 0 )
+		, maxLatency( 0 )
+	{}
+
+	CaptureMode mode;
+
+	/** frame rate the mode was configured with */
+	double requestedRate;
+
+	/** false if the mode could not be opened, all measurements are 0 then */
+	bool opened;
+
+	/** number of processed frames */
+	unsigned long frames;
+
+	/** rate of the sample callbacks in frames per second */
+	double frameRate;
+
+	/** standard deviation of the intervals between sample callbacks in ms */
+	double jitter;
+
+	/** CPU time of the process (all threads) per processed frame in ms */
+	double cpuPerFrame;
+
+	/** mean and maximum time from capture to the end of processing in ms */
+	double latency;
+	double maxLatency;
+};
+
+/**
+ * Collects the measurements of the capture mode that is currently running.
+ *
+ * The grabber reports every sample callback and every processed frame while a measurement is active,
+ * the CPU time is taken from the process times at the beginning and the end of the measurement.
+ *
+ * All methods are thread-safe.
+ */
+class CaptureProbe
+	: private boost::noncopyable
+{
+public:
+
+	CaptureProbe();
+
+	bool active() const
+	{ return m_active.load(); }
+
+	/** starts a measurement */
+	void begin();
+
+	/** a sample callback of the streaming thread at time \c now */
+	void sampleArrived( Measurement::Timestamp now );
+
+	/** a frame has been processed, \c latency in nanoseconds since capture */
+	void frameProcessed( Measurement::Timestamp latency );
+
+	/** ends the measurement and fills in the measured values of \c result */
+	void end( ProbeResult& result );
+
+protected:
+
+	boost::atomic< bool > m_active;
+
+	Measurement::Timestamp m_start;
+	unsigned long long m_startCPU;
+
+	unsigned long m_arrivals;
+	Measurement::Timestamp m_lastArrival;
+	double m_intervalSum;
+	double m_intervalSquares;
+
+	unsigned long m_processed;
+	double m_latencySum;
+	Measurement::Timestamp m_maxLatency;
+
+	boost::mutex m_mutex;
+};
+
+/** what the automatic configuration optimizes */
+enum ProbeGoal
+{
+	PROBE_REPORT,      ///< only write the report, keep the configured mode
+	PROBE_THROUGHPUT,  ///< most pixels per second
+	PROBE_LATENCY      ///< lowest mean latency
+};
+
+/** goal with the given attribute name (report, throughput, latency) */
+ProbeGoal probeGoalFromName( const std::string& name );
+
+/**
+ * selects the best result for \c goal among those that reach 90% of \c minFrameRate and stay within
+ * \c latencyBudget (ms), ignoring constraints that are 0. If no result meets the constraints, the best
+ * of all measured results is selected and \c bConstraintsMet is false.
+ * @return the position in \c results, -1 if no mode delivered frames
+ */
+int selectProbeResult( const std::vector< ProbeResult >& results, ProbeGoal goal, double minFrameRate, double latencyBudget,
+	bool& bConstraintsMet );
+
+/**
+ * writes the results as a tab separated table, with the line of the \c selected result (-1 for none)
+ * marked, see the documentation of the probeReport attribute.
+ */
+void writeProbeReport( const std::string& file, const std::string& camera, const std::vector< ProbeResult >& results, int selected );
+
+} } // namespace Ubitrack::Drivers
+
+#endif
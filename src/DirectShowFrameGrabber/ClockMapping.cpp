@@ -0,0 +1,124 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Drift-corrected mapping of a device reference clock to the local clock
+ */
+
+#include "ClockMapping.h"
+
+#include <cmath>
+
+namespace Ubitrack { namespace Drivers {
+
+/** minimum spread of the reference times (s) before the slope is trusted */
+static const double MIN_SPREAD = 1.0;
+
+
+ClockMapping::ClockMapping( double forgetting )
+	: m_forgetting( forgetting )
+{
+	reset();
+}
+
+
+void ClockMapping::reset()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_bValid = false;
+	m_referenceOrigin = 0;
+	m_localOrigin = 0;
+	m_sw = m_sx = m_sy = m_sxx = m_sxy = 0;
+}
+
+
+void ClockMapping::addPair( long long reference, Measurement::Timestamp local )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( !m_bValid )
+	{
+		m_bValid = true;
+		m_referenceOrigin = reference;
+		m_localOrigin = local;
+	}
+
+	// seconds relative to the origin keep the sums well conditioned
+	double x = ( reference - m_referenceOrigin ) * 1e-7;
+	double y = double( (long long)( local - m_localOrigin ) ) * 1e-9;
+
+	m_sw = m_forgetting * m_sw + 1.0;
+	m_sx = m_forgetting * m_sx + x;
+	m_sy = m_forgetting * m_sy + y;
+	m_sxx = m_forgetting * m_sxx + x * x;
+	m_sxy = m_forgetting * m_sxy + x * y;
+}
+
+
+void ClockMapping::fit( double& slope, double& intercept ) const
+{
+	slope = 1.0;
+	if ( m_sw <= 0 )
+	{
+		intercept = 0;
+		return;
+	}
+
+	double meanX = m_sx / m_sw;
+	double meanY = m_sy / m_sw;
+	double varX = m_sxx / m_sw - meanX * meanX;
+	if ( varX > MIN_SPREAD * MIN_SPREAD )
+		slope = ( m_sxy / m_sw - meanX * meanY ) / varX;
+	intercept = meanY - slope * meanX;
+}
+
+
+bool ClockMapping::valid() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	return m_bValid;
+}
+
+
+Measurement::Timestamp ClockMapping::toLocal( long long reference ) const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	double slope, intercept;
+	fit( slope, intercept );
+
+	double x = ( reference - m_referenceOrigin ) * 1e-7;
+	// the offset is added as an integer, a double does not hold absolute timestamps to the nanosecond
+	return m_localOrigin + (long long)( std::floor( ( slope * x + intercept ) * 1e9 + 0.5 ) );
+}
+
+
+double ClockMapping::drift() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	double slope, intercept;
+	fit( slope, intercept );
+	return ( slope - 1.0 ) * 1e6;
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,95 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Drift-corrected mapping of a device reference clock to the local clock
+ */
+
+#ifndef __UBITRACK_DRIVERS_CLOCKMAPPING_H_INCLUDED__
+#define __UBITRACK_DRIVERS_CLOCKMAPPING_H_INCLUDED__
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <utMeasurement/Timestamp.h>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Linear mapping from a reference clock (e.g. the DirectShow graph clock) to Measurement::now().
+ *
+ * Pairs of reference and local times that were read at the same moment are fitted with an
+ * exponentially weighted least squares line, so that both the offset and the relative drift of
+ * the clocks follow slow changes but the jitter of single readings is averaged out. Until enough
+ * pairs have been collected for a slope, the clocks are assumed to run at the same rate.
+ *
+ * All methods are thread-safe.
+ */
+class ClockMapping
+	: private boost::noncopyable
+{
+public:
+
+	/** @param forgetting weight of the old pairs after each new pair (0..1) */
+	ClockMapping( double forgetting = 0.999 );
+
+	/** adds a pair of simultaneous readings, \c reference in 100ns units */
+	void addPair( long long reference, Measurement::Timestamp local );
+
+	/** true if at least one pair has been added */
+	bool valid() const;
+
+	/** local time of a reference time given in 100ns units */
+	Measurement::Timestamp toLocal( long long reference ) const;
+
+	/** relative rate difference of the clocks in parts per million */
+	double drift() const;
+
+	/** forgets all pairs, e.g. after the reference clock has been replaced */
+	void reset();
+
+protected:
+
+	/** fitted line, relative to the first pair */
+	void fit( double& slope, double& intercept ) const;
+
+	double m_forgetting;
+
+	bool m_bValid;
+	long long m_referenceOrigin;
+	Measurement::Timestamp m_localOrigin;
+
+	// weighted sums of x = reference (s), y = local (s) since the origin
+	double m_sw;
+	double m_sx;
+	double m_sy;
+	double m_sxx;
+	double m_sxy;
+
+	mutable boost::mutex m_mutex;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Sharing of hardware decoded D3D11 textures with the OpenCL context of the image processing
+ */
+
+#include "D3D11Sharing.h"
+
+#include <string>
+#include <vector>
+
+#include <d3d11.h>
+#ifdef HAVE_OPENCL_D3D11_SHARING
+#include <CL/cl.h>
+#include <CL/cl_d3d11.h>
+#endif
+
+#include <opencv2/core/ocl.hpp>
+#include <log4cpp/Category.hh>
+
+#include "AutoComPtr.h"
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+namespace Ubitrack { namespace Drivers {
+
+#ifdef HAVE_OPENCL_D3D11_SHARING
+
+/** D3D11 device the OpenCL context was created for, 0 if none */
+static ID3D11Device* contextD3D11Device( cl_context context )
+{
+	size_t size = 0;
+	if ( clGetContextInfo( context, CL_CONTEXT_PROPERTIES, 0, 0, &size ) != CL_SUCCESS || size == 0 )
+		return 0;
+
+	std::vector< cl_context_properties > properties( size / sizeof( cl_context_properties ) );
+	if ( clGetContextInfo( context, CL_CONTEXT_PROPERTIES, size, &properties[ 0 ], 0 ) != CL_SUCCESS )
+		return 0;
+
+	for ( std::size_t i = 0; i + 1 < properties.size() && properties[ i ] != 0; i += 2 )
+		if ( properties[ i ] == CL_CONTEXT_D3D11_DEVICE_KHR )
+			return reinterpret_cast< ID3D11Device* >( properties[ i + 1 ] );
+	return 0;
+}
+
+#endif
+
+D3D11Sharing::D3D11Sharing()
+	: m_pDevice( 0 )
+	, m_createFromTexture( 0 )
+	, m_acquireObjects( 0 )
+	, m_releaseObjects( 0 )
+{
+#ifdef HAVE_OPENCL_D3D11_SHARING
+	if ( !cv::ocl::useOpenCL() )
+		return;
+
+	cl_context context = (cl_context)cv::ocl::Context::getDefault( false ).ptr();
+	if ( !context )
+		return;
+
+	ID3D11Device* pDevice = contextD3D11Device( context );
+	if ( !pDevice )
+	{
+		LOG4CPP_INFO( logger, "The OpenCL context was not created for a D3D11 device, decoded frames are read back to host memory" );
+		return;
+	}
+
+	// the decoder needs a device with video support
+	AutoComPtr< ID3D11VideoDevice > pVideoDevice;
+	if ( FAILED( pDevice->QueryInterface( __uuidof( ID3D11VideoDevice ), (void**)&pVideoDevice.p ) ) )
+	{
+		LOG4CPP_INFO( logger, "The D3D11 device of the OpenCL context has no video support, decoded frames are read back to host memory" );
+		return;
+	}
+
+	cl_device_id device;
+	cl_platform_id platform;
+	if ( clGetContextInfo( context, CL_CONTEXT_DEVICES, sizeof( device ), &device, 0 ) != CL_SUCCESS || 
+		clGetDeviceInfo( device, CL_DEVICE_PLATFORM, sizeof( platform ), &platform, 0 ) != CL_SUCCESS )
+		return;
+
+	size_t size = 0;
+	clGetDeviceInfo( device, CL_DEVICE_EXTENSIONS, 0, 0, &size );
+	std::string extensions( size, '\0' );
+	if ( size == 0 || clGetDeviceInfo( device, CL_DEVICE_EXTENSIONS, size, &extensions[ 0 ], 0 ) != CL_SUCCESS || 
+		extensions.find( "cl_khr_d3d11_sharing" ) == std::string::npos )
+	{
+		LOG4CPP_INFO( logger, "OpenCL device does not support cl_khr_d3d11_sharing, decoded frames are read back to host memory" );
+		return;
+	}
+
+	m_createFromTexture = clGetExtensionFunctionAddressForPlatform( platform, "clCreateFromD3D11Texture2DKHR" );
+	m_acquireObjects = clGetExtensionFunctionAddressForPlatform( platform, "clEnqueueAcquireD3D11ObjectsKHR" );
+	m_releaseObjects = clGetExtensionFunctionAddressForPlatform( platform, "clEnqueueReleaseD3D11ObjectsKHR" );
+	if ( !m_createFromTexture || !m_acquireObjects || !m_releaseObjects )
+		return;
+
+	m_pDevice = pDevice;
+	LOG4CPP_INFO( logger, "Sharing decoded D3D11 textures with OpenCL" );
+#else
+	LOG4CPP_INFO( logger, "Built without D3D11 sharing, decoded frames are read back to host memory" );
+#endif
+}
+
+
+bool D3D11Sharing::copyNV12( ID3D11Texture2D* pTexture, unsigned subresource, cv::UMat& sample )
+{
+#ifdef HAVE_OPENCL_D3D11_SHARING
+	if ( !m_pDevice || !pTexture )
+		return false;
+
+	D3D11_TEXTURE2D_DESC desc;
+	pTexture->GetDesc( &desc );
+	const std::size_t width = sample.cols;
+	const std::size_t height = sample.rows * 2 / 3;
+	if ( desc.Format != DXGI_FORMAT_NV12 || !sample.isContinuous() || sample.type() != CV_8UC1 ||
+		desc.Width < width || desc.Height < height )
+		return false;
+
+	clCreateFromD3D11Texture2DKHR_fn createFromTexture = (clCreateFromD3D11Texture2DKHR_fn)m_createFromTexture;
+	clEnqueueAcquireD3D11ObjectsKHR_fn acquireObjects = (clEnqueueAcquireD3D11ObjectsKHR_fn)m_acquireObjects;
+	clEnqueueReleaseD3D11ObjectsKHR_fn releaseObjects = (clEnqueueReleaseD3D11ObjectsKHR_fn)m_releaseObjects;
+
+	cl_context context = (cl_context)cv::ocl::Context::getDefault().ptr();
+	cl_command_queue queue = (cl_command_queue)cv::ocl::Queue::getDefault().ptr();
+
+	// the planes of an NV12 texture are shared as separate images: the luma plane (R8) by the
+	// subresource itself, the interleaved chroma plane (R8G8, half size) by the subresource of plane 1
+	cl_int err;
+	cl_mem planes[ 2 ];
+	planes[ 0 ] = createFromTexture( context, CL_MEM_READ_ONLY, pTexture, subresource, &err );
+	if ( err != CL_SUCCESS )
+		return false;
+	planes[ 1 ] = createFromTexture( context, CL_MEM_READ_ONLY, pTexture, subresource + desc.MipLevels * desc.ArraySize, &err );
+	if ( err != CL_SUCCESS )
+	{
+		clReleaseMemObject( planes[ 0 ] );
+		return false;
+	}
+
+	// the sample buffer has the layout of a wrapped NV12 sample: luma rows followed by the chroma rows
+	cl_mem target = (cl_mem)sample.handle( cv::ACCESS_WRITE );
+	const size_t origin[ 3 ] = { 0, 0, 0 };
+	const size_t lumaRegion[ 3 ] = { width, height, 1 };
+	const size_t chromaRegion[ 3 ] = { width / 2, height / 2, 1 };
+
+	err = acquireObjects( queue, 2, planes, 0, 0, 0 );
+	if ( err == CL_SUCCESS )
+	{
+		err = clEnqueueCopyImageToBuffer( queue, planes[ 0 ], target, origin, lumaRegion, sample.offset, 0, 0, 0 );
+		if ( err == CL_SUCCESS )
+			err = clEnqueueCopyImageToBuffer( queue, planes[ 1 ], target, origin, chromaRegion, sample.offset + width * height, 0, 0, 0 );
+
+		// the decoder reuses the texture as soon as the sample is returned to it
+		cl_event released = 0;
+		cl_int releaseErr = releaseObjects( queue, 2, planes, 0, 0, &released );
+		if ( releaseErr == CL_SUCCESS )
+		{
+			clWaitForEvents( 1, &released );
+			clReleaseEvent( released );
+		}
+		else if ( err == CL_SUCCESS )
+			err = releaseErr;
+	}
+
+	clReleaseMemObject( planes[ 1 ] );
+	clReleaseMemObject( planes[ 0 ] );
+	return err == CL_SUCCESS;
+#else
+	return false;
+#endif
+}
+
+} } // namespace Ubitrack::Drivers
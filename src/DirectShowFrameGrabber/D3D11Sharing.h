@@ -0,0 +1,87 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Sharing of hardware decoded D3D11 textures with the OpenCL context of the image processing
+ */
+
+#ifndef __UBITRACK_DRIVERS_D3D11SHARING_H_INCLUDED__
+#define __UBITRACK_DRIVERS_D3D11SHARING_H_INCLUDED__
+
+#include <boost/noncopyable.hpp>
+#include <opencv2/core/core.hpp>
+
+struct ID3D11Device;
+struct ID3D11Texture2D;
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Copies D3D11 textures into OpenCL buffers with cl_khr_d3d11_sharing, so that decoded frames go from
+ * the decoder to the OpenCL kernels without a round trip through host memory.
+ *
+ * Textures can only be shared with an OpenCL context that was created for their D3D11 device. The
+ * context used by Vision::OpenCLManager (which is the default OpenCV context) is therefore inspected
+ * for its D3D11 device, and the capture backend is expected to decode on that device. Sharing is not
+ * available if the context has no D3D11 device, if the device has no video support or if the platform
+ * lacks the extension, the frames then have to take the way through host memory.
+ *
+ * Must be constructed after the OpenCL context has been initialized.
+ */
+class D3D11Sharing
+	: private boost::noncopyable
+{
+public:
+
+	D3D11Sharing();
+
+	/** true if textures of \c device() can be shared */
+	bool available() const
+	{ return m_pDevice != 0; }
+
+	/** the D3D11 device of the OpenCL context, 0 if sharing is not available */
+	ID3D11Device* device() const
+	{ return m_pDevice; }
+
+	/**
+	 * copies the top left frame of a subresource of an NV12 texture into \c sample, which must be allocated
+	 * like a wrapped NV12 sample (single channel, width x height * 3/2). Waits until the copy is done, so
+	 * that the texture can be reused by the decoder afterwards.
+	 * @return false if the texture is no NV12 texture or smaller than the frame, or the copy failed
+	 */
+	bool copyNV12( ID3D11Texture2D* pTexture, unsigned subresource, cv::UMat& sample );
+
+protected:
+
+	ID3D11Device* m_pDevice;
+
+	/** extension functions of the platform */
+	void* m_createFromTexture;
+	void* m_acquireObjects;
+	void* m_releaseObjects;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Cache of the enumerated capture devices and their capture modes
+ */
+
+#include "DeviceCache.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <log4cpp/Category.hh>
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+namespace Ubitrack { namespace Drivers {
+
+/** first line of a cache file, changed whenever the format changes */
+static const char* CACHE_HEADER = "# DirectShowFrameGrabber device cache 1";
+
+/** splits a line of the cache file at tabs */
+static std::vector< std::string > splitFields( const std::string& line )
+{
+	std::vector< std::string > fields;
+	std::string::size_type begin = 0;
+	for ( ; ; )
+	{
+		std::string::size_type end = line.find( '\t', begin );
+		fields.push_back( line.substr( begin, end == std::string::npos ? std::string::npos : end - begin ) );
+		if ( end == std::string::npos )
+			return fields;
+		begin = end + 1;
+	}
+}
+
+
+boost::shared_ptr< DeviceCache > DeviceCache::get( const std::string& file )
+{
+	static boost::mutex s_mutex;
+	static std::map< std::string, boost::shared_ptr< DeviceCache > > s_caches;
+
+	boost::mutex::scoped_lock l( s_mutex );
+	boost::shared_ptr< DeviceCache >& pCache = s_caches[ file ];
+	if ( !pCache )
+	{
+		pCache.reset( new DeviceCache( file ) );
+		pCache->load();
+	}
+	return pCache;
+}
+
+
+DeviceCache::DeviceCache( const std::string& file )
+	: m_file( file )
+{
+}
+
+
+bool DeviceCache::findDevice( const std::string& name, const std::string& devicePath, CachedDevice& device ) const
+{
+	if ( name.empty() )
+		return false;
+
+	boost::mutex::scoped_lock l( m_mutex );
+	for ( std::size_t i = 0; i < m_devices.size(); i++ )
+		if ( m_devices[ i ].name.find( name ) != std::string::npos && 
+			( devicePath.empty() || m_devices[ i ].devicePath.find( devicePath ) != std::string::npos ) )
+		{
+			device = m_devices[ i ];
+			return true;
+		}
+	return false;
+}
+
+
+void DeviceCache::setDevices( const std::vector< CachedDevice >& devices )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	std::vector< CachedDevice > old;
+	old.swap( m_devices );
+	m_devices = devices;
+
+	for ( std::size_t i = 0; i < m_devices.size(); i++ )
+		for ( std::size_t j = 0; j < old.size() && m_devices[ i ].capabilities == 0; j++ )
+			if ( old[ j ].devicePath == m_devices[ i ].devicePath && old[ j ].displayName == m_devices[ i ].displayName )
+			{
+				m_devices[ i ].capabilities = old[ j ].capabilities;
+				m_devices[ i ].modes = old[ j ].modes;
+			}
+
+	save();
+}
+
+
+bool DeviceCache::modes( const std::string& devicePath, int& capabilities, std::vector< CaptureMode >& modes ) const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	for ( std::size_t i = 0; i < m_devices.size(); i++ )
+		if ( m_devices[ i ].devicePath == devicePath && m_devices[ i ].capabilities > 0 )
+		{
+			capabilities = m_devices[ i ].capabilities;
+			modes = m_devices[ i ].modes;
+			return true;
+		}
+	return false;
+}
+
+
+void DeviceCache::setModes( const std::string& devicePath, int capabilities, const std::vector< CaptureMode >& modes )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	for ( std::size_t i = 0; i < m_devices.size(); i++ )
+		if ( m_devices[ i ].devicePath == devicePath )
+		{
+			m_devices[ i ].capabilities = capabilities;
+			m_devices[ i ].modes = modes;
+		}
+	save();
+}
+
+
+void DeviceCache::invalidate( const std::string& devicePath )
+{
+	setModes( devicePath, 0, std::vector< CaptureMode >() );
+}
+
+
+void DeviceCache::load()
+{
+	if ( m_file.empty() )
+		return;
+
+	std::ifstream in( m_file.c_str() );
+	std::string line;
+	if ( !in || !std::getline( in, line ) || line != CACHE_HEADER )
+	{
+		LOG4CPP_INFO( logger, "No valid device cache in " << m_file );
+		return;
+	}
+
+	while ( std::getline( in, line ) )
+	{
+		std::vector< std::string > fields = splitFields( line );
+		if ( fields[ 0 ] == "device" && fields.size() == 5 )
+		{
+			CachedDevice device;
+			device.devicePath = fields[ 1 ];
+			device.displayName = fields[ 2 ];
+			device.name = fields[ 3 ];
+			std::istringstream( fields[ 4 ] ) >> device.capabilities;
+			m_devices.push_back( device );
+		}
+		else if ( fields[ 0 ] == "mode" && fields.size() == 7 && !m_devices.empty() )
+		{
+			CaptureMode mode;
+			mode.format = sampleFormatFromName( fields[ 2 ] );
+			std::istringstream values( fields[ 1 ] + " " + fields[ 3 ] + " " + fields[ 4 ] + " " + fields[ 5 ] + " " + fields[ 6 ] );
+			if ( values >> mode.index >> mode.width >> mode.height >> mode.minInterval >> mode.maxInterval )
+				m_devices.back().modes.push_back( mode );
+		}
+		else
+		{
+			LOG4CPP_WARN( logger, "Ignoring corrupt device cache " << m_file );
+			m_devices.clear();
+			return;
+		}
+	}
+
+	LOG4CPP_INFO( logger, "Loaded " << m_devices.size() << " devices from the device cache " << m_file );
+}
+
+
+void DeviceCache::save() const
+{
+	if ( m_file.empty() )
+		return;
+
+	std::ofstream out( m_file.c_str() );
+	out << CACHE_HEADER << std::endl;
+	for ( std::size_t i = 0; i < m_devices.size(); i++ )
+	{
+		const CachedDevice& device = m_devices[ i ];
+		out << "device\t" << device.devicePath << "\t" << device.displayName << "\t" << device.name << "\t" << device.capabilities << std::endl;
+		for ( std::size_t j = 0; j < device.modes.size(); j++ )
+		{
+			const CaptureMode& mode = device.modes[ j ];
+			out << "mode\t" << mode.index << "\t" << sampleFormatName( mode.format ) << "\t" << mode.width << "\t" << 
+				mode.height << "\t" << mode.minInterval << "\t" << mode.maxInterval << std::endl;
+		}
+	}
+
+	if ( !out )
+		LOG4CPP_WARN( logger, "Unable to write the device cache " << m_file );
+}
+
+} } // namespace Ubitrack::Drivers
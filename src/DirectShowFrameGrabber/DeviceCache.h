@@ -0,0 +1,145 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Cache of the enumerated capture devices and their capture modes
+ */
+
+#ifndef __UBITRACK_DRIVERS_DEVICECACHE_H_INCLUDED__
+#define __UBITRACK_DRIVERS_DEVICECACHE_H_INCLUDED__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "SampleConversion.h"
+
+namespace Ubitrack { namespace Drivers {
+
+/** one capability of a capture pin, as reported by IAMStreamConfig::GetStreamCaps */
+struct CaptureMode
+{
+	CaptureMode()
+		: index( 0 )
+		, format( SAMPLE_UNKNOWN )
+		, width( 0 )
+		, height( 0 )
+		, minInterval( 0 )
+		, maxInterval( 0 )
+	{}
+
+	int index;
+	SampleFormat format;
+	int width;
+	int height;
+
+	/** frame interval range in 100ns units */
+	long long minInterval;
+	long long maxInterval;
+};
+
+/** a capture device found during enumeration */
+struct CachedDevice
+{
+	CachedDevice()
+		: capabilities( 0 )
+	{}
+
+	std::string devicePath;
+
+	/** moniker display name, can be bound without enumerating all devices */
+	std::string displayName;
+
+	/** description or friendly name */
+	std::string name;
+
+	/** number of capabilities reported by the capture pin, 0 if not probed yet */
+	int capabilities;
+
+	/** the video capabilities of the capture pin in the order of the driver */
+	std::vector< CaptureMode > modes;
+};
+
+/**
+ * Devices and capture modes of the last enumeration.
+ *
+ * Enumerating all video input devices and walking the capabilities of their capture pins takes
+ * seconds with several cameras, so the grabbers look up the device and its modes here first and
+ * only fall back to a full probe if the cached entry does not validate against the device. A cache
+ * is shared by all components using the same file, and written back to the file after every update.
+ * Without a file the cache only lives as long as the process, which still speeds up restarts after
+ * a reconfiguration.
+ *
+ * All methods are thread-safe.
+ */
+class DeviceCache
+	: private boost::noncopyable
+{
+public:
+
+	/** the cache stored in \c file, loaded on first use. An empty name gives a cache that is not stored. */
+	static boost::shared_ptr< DeviceCache > get( const std::string& file );
+
+	/**
+	 * finds the first device whose name contains \c name and whose device path contains \c devicePath,
+	 * with the same rules as the enumeration. An empty \c name never matches.
+	 */
+	bool findDevice( const std::string& name, const std::string& devicePath, CachedDevice& device ) const;
+
+	/** replaces the device list with the result of a new enumeration, keeping the modes of known devices */
+	void setDevices( const std::vector< CachedDevice >& devices );
+
+	/**
+	 * cached capture modes of a device and the number of capabilities they were probed from.
+	 * @return false if they are unknown
+	 */
+	bool modes( const std::string& devicePath, int& capabilities, std::vector< CaptureMode >& modes ) const;
+
+	/** stores the capture modes of a device */
+	void setModes( const std::string& devicePath, int capabilities, const std::vector< CaptureMode >& modes );
+
+	/** forgets the modes of a device whose cached entry turned out to be stale */
+	void invalidate( const std::string& devicePath );
+
+protected:
+
+	explicit DeviceCache( const std::string& file );
+
+	void load();
+	void save() const;
+
+	std::string m_file;
+	std::vector< CachedDevice > m_devices;
+
+	mutable boost::mutex m_mutex;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
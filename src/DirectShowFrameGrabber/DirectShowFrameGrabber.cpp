@@ -55,11 +55,33 @@ struct __declspec(uuid("6B652FFF-11FE-4fce-92AD-0266B5D7C78F")) ISampleGrabber;
 #endif
 
 #include "AutoComPtr.h"
+#include "FrameQueue.h"
+#include "SampleConversion.h"
+#include "ImagePool.h"
+#include "UndistortionMap.h"
+#include "FrameStatistics.h"
+#include "FramePipeline.h"
+#include "FrameScheduler.h"
+#include "ClockMapping.h"
+#include "DeviceCache.h"
+#include "CameraControl.h"
+#include "SampleRecording.h"
+#include "ReplayFrameGrabber.h"
+#include "MediaFoundationCapture.h"
+#include "D3D11Sharing.h"
+#include "ThreadSettings.h"
+#include "FrameHistory.h"
+#include "FrameBatch.h"
+#include "MotionGate.h"
+#include "CaptureProbe.h"
 
 #include <string>
 #include <list>
+#include <algorithm>
+#include <vector>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <strstream>
 #include <log4cpp/Category.hh>
 
@@ -74,6 +96,7 @@ struct __declspec(uuid("6B652FFF-11FE-4fce-92AD-0266B5D7C78F")) ISampleGrabber;
 #include <utDataflow/ComponentFactory.h>
 #include <utMeasurement/Measurement.h>
 #include <utMeasurement/TimestampSync.h>
+#include <utMath/Scalar.h>
 #include <utUtil/OS.h>
 #include <utUtil/TracingProvider.h>
 #include <opencv/cv.h>
@@ -92,808 +115,3307 @@ using namespace Ubitrack::Vision;
 
 namespace Ubitrack { namespace Drivers {
 
+/** maps a DirectShow media subtype to the corresponding sample format */
+static SampleFormat sampleFormatFromSubtype( const GUID& subtype )
+{
+	if ( subtype == MEDIASUBTYPE_RGB24 )
+		return SAMPLE_RGB24;
+	if ( subtype == MEDIASUBTYPE_YUY2 )
+		return SAMPLE_YUY2;
+	if ( subtype == MEDIASUBTYPE_NV12 )
+		return SAMPLE_NV12;
+	if ( subtype == MEDIASUBTYPE_MJPG )
+		return SAMPLE_MJPG;
+	return SAMPLE_UNKNOWN;
+}
+
+/** bitmap header and frame interval of a video media type, false for unsupported format blocks */
+static bool videoFormatInfo( const AM_MEDIA_TYPE* pMediaType, BITMAPINFOHEADER*& pHeader, REFERENCE_TIME*& pAvgTimePerFrame )
+{
+	if ( pMediaType->majortype != MEDIATYPE_Video || !pMediaType->pbFormat )
+		return false;
+
+	if ( pMediaType->formattype == FORMAT_VideoInfo && pMediaType->cbFormat >= sizeof( VIDEOINFOHEADER ) )
+	{
+		VIDEOINFOHEADER* pInfo = (VIDEOINFOHEADER*)pMediaType->pbFormat;
+		pHeader = &pInfo->bmiHeader;
+		pAvgTimePerFrame = &pInfo->AvgTimePerFrame;
+		return true;
+	}
+	if ( pMediaType->formattype == FORMAT_VideoInfo2 && pMediaType->cbFormat >= sizeof( VIDEOINFOHEADER2 ) )
+	{
+		VIDEOINFOHEADER2* pInfo = (VIDEOINFOHEADER2*)pMediaType->pbFormat;
+		pHeader = &pInfo->bmiHeader;
+		pAvgTimePerFrame = &pInfo->AvgTimePerFrame;
+		return true;
+	}
+	return false;
+}
+
+/** frees the format block and the interface held by a media type, e.g. one filled by GetConnectedMediaType */
+static void freeMediaType( AM_MEDIA_TYPE& mediaType )
+{
+	if ( mediaType.cbFormat != 0 )
+		CoTaskMemFree( mediaType.pbFormat );
+	if ( mediaType.pUnk )
+		mediaType.pUnk->Release();
+	mediaType.cbFormat = 0;
+	mediaType.pbFormat = 0;
+	mediaType.pUnk = 0;
+}
+
+/** frees a media type returned by IAMStreamConfig::GetStreamCaps */
+static void deleteMediaType( AM_MEDIA_TYPE* pMediaType )
+{
+	if ( !pMediaType )
+		return;
+	freeMediaType( *pMediaType );
+	CoTaskMemFree( pMediaType );
+}
+
+/** settings for configuring a capture device */
+struct CaptureSettings
+{
+	CaptureSettings()
+		: width( 0 )
+		, height( 0 )
+		, frameRate( 0 )
+		, pixelFormat( SAMPLE_UNKNOWN )
+		, nativeFormats( false )
+		, captureBuffers( 0 )
+		, zeroCopy( false )
+	{}
+
+	int width;
+	int height;
+	double frameRate;
+	SampleFormat pixelFormat;
+	bool nativeFormats;
+	int captureBuffers;
+	bool zeroCopy;
+};
+
+/** format of the samples delivered to the sample grabber */
+struct CaptureFormat
+{
+	SampleFormat format;
+	LONG width;
+	LONG height;
+
+	/** RGB24 rows are stored bottom-up, unless the driver accepted a negative biHeight */
+	bool bottomUp;
+};
+
+/** converts a string returned by a property bag or moniker */
+static std::string narrowString( const WCHAR* s, UINT codePage )
+{
+	char buf[ 512 ];
+	if ( !WideCharToMultiByte( codePage, 0, s, -1, buf, sizeof( buf ), 0, 0 ) )
+		return std::string();
+	return buf;
+}
+
+/** reads device path, name and display name of a device moniker, false if the device has no name */
+static bool readDeviceProperties( IMoniker* pMoniker, CachedDevice& device )
+{
+	AutoComPtr< IPropertyBag > pPropBag;
+	if ( FAILED( pMoniker->BindToStorage( 0, 0, IID_IPropertyBag, (void**)(&pPropBag.p) ) ) )
+		return false;
+
+	// Find the device of the camera.
+	VARIANT var;
+	VariantInit( &var );
+	device.devicePath.clear();
+	if ( SUCCEEDED( pPropBag->Read( L"DevicePath", &var, 0 ) ) )
+		device.devicePath = narrowString( var.bstrVal, CP_ACP );
+	VariantClear( &var );
+
+	// Find the description or friendly name.
+	HRESULT hr = pPropBag->Read( L"Description", &var, 0 );
+	if ( FAILED( hr ) )
+		hr = pPropBag->Read( L"FriendlyName", &var, 0 );
+	if ( FAILED( hr ) )
+		return false;
+	device.name = narrowString( var.bstrVal, CP_ACP );
+	VariantClear( &var );
+
+	// the display name allows binding the moniker again without enumerating
+	AutoComPtr< IBindCtx > pBindCtx;
+	LPOLESTR pDisplayName = 0;
+	device.displayName.clear();
+	if ( SUCCEEDED( CreateBindCtx( 0, &pBindCtx.p ) ) && SUCCEEDED( pMoniker->GetDisplayName( pBindCtx, NULL, &pDisplayName ) ) )
+	{
+		device.displayName = narrowString( pDisplayName, CP_UTF8 );
+		CoTaskMemFree( pDisplayName );
+	}
+	return true;
+}
+
+/** binds the moniker of a cached device, false if it is not (or no longer) the same device */
+static bool bindCachedDevice( const CachedDevice& cached, AutoComPtr< IMoniker >& pMoniker )
+{
+	WCHAR wDisplayName[ 512 ];
+	if ( cached.displayName.empty() || !MultiByteToWideChar( CP_UTF8, 0, cached.displayName.c_str(), -1, wDisplayName, 512 ) )
+		return false;
+
+	AutoComPtr< IBindCtx > pBindCtx;
+	ULONG eaten;
+	if ( FAILED( CreateBindCtx( 0, &pBindCtx.p ) ) || FAILED( MkParseDisplayName( pBindCtx, wDisplayName, &eaten, &pMoniker.p ) ) )
+		return false;
+
+	// the display name of an unplugged device may still parse, and the port may now have a different camera
+	CachedDevice device;
+	if ( !readDeviceProperties( pMoniker, device ) || device.devicePath != cached.devicePath || device.name != cached.name )
+	{
+		pMoniker.Release();
+		return false;
+	}
+	return true;
+}
+
 /**
- * @ingroup vision_components
- *
- * @par Input Ports
- * None.
- *
- * @par Output Ports
- * \c Output push port of type Ubitrack::Measurement::ImageMeasurement.
- *
- * @par Configuration
- * The configuration tag contains a \c <dsvl_input> configuration.
- * For details, see the DirectShow documentation...
- *
+ * finds a video capture device by (partial) name and device path.
+ * The device is looked up in \c cache first, all devices are only enumerated if it is not found there.
+ * Falls back to the first device if none matches, \c pSelectedMoniker stays empty if there is no device at all.
+ * \c sSelectedCamera and \c sSelectedPath are left empty for the fallback.
  */
-class DirectShowFrameGrabber
-	: public Dataflow::Component
-	, protected ISampleGrabberCB
+static void findCaptureDevice( const std::string& name, const std::string& devicePath, DeviceCache& cache,
+	AutoComPtr< IMoniker >& pSelectedMoniker, std::string& sSelectedCamera, std::string& sSelectedPath )
 {
-public:
+	CachedDevice cached;
+	if ( cache.findDevice( name, devicePath, cached ) )
+	{
+		if ( bindCachedDevice( cached, pSelectedMoniker ) )
+		{
+			LOG4CPP_INFO( logger, "Using cached capture device: " << cached.name << " device path: " << cached.devicePath );
+			sSelectedCamera = cached.name;
+			sSelectedPath = cached.devicePath;
+			return;
+		}
+		LOG4CPP_INFO( logger, "Cached capture device " << cached.name << " is not available, enumerating all devices" );
+	}
 
-	/** constructor */
-	DirectShowFrameGrabber( const std::string& sName, boost::shared_ptr< Graph::UTQLSubgraph >  );
+	// Create the System Device Enumerator.
+	AutoComPtr< ICreateDevEnum > pDevEnum;
+	AutoComPtr< IEnumMoniker > pEnum;
 
-	/** destructor, waits until thread stops */
-	~DirectShowFrameGrabber();
+	HRESULT hr = pDevEnum.CoCreateInstance( CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER );
+	if ( SUCCEEDED( hr ) )
+		// Create an enumerator for the video capture category.
+		hr = pDevEnum->CreateClassEnumerator( CLSID_VideoInputDeviceCategory, &pEnum.p, 0 );
 
-	/** starts the camera */
-	void start();
+	// all devices are enumerated for the cache, the first match is selected
+	std::vector< CachedDevice > devices;
+	AutoComPtr< IMoniker > pMoniker;
+	while ( pEnum && pEnum->Next( 1, &pMoniker.p, NULL ) == S_OK )
+	{
+		if ( !pSelectedMoniker )
+			pSelectedMoniker = pMoniker;
 
-	/** starts the capturing */
-	void startCapturing();
+		CachedDevice device;
+		if ( !readDeviceProperties( pMoniker, device ) )
+		{
+			pMoniker.Release();
+			continue;  // Skip this one, maybe the next one will work.
+		}
+		devices.push_back( device );
+		LOG4CPP_INFO( logger, "Possible capture device: " << device.name << " device path: " << device.devicePath );
 
-	/** stops the camera */
-	void stop();
+		// select device based on name
+		if ( sSelectedCamera.empty() && !name.empty() && device.name.find( name ) != std::string::npos &&
+			( devicePath.empty() || device.devicePath.find( devicePath ) != std::string::npos ) )
+		{
+			sSelectedCamera = device.name;
+			sSelectedPath = device.devicePath;
+			pSelectedMoniker = pMoniker;
+			if ( !devicePath.empty() )
+				LOG4CPP_INFO( logger, "Found device with path-identifier: " << devicePath );
+		}
 
-protected:
-	/** initializes the direct show filter graph */
-	void initGraph();
+		pMoniker.Release();
+	}
 
-	/** handles a frame after being converted to Vision::Image */
-	void handleFrame( Measurement::Timestamp utTime, Vision::Image& bufferImage );
+	cache.setDevices( devices );
+}
 
-	/** handler method for incoming pull requests */
-	Measurement::Matrix3x3 getIntrinsic( Measurement::Timestamp t )
-	{ return Measurement::Matrix3x3( t, m_undistorter->getMatrix() ); }
+/** reads all video capabilities of a capture pin */
+static void probeCaptureModes( IAMStreamConfig* pStreamConfig, int iCount, BYTE* pCapsBuffer, int iSize, std::vector< CaptureMode >& modes )
+{
+	modes.clear();
+	for ( int iCap = 0; iCap < iCount; iCap++ )
+	{
+		AM_MEDIA_TYPE *pMediaType;
+		if ( FAILED( pStreamConfig->GetStreamCaps( iCap, &pMediaType, pCapsBuffer ) ) )
+			continue;
 
-	// width of resulting image
-	LONG m_sampleWidth;
+		BITMAPINFOHEADER* pHeader;
+		REFERENCE_TIME* pAvgTimePerFrame;
+		if ( !videoFormatInfo( pMediaType, pHeader, pAvgTimePerFrame ) )
+		{
+			deleteMediaType( pMediaType );
+			continue;
+		}
 
-	// height of resulting image
-	LONG m_sampleHeight;
+		// frame interval range of this mode, not all drivers fill in the caps
+		const VIDEO_STREAM_CONFIG_CAPS* pCaps = (const VIDEO_STREAM_CONFIG_CAPS*)pCapsBuffer;
+		CaptureMode mode;
+		mode.index = iCap;
+		mode.format = sampleFormatFromSubtype( pMediaType->subtype );
+		mode.width = pHeader->biWidth;
+		mode.height = pHeader->biHeight;
+		mode.minInterval = *pAvgTimePerFrame;
+		mode.maxInterval = *pAvgTimePerFrame;
+		if ( iSize >= (int)sizeof( VIDEO_STREAM_CONFIG_CAPS ) && pCaps->MinFrameInterval > 0 )
+		{
+			mode.minInterval = pCaps->MinFrameInterval;
+			mode.maxInterval = pCaps->MaxFrameInterval > mode.minInterval ? pCaps->MaxFrameInterval : mode.minInterval;
+		}
+		modes.push_back( mode );
 
-	// shift timestamps (ms)
-	int m_timeOffset;
+		LOG4CPP_INFO( logger, "Media type " << iCap << ": fps=" << ( mode.minInterval > 0 ? 1e7 / mode.minInterval : 0 ) << 
+			( mode.maxInterval != mode.minInterval ? "-" : "" ) << ( mode.maxInterval != mode.minInterval ? 1e7 / mode.maxInterval : 0 ) <<
+			", width=" << mode.width << ", height=" << mode.height << ", type=" << sampleFormatName( mode.format ) );
 
-	// only send every nth image
-	int m_divisor;
+		deleteMediaType( pMediaType );
+	}
+}
 
-	/** desired width */
-	int m_desiredWidth;
+/**
+ * selects the capture mode with the requested size and pixel format, scored by:
+ * 1. reaches the requested frame rate, 2. throughput in pixels/s, 3. preferred pixel format.
+ * @return the position in \c modes, -1 if no mode matches
+ */
+static int selectCaptureMode( const std::vector< CaptureMode >& modes, const CaptureSettings& settings, 
+	REFERENCE_TIME& bestFrameInterval, bool& bBestReachesRate )
+{
+	int iBest = -1;
+	double fBestThroughput = 0;
+	bool bBestPreferred = false;
+	for ( int i = 0; i < (int)modes.size(); i++ )
+	{
+		const CaptureMode& mode = modes[ i ];
+		bool bSizeOk = ( settings.width <= 0 || mode.width == settings.width ) && 
+			( settings.height <= 0 || mode.height == settings.height );
+		bool bFormatOk = settings.pixelFormat == SAMPLE_UNKNOWN || mode.format == settings.pixelFormat;
+		if ( !bSizeOk || !bFormatOk )
+			continue;
+
+		// the requested rate if the mode supports it, the fastest one otherwise
+		REFERENCE_TIME frameInterval = mode.minInterval;
+		if ( settings.frameRate > 0 )
+		{
+			frameInterval = REFERENCE_TIME( 1e7 / settings.frameRate + 0.5 );
+			if ( frameInterval < mode.minInterval )
+				frameInterval = mode.minInterval;
+			if ( frameInterval > mode.maxInterval )
+				frameInterval = mode.maxInterval;
+		}
 
-	/** desired image height */
-	int m_desiredHeight;
+		double fps = frameInterval > 0 ? 1e7 / frameInterval : 0;
+		bool bReachesRate = settings.frameRate <= 0 || fps >= settings.frameRate * 0.99;
+		double fThroughput = fps * mode.width * abs( mode.height );
+		bool bPreferred = settings.nativeFormats ? ( mode.format != SAMPLE_UNKNOWN && mode.format != SAMPLE_RGB24 ) : ( mode.format == SAMPLE_RGB24 );
 
-	// desired camera name
-	std::string m_desiredName;
+		bool bBetter = iBest < 0;
+		if ( !bBetter && bReachesRate != bBestReachesRate )
+			bBetter = bReachesRate;
+		else if ( !bBetter && fThroughput != fBestThroughput )
+			bBetter = fThroughput > fBestThroughput;
+		else if ( !bBetter )
+			bBetter = bPreferred && !bBestPreferred;
 
-	// desired camera index (e.g. for multiple cameras with the same name as the Vuzix HMD)
-	std::string m_desiredDevicePath;
+		if ( bBetter )
+		{
+			iBest = i;
+			bBestReachesRate = bReachesRate;
+			fBestThroughput = fThroughput;
+			bBestPreferred = bPreferred;
+			bestFrameInterval = frameInterval;
+		}
+	}
+	return iBest;
+}
 
+/** true if a media type returned by IAMStreamConfig::GetStreamCaps still describes a cached mode */
+static bool matchesCaptureMode( const AM_MEDIA_TYPE* pMediaType, const CaptureMode& mode )
+{
+	BITMAPINFOHEADER* pHeader;
+	REFERENCE_TIME* pAvgTimePerFrame;
+	return pMediaType && videoFormatInfo( pMediaType, pHeader, pAvgTimePerFrame ) && 
+		sampleFormatFromSubtype( pMediaType->subtype ) == mode.format && 
+		pHeader->biWidth == mode.width && pHeader->biHeight == mode.height;
+}
 
-	/** exposure control */
-	int m_cameraExposure;
-	bool m_cameraExposureAuto;
+/** creates a filter graph with a capture graph builder */
+static void createCaptureGraph( AutoComPtr< IGraphBuilder >& pGraph, AutoComPtr< ICaptureGraphBuilder2 >& pBuild )
+{
+    // Create the Capture Graph Builder.
+    HRESULT hr = pBuild.CoCreateInstance( CLSID_CaptureGraphBuilder2, NULL, CLSCTX_INPROC_SERVER );
+    if ( SUCCEEDED( hr ) )
+    {
+        // Create the Filter Graph Manager.
+        hr = pGraph.CoCreateInstance( CLSID_FilterGraph, 0, CLSCTX_INPROC_SERVER );
+        if ( SUCCEEDED( hr ) )
+            // Initialize the Capture Graph Builder.
+            pBuild->SetFiltergraph( pGraph );
+        else
+			UBITRACK_THROW( "Error creating filter graph manager" );
+    }
+	else
+		UBITRACK_THROW( "Error creating capture graph builder" );
+}
+
+/**
+ * adds a capture device to the graph and connects it through a sample grabber, calling \c pCallback, to a null renderer.
+ * The capture pin is configured according to \c settings, the resulting sample format is returned in \c format.
+ * The capabilities of the pin are taken from \c cache if \c devicePath is known, and returned in \c pModes if given.
+ */
+static void addCaptureBranch( IGraphBuilder* pGraph, ICaptureGraphBuilder2* pBuild, IMoniker* pMoniker, const CaptureSettings& settings,
+	DeviceCache& cache, const std::string& devicePath, ISampleGrabberCB* pCallback, AutoComPtr< IBaseFilter >& pCaptureFilter, CaptureFormat& format,
+	std::vector< CaptureMode >* pModes = 0 )
+{
+	// create capture device filter
+	if ( FAILED( pMoniker->BindToObject( 0, 0, IID_IBaseFilter, (void**)&pCaptureFilter.p ) ) )
+		UBITRACK_THROW( "Unable to create capture filter" );
+
+	if ( FAILED( pGraph->AddFilter( pCaptureFilter, L"Capture" ) ) )
+		UBITRACK_THROW( "Unable to add capture filter" );
+
+	// find output pin for configuration
+	AutoComPtr< IPin > pPin;
+	if ( FAILED( pBuild->FindPin( pCaptureFilter, PINDIR_OUTPUT, &PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, FALSE, 0, &pPin.p ) ) )
+		UBITRACK_THROW( "Unable to find pin" );
+
+	// request enough sample buffers if they are held after SampleCB returns
+	if ( settings.captureBuffers > 0 )
+	{
+		AutoComPtr< IAMBufferNegotiation > pBufferNegotiation;
+		if ( FAILED( pPin.QueryInterface< IAMBufferNegotiation >( pBufferNegotiation ) ) )
+		{ LOG4CPP_WARN( logger, "Unable to get IAMBufferNegotiation interface, using default number of capture buffers" ); }
+		else
+		{
+			// -1 = let the pin decide
+			ALLOCATOR_PROPERTIES props;
+			props.cBuffers = settings.captureBuffers;
+			props.cbBuffer = -1;
+			props.cbAlign = -1;
+			props.cbPrefix = -1;
+			if ( FAILED( pBufferNegotiation->SuggestAllocatorProperties( &props ) ) )
+			{ LOG4CPP_WARN( logger, "Unable to request " << settings.captureBuffers << " capture buffers" ); }
+		}
+	}
+
+	// enumerate media types
+	GUID selectedSubtype = MEDIASUBTYPE_RGB24;
+	AutoComPtr< IAMStreamConfig > pStreamConfig;
+	if ( FAILED( pPin.QueryInterface< IAMStreamConfig >( pStreamConfig ) ) )
+	{ LOG4CPP_WARN( logger, "Unable to get IAMStreamConfig interface" ); }
+	else
+	{
+		int iCount, iSize;
+		pStreamConfig->GetNumberOfCapabilities( &iCount, &iSize );
+		boost::scoped_array< BYTE > buf( new BYTE[ iSize ] );
+
+		// walking all capabilities is slow with some drivers, reuse the table of the last start if the pin still has as many
+		std::vector< CaptureMode > modes;
+		int iCachedCount = 0;
+		bool bCached = !devicePath.empty() && cache.modes( devicePath, iCachedCount, modes ) && iCachedCount == iCount;
+		if ( bCached )
+			LOG4CPP_INFO( logger, "Using " << modes.size() << " cached media types" );
+		else
+		{
+			probeCaptureModes( pStreamConfig, iCount, buf.get(), iSize, modes );
+			if ( !devicePath.empty() )
+				cache.setModes( devicePath, iCount, modes );
+		}
+
+		REFERENCE_TIME bestFrameInterval = 0;
+		bool bBestReachesRate = false;
+		int iBest = selectCaptureMode( modes, settings, bestFrameInterval, bBestReachesRate );
+		AM_MEDIA_TYPE *pMediaType = 0;
+		if ( iBest >= 0 && FAILED( pStreamConfig->GetStreamCaps( modes[ iBest ].index, &pMediaType, buf.get() ) ) )
+			pMediaType = 0;
+
+		// a stale cache entry shows when the selected capability does not match the cached mode
+		if ( bCached && iBest >= 0 && !matchesCaptureMode( pMediaType, modes[ iBest ] ) )
+		{
+			LOG4CPP_INFO( logger, "Cached media types are out of date, probing the capture pin" );
+			deleteMediaType( pMediaType );
+			pMediaType = 0;
+
+			probeCaptureModes( pStreamConfig, iCount, buf.get(), iSize, modes );
+			cache.setModes( devicePath, iCount, modes );
+			iBest = selectCaptureMode( modes, settings, bestFrameInterval, bBestReachesRate );
+			if ( iBest >= 0 && FAILED( pStreamConfig->GetStreamCaps( modes[ iBest ].index, &pMediaType, buf.get() ) ) )
+				pMediaType = 0;
+		}
+
+		if ( pModes )
+			*pModes = modes;
+
+		if ( iBest < 0 )
+		{ LOG4CPP_WARN( logger, "No media type matches the requested size and pixel format, using the driver default" ); }
+		else if ( pMediaType )
+		{
+			BITMAPINFOHEADER* pHeader;
+			REFERENCE_TIME* pAvgTimePerFrame;
+			videoFormatInfo( pMediaType, pHeader, pAvgTimePerFrame );
+			if ( bestFrameInterval > 0 )
+				*pAvgTimePerFrame = bestFrameInterval;
+
+			if ( !bBestReachesRate )
+				LOG4CPP_WARN( logger, "No media type reaches " << settings.frameRate << " fps" );
+			LOG4CPP_INFO( logger, "Selected media type " << modes[ iBest ].index << ": " << pHeader->biWidth << "x" << pHeader->biHeight << 
+				" " << sampleFormatName( sampleFormatFromSubtype( pMediaType->subtype ) ) << " @ " << 
+				( *pAvgTimePerFrame > 0 ? 1e7 / *pAvgTimePerFrame : 0 ) << " fps (AvgTimePerFrame=" << *pAvgTimePerFrame << ")" );
+
+			// ask for top-down RGB24, so that the frames need not be flipped
+			bool bTopDown = false;
+			if ( pMediaType->subtype == MEDIASUBTYPE_RGB24 && pHeader->biHeight > 0 )
+			{
+				pHeader->biHeight = -pHeader->biHeight;
+				bTopDown = SUCCEEDED( pStreamConfig->SetFormat( pMediaType ) );
+				if ( !bTopDown )
+					pHeader->biHeight = -pHeader->biHeight;
+				LOG4CPP_DEBUG( logger, "Top-down RGB24 " << ( bTopDown ? "accepted" : "not supported" ) << " by the driver" );
+			}
+
+			if ( !bTopDown && FAILED( pStreamConfig->SetFormat( pMediaType ) ) )
+				LOG4CPP_WARN( logger, "Unable to set the selected media type" );
+			else
+				selectedSubtype = pMediaType->subtype;
+			deleteMediaType( pMediaType );
+		}
+	}
+
+	// create sample grabber filter
+	AutoComPtr< IBaseFilter > pSampleGrabberFilter;
+	if ( FAILED( pSampleGrabberFilter.CoCreateInstance( CLSID_SampleGrabber, NULL, CLSCTX_INPROC_SERVER ) ) )
+		UBITRACK_THROW( "Unable to create sample grabber filter" );
+
+	if ( FAILED( pGraph->AddFilter( pSampleGrabberFilter, L"SampleGrab" ) ) )
+		UBITRACK_THROW( "Unable to add sample grabber filter" );
+
+	// configure sample grabber
+	AutoComPtr< ISampleGrabber > pSampleGrabber;
+	pSampleGrabberFilter.QueryInterface( pSampleGrabber );
+	pSampleGrabber->SetOneShot( FALSE );
+	pSampleGrabber->SetBufferSamples( FALSE );
+	pSampleGrabber->SetCallback( pCallback, 0 ); // 0 = Use the SampleCB callback method.
+
+
+
+
+	// make it picky on media types, without native conversion DirectShow inserts its own converters to RGB24
+	if ( !settings.nativeFormats || sampleFormatFromSubtype( selectedSubtype ) == SAMPLE_UNKNOWN )
+		selectedSubtype = MEDIASUBTYPE_RGB24;
+
+	AM_MEDIA_TYPE mediaType;
+	memset( &mediaType, 0, sizeof( mediaType ) );
+	mediaType.majortype = MEDIATYPE_Video;
+	mediaType.subtype = selectedSubtype;
+	pSampleGrabber->SetMediaType( &mediaType );
+
+	// null renderer
+	AutoComPtr< IBaseFilter > pNullRenderer;
+	if ( FAILED( pNullRenderer.CoCreateInstance( CLSID_NullRenderer, NULL, CLSCTX_INPROC_SERVER ) ) )
+		UBITRACK_THROW( "Unable to create null renderer filter" );
+
+	if ( FAILED( pGraph->AddFilter( pNullRenderer, L"NullRender" ) ) )
+		UBITRACK_THROW( "Unable to add null renderer filter" );
+
+	// connect all filters
+	HRESULT hr = pBuild->RenderStream(
+		&PIN_CATEGORY_CAPTURE, // Connect this pin ...
+		&MEDIATYPE_Video,      // with this media type ...
+		pCaptureFilter,        // on this filter ...
+		pSampleGrabberFilter,  // to the Sample Grabber ...
+		pNullRenderer );       // ... and finally to the Null Renderer.
+	if ( FAILED( hr ) )
+		UBITRACK_THROW( "Unable to render stream" );
+
+	// get media type
+	pSampleGrabber->GetConnectedMediaType( &mediaType );
+	format.format = sampleFormatFromSubtype( mediaType.subtype );
+	BITMAPINFOHEADER* pHeader;
+	REFERENCE_TIME* pAvgTimePerFrame;
+	if ( !videoFormatInfo( &mediaType, pHeader, pAvgTimePerFrame ) ||
+		format.format == SAMPLE_UNKNOWN || ( !settings.nativeFormats && format.format != SAMPLE_RGB24 ) )
+	{
+		freeMediaType( mediaType );
+		UBITRACK_THROW( "Unsupported MEDIATYPE" );
+	}
+
+	// negative heights denote top-down RGB DIBs, YUV formats are always top-down
+	format.width = pHeader->biWidth;
+	format.height = pHeader->biHeight < 0 ? -pHeader->biHeight : pHeader->biHeight;
+	format.bottomUp = format.format == SAMPLE_RGB24 && pHeader->biHeight > 0;
+	double fps = (1.0 / *pAvgTimePerFrame) * 10000000.0;
+	LOG4CPP_INFO( logger, "Image dimensions: " << format.width << "x" << format.height << " FPS: " << fps << 
+		" format: " << sampleFormatName( format.format ) );
+
+	// the graph is rebuilt on every reconnect attempt and probed mode
+	freeMediaType( mediaType );
+
+	if ( settings.captureBuffers > 0 )
+	{
+		AutoComPtr< IAMBufferNegotiation > pBufferNegotiation;
+		ALLOCATOR_PROPERTIES props;
+		if ( SUCCEEDED( pPin.QueryInterface< IAMBufferNegotiation >( pBufferNegotiation ) ) &&
+			SUCCEEDED( pBufferNegotiation->GetAllocatorProperties( &props ) ) )
+		{
+			LOG4CPP_INFO( logger, "Capture allocator: " << props.cBuffers << " buffers of " << props.cbBuffer << " bytes" );
+			if ( settings.zeroCopy && props.cBuffers < settings.captureBuffers )
+				LOG4CPP_WARN( logger, "Capture pin only provides " << props.cBuffers << " buffers, holding frames downstream may stall the capture" );
+		}
+	}
+}
+
+/**
+ * capture times of the samples of a filter graph on the local clock.
+ *
+ * Capture filters stamp each sample with its stream time, i.e. the time of the graph's reference
+ * clock at capture (usually from the driver's KS presentation time) minus the start time of the
+ * graph. The graph is therefore started with an explicit start time, and every callback reads the
+ * reference clock together with the local clock to keep a drift-corrected mapping between both.
+ * Without a reference clock (or sample times), \c captureTime fails and the caller falls back to
+ * the callback time.
+ */
+class GraphClock
+{
+public:
+	GraphClock()
+		: m_startTime( 0 )
+		, m_bStartKnown( false )
+	{}
+
+	/** gets the reference clock, the graph must have been paused once so that it has selected one */
+	void init( AutoComPtr< IGraphBuilder >& pGraph )
+	{
+		release();
+		if ( FAILED( pGraph.QueryInterface< IMediaFilter >( m_pMediaFilter ) ) || 
+			FAILED( m_pMediaFilter->GetSyncSource( &m_pClock.p ) ) || !m_pClock )
+		{
+			LOG4CPP_WARN( logger, "Filter graph has no reference clock, timestamps are taken when frames arrive" );
+			m_pClock.Release();
+		}
+	}
+
+	/** runs the graph */
+	void run( IMediaControl* pMediaControl )
+	{
+		REFERENCE_TIME now;
+		if ( m_pClock && SUCCEEDED( m_pClock->GetTime( &now ) ) )
+		{
+			// like IMediaControl::Run, start slightly in the future so that all filters are running in time
+			m_startTime = now + 100000;
+			m_mapping.reset();
+			if ( SUCCEEDED( m_pMediaFilter->Run( m_startTime ) ) )
+			{
+				m_bStartKnown = true;
+				return;
+			}
+			LOG4CPP_WARN( logger, "Unable to start the filter graph with a start time" );
+		}
+		m_bStartKnown = false;
+		pMediaControl->Run();
+	}
+
+	/** capture time of a sample on the local clock, false if it is not known */
+	bool captureTime( IMediaSample* pSample, Measurement::Timestamp& t )
+	{
+		REFERENCE_TIME clockTime;
+		if ( !m_bStartKnown || FAILED( m_pClock->GetTime( &clockTime ) ) )
+			return false;
+		m_mapping.addPair( clockTime, Measurement::now() );
+
+		REFERENCE_TIME sampleStart, sampleEnd;
+		if ( FAILED( pSample->GetTime( &sampleStart, &sampleEnd ) ) )
+			return false;
+
+		t = m_mapping.toLocal( m_startTime + sampleStart );
+		return true;
+	}
+
+	/** drift of the reference clock relative to the local clock in ppm */
+	double drift() const
+	{ return m_mapping.drift(); }
+
+	/** releases the graph, e.g. before it is rebuilt */
+	void release()
+	{
+		m_bStartKnown = false;
+		m_pClock.Release();
+		m_pMediaFilter.Release();
+	}
+
+protected:
+	AutoComPtr< IMediaFilter > m_pMediaFilter;
+	AutoComPtr< IReferenceClock > m_pClock;
+	REFERENCE_TIME m_startTime;
+	bool m_bStartKnown;
+	ClockMapping m_mapping;
+};
+
+/** interface and property id of each CameraParameter */
+static const struct
+{
+	bool bCameraControl;
+	long property;
+} s_cameraProperties[ PARAM_COUNT ] = {
+	{ true, CameraControl_Exposure },
+	{ false, VideoProcAmp_Gain },
+	{ false, VideoProcAmp_Brightness },
+	{ false, VideoProcAmp_Contrast },
+	{ false, VideoProcAmp_Saturation },
+	{ false, VideoProcAmp_Sharpness },
+	{ false, VideoProcAmp_Gamma },
+	{ false, VideoProcAmp_WhiteBalance },
+	{ false, VideoProcAmp_BacklightCompensation },
+	{ true, CameraControl_Focus }
+};
+
+/**
+ * applies camera parameters on a separate thread.
+ *
+ * Setting a property of a UVC camera is a synchronous control transfer that can take tens of
+ * milliseconds, so neither the streaming thread nor a dataflow thread pushing an update should wait
+ * for it. Pending updates of the same parameter are merged, only the newest value is applied, and
+ * values that are already set are skipped.
+ */
+class CameraControlThread
+{
+public:
+	/** \c pDevice is the capture filter or the Media Foundation source of the camera */
+	CameraControlThread( IUnknown* pDevice )
+		: m_bStop( false )
+	{
+		if ( FAILED( pDevice->QueryInterface( __uuidof( IAMCameraControl ), reinterpret_cast< void** >( &m_pCameraControl.p ) ) ) )
+			LOG4CPP_INFO( logger, "Capture device has no IAMCameraControl interface" );
+		if ( FAILED( pDevice->QueryInterface( __uuidof( IAMVideoProcAmp ), reinterpret_cast< void** >( &m_pVideoProcAmp.p ) ) ) )
+			LOG4CPP_INFO( logger, "Capture device has no IAMVideoProcAmp interface" );
+
+		for ( int i = 0; i < PARAM_COUNT; i++ )
+		{
+			m_pending[ i ].bValid = false;
+			m_applied[ i ].bValid = false;
+		}
+		m_pThread.reset( new boost::thread( boost::bind( &CameraControlThread::threadProc, this ) ) );
+	}
+
+	~CameraControlThread()
+	{
+		{
+			boost::mutex::scoped_lock l( m_mutex );
+			m_bStop = true;
+		}
+		m_cond.notify_all();
+		m_pThread->join();
+	}
+
+	/** range of a parameter, false if the camera does not support it */
+	bool range( CameraParameter parameter, long& min, long& max, long& step, long& def )
+	{
+		long flags;
+		if ( s_cameraProperties[ parameter ].bCameraControl )
+			return m_pCameraControl && SUCCEEDED( m_pCameraControl->GetRange( s_cameraProperties[ parameter ].property, &min, &max, &step, &def, &flags ) );
+		return m_pVideoProcAmp && SUCCEEDED( m_pVideoProcAmp->GetRange( s_cameraProperties[ parameter ].property, &min, &max, &step, &def, &flags ) );
+	}
+
+	/** current value of a parameter */
+	bool get( CameraParameter parameter, long& value, bool& bAuto )
+	{
+		long flags = 0;
+		HRESULT hr = E_NOINTERFACE;
+		if ( s_cameraProperties[ parameter ].bCameraControl && m_pCameraControl )
+			hr = m_pCameraControl->Get( s_cameraProperties[ parameter ].property, &value, &flags );
+		else if ( !s_cameraProperties[ parameter ].bCameraControl && m_pVideoProcAmp )
+			hr = m_pVideoProcAmp->Get( s_cameraProperties[ parameter ].property, &value, &flags );
+		bAuto = ( flags & CameraControl_Flags_Auto ) != 0;
+		return SUCCEEDED( hr );
+	}
+
+	/** logs range and current value of all supported parameters */
+	void logParameters()
+	{
+		for ( int i = 0; i < PARAM_COUNT; i++ )
+		{
+			long min, max, step, def, value;
+			bool bAuto;
+			if ( range( CameraParameter( i ), min, max, step, def ) && get( CameraParameter( i ), value, bAuto ) )
+				LOG4CPP_INFO( logger, "Camera " << cameraParameterName( CameraParameter( i ) ) << ": " << value << ( bAuto ? " (auto)" : "" ) << 
+					", min=" << min << " max=" << max << " step=" << step << " default=" << def );
+		}
+	}
+
+	/** queues a new value, returns immediately */
+	void post( CameraParameter parameter, long value, bool bAuto )
+	{
+		{
+			boost::mutex::scoped_lock l( m_mutex );
+			m_pending[ parameter ].bValid = true;
+			m_pending[ parameter ].value = value;
+			m_pending[ parameter ].bAuto = bAuto;
+		}
+		m_cond.notify_one();
+	}
+
+protected:
+	struct Value
+	{
+		bool bValid;
+		long value;
+		bool bAuto;
+	};
+
+	void threadProc()
+	{
+		CoInitializeEx( NULL, COINIT_MULTITHREADED );
+
+		boost::mutex::scoped_lock l( m_mutex );
+		while ( !m_bStop )
+		{
+			int parameter = 0;
+			while ( parameter < PARAM_COUNT && !m_pending[ parameter ].bValid )
+				parameter++;
+			if ( parameter == PARAM_COUNT )
+			{
+				m_cond.wait( l );
+				continue;
+			}
+
+			Value value = m_pending[ parameter ];
+			m_pending[ parameter ].bValid = false;
+			if ( m_applied[ parameter ].bValid && m_applied[ parameter ].value == value.value && m_applied[ parameter ].bAuto == value.bAuto )
+				continue;
+
+			// posting must not wait for the device
+			l.unlock();
+			bool bSet = set( CameraParameter( parameter ), value.value, value.bAuto );
+			l.lock();
+			m_applied[ parameter ] = value;
+			m_applied[ parameter ].bValid = bSet;
+		}
+
+		l.unlock();
+		CoUninitialize();
+	}
+
+	bool set( CameraParameter parameter, long value, bool bAuto )
+	{
+		HRESULT hr = E_NOINTERFACE;
+		if ( s_cameraProperties[ parameter ].bCameraControl && m_pCameraControl )
+			hr = m_pCameraControl->Set( s_cameraProperties[ parameter ].property, value, bAuto ? CameraControl_Flags_Auto : CameraControl_Flags_Manual );
+		else if ( !s_cameraProperties[ parameter ].bCameraControl && m_pVideoProcAmp )
+			hr = m_pVideoProcAmp->Set( s_cameraProperties[ parameter ].property, value, bAuto ? VideoProcAmp_Flags_Auto : VideoProcAmp_Flags_Manual );
+
+		if ( FAILED( hr ) )
+		{
+			LOG4CPP_ERROR( logger, "Error setting camera " << cameraParameterName( parameter ) << " to " << value << ( bAuto ? " (auto)" : "" ) );
+			return false;
+		}
+		LOG4CPP_DEBUG( logger, "Camera " << cameraParameterName( parameter ) << " set to " << value << ( bAuto ? " (auto)" : "" ) );
+		return true;
+	}
+
+	AutoComPtr< IAMCameraControl > m_pCameraControl;
+	AutoComPtr< IAMVideoProcAmp > m_pVideoProcAmp;
+
+	/** newest value of each parameter not applied yet, protected by m_mutex */
+	Value m_pending[ PARAM_COUNT ];
+
+	/** last value set on the device, only touched by the thread */
+	Value m_applied[ PARAM_COUNT ];
+
+	bool m_bStop;
+	boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+	boost::scoped_ptr< boost::thread > m_pThread;
+};
+
+/** parses a region of interest given as "x y width height" (or comma separated), empty if there is none */
+static cv::Rect parseRegion( const std::string& s )
+{
+	std::string values( s );
+	std::replace( values.begin(), values.end(), ',', ' ' );
+	std::istringstream is( values );
+	cv::Rect region;
+	if ( !( is >> region.x >> region.y >> region.width >> region.height ) )
+		return cv::Rect();
+	return region;
+}
+
+/**
+ * deleter for images wrapping the buffer of an IMediaSample.
+ * Holds a reference to the sample, which returns it to the allocator when released.
+ */
+class MediaSampleReleaser
+{
+public:
+	MediaSampleReleaser( IMediaSample* pSample )
+		: m_pSample( pSample )
+	{ m_pSample->AddRef(); }
+
+	void operator()( Vision::Image* pImage )
+	{
+		delete pImage;
+		m_pSample->Release();
+	}
+
+protected:
+	IMediaSample* m_pSample;
+};
+
+/**
+ * deleter for images wrapping a locked Media Foundation buffer.
+ * Holds the buffer, which is unlocked and returned to the source reader when released.
+ */
+class MediaBufferReleaser
+{
+public:
+	MediaBufferReleaser( const boost::shared_ptr< void >& pBuffer )
+		: m_pBuffer( pBuffer )
+	{}
+
+	void operator()( Vision::Image* pImage )
+	{
+		delete pImage;
+		m_pBuffer.reset();
+	}
+
+protected:
+	boost::shared_ptr< void > m_pBuffer;
+};
+
+/**
+ * reads the thread settings attributes <prefix>Priority, <prefix>Task and <prefix>Affinity.
+ * If \c affinity is given, it replaces the affinity attribute.
+ */
+static ThreadSettings readThreadSettings( boost::shared_ptr< Graph::UTQLSubgraph > subgraph, const std::string& prefix, 
+	const std::string* affinity = 0 )
+{
+	ThreadSettings settings;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( prefix + "Priority" ) )
+		settings.setPriority( subgraph->m_DataflowAttributes.getAttributeString( prefix + "Priority" ) );
+	if ( subgraph->m_DataflowAttributes.hasAttribute( prefix + "Task" ) )
+		settings.setTask( subgraph->m_DataflowAttributes.getAttributeString( prefix + "Task" ) );
+	if ( affinity )
+		settings.setAffinity( *affinity );
+	else if ( subgraph->m_DataflowAttributes.hasAttribute( prefix + "Affinity" ) )
+		settings.setAffinity( subgraph->m_DataflowAttributes.getAttributeString( prefix + "Affinity" ) );
+	return settings;
+}
+
+/**
+ * reads the parallelThreads and parallelBands attributes and lets the pipeline process full frames in bands.
+ * Nothing is changed if parallelThreads is 0.
+ */
+static void configureBands( boost::shared_ptr< Graph::UTQLSubgraph > subgraph, FramePipeline& pipeline )
+{
+	int threads = 0;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "parallelThreads" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "parallelThreads", threads );
+	if ( threads <= 0 )
+		return;
+
+	// more bands than threads even out bands of different cost, e.g. at the distorted image borders
+	int bands = 0;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "parallelBands" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "parallelBands", bands );
+	pipeline.setBandPool( BandPool::get( threads ), bands > 0 ? bands : 2 * ( threads + 1 ) );
+}
+
+/**
+ * @ingroup vision_components
+ *
+ * @par Input Ports
+ * Optional \c InputIntrinsics push port of type Ubitrack::Measurement::CameraIntrinsics, 
+ * \c RegionOfInterest push port of type Ubitrack::Measurement::Vector4D (x, y, width, height) and
+ * \c CameraControl push port of type Ubitrack::Measurement::Vector4D (parameter, value, auto, unused).
+ *
+ * @par Output Ports
+ * \c Output push port of type Ubitrack::Measurement::ImageMeasurement.
+ * Optional \c ColorOutput, \c OutputRAW and \c PyramidOutput push ports of the same type, the latter holds
+ * \c pyramidLevels levels of the \c Output image in one image (see ImagePyramid.h).
+ * Optional \c LatestOutput and \c LatestColorOutput pull ports of the same type, returning the newest
+ * frame of \c Output resp. \c ColorOutput, or the one nearest to the requested time among the last
+ * \c pullHistorySize frames.
+ * Optional \c BatchOutput push port of the same type, holding \c batchSize frames of \c Output (or \c ColorOutput)
+ * in one image (see FrameBatch.h), and \c BatchTimestamps push port of type Ubitrack::Measurement::DistanceList
+ * with the times of the frames in milliseconds relative to the batch.
+ *
+ * @par Configuration
+ * The configuration tag contains a \c <dsvl_input> configuration.
+ * For details, see the DirectShow documentation...
+ *
+ */
+class DirectShowFrameGrabber
+	: public Dataflow::Component
+	, protected ISampleGrabberCB
+{
+public:
+
+	/** constructor */
+	DirectShowFrameGrabber( const std::string& sName, boost::shared_ptr< Graph::UTQLSubgraph >  );
+
+	/** destructor, waits until thread stops */
+	~DirectShowFrameGrabber();
+
+	/** starts the camera */
+	void start();
+
+	/** starts the capturing */
+	void startCapturing();
+
+	/** stops the camera */
+	void stop();
+
+protected:
+	/**
+	 * initializes the direct show filter graph.
+	 * When reconnecting, the fallback to the first device is not used if the camera was selected by name.
+	 */
+	void initGraph( bool bReconnect = false );
+
+	/** stops and releases the filter graph */
+	void releaseGraph();
+
+	/** thread method watching the graph events, rebuilds the graph when the device is lost */
+	void eventThread();
+
+	/**
+	 * runs every candidate capture mode for the probe duration, writes the report and optionally
+	 * switches to the best mode. Called from the event thread, which is the only one replacing the graph.
+	 */
+	void measureCaptureModes();
+
+	/** sleeps for \c ms milliseconds, but not beyond stopping the component, false if it has been stopped */
+	bool probeWait( double ms );
+
+	/** rebuilds the graph until the device is back or the component is destroyed */
+	void reconnect();
+
+	/** opens the camera with the Media Foundation backend instead of building a filter graph */
+	void initMediaFoundation( bool bReconnect );
+
+	/** takes over the sample format of a newly opened device, a recording is only continued with the same format */
+	void setSampleFormat( const CaptureFormat& format, bool bReconnect );
+
+	/** starts the camera control thread and the auto exposure for a newly opened device */
+	void initCameraControl( IUnknown* pDevice );
+
+	/** starts the filter graph or the source reader, m_graphMutex must be locked */
+	void runGraph();
+
+	/**
+	 * counts a sample and checks if it is to be processed, before its buffer is accessed.
+	 * \c time is the sample time of the backend, used to detect double frames.
+	 */
+	bool admitSample( double time, long sampleLength );
+
+	/**
+	 * the part of the sample callbacks common to both backends: auto exposure, recording, scheduling and processing.
+	 * \c pBufferImage wraps \c pBuffer, and keeps the sample alive if zero-copy is enabled. If \c bTransient
+	 * is set, the image refers to a buffer that is only valid during this call.
+	 */
+	void deliverSample( Measurement::Timestamp utTime, BYTE* pBuffer, long sampleLength, boost::shared_ptr< Vision::Image > pBufferImage, 
+		bool bTransient );
+
+	/**
+	 * sample callback of the Media Foundation backend
+	 * @return false if a texture sample could not be copied into GPU memory
+	 */
+	bool mediaFoundationSample( const MediaFoundationSample& sample );
+
+	/**
+	 * handles a frame after being converted to Vision::Image.
+	 * If \c bTransient is set, the image refers to a buffer that is only valid during this call.
+	 */
+	void handleFrame( Measurement::Timestamp utTime, boost::shared_ptr< Vision::Image > pBufferImage, bool bTransient );
+
+	/** starts the processing threads if asynchronous processing is enabled */
+	void startProcessing();
+
+	/** stops the processing threads and discards all queued frames */
+	void stopProcessing();
+
+	/**
+	 * stops the processing threads while the graph is rebuilt, since the workers use the sample format.
+	 * \c resumeProcessing restarts them unless the component was stopped in the meantime.
+	 */
+	void suspendProcessing();
+	void resumeProcessing();
+
+	/** starts the processing workers, called with \c m_processingMutex locked */
+	void startWorkers();
+
+	/** stops the processing workers, called with \c m_processingMutex locked */
+	void stopWorkers();
+
+	/** thread method of the processing workers */
+	void processingThread();
+
+	/** forwards the pipeline outputs of one frame to the ports */
+	class PortSink
+		: public FramePipeline::Sink
+	{
+	public:
+		PortSink( DirectShowFrameGrabber& grabber, Measurement::Timestamp t )
+			: m_grabber( grabber )
+			, m_time( t )
+		{}
+
+		bool isConnected( FramePipeline::Output output ) const
+		{
+			return m_grabber.outputPort( output ).isConnected() || m_grabber.outputHistory( output ) ||
+				( m_grabber.m_pBatcher && output == m_grabber.m_batchSource );
+		}
+
+		void send( FramePipeline::Output output, boost::shared_ptr< Vision::Image > pImage )
+		{
+			Measurement::ImageMeasurement image( m_time, pImage );
+			if ( FrameHistory* pHistory = m_grabber.outputHistory( output ) )
+				pHistory->publish( image );
+			if ( m_grabber.outputPort( output ).isConnected() )
+				m_grabber.outputPort( output ).send( image );
+
+			FrameBatch batch;
+			if ( m_grabber.m_pBatcher && output == m_grabber.m_batchSource && m_grabber.m_pBatcher->add( m_time, *pImage, batch ) )
+				m_grabber.sendBatch( batch );
+		}
+
+	protected:
+		DirectShowFrameGrabber& m_grabber;
+		Measurement::Timestamp m_time;
+	};
+
+	/** port of a pipeline output */
+	Dataflow::PushSupplier< Measurement::ImageMeasurement >& outputPort( FramePipeline::Output output )
+	{
+		switch ( output )
+		{
+		case FramePipeline::OUTPUT_RAW: return m_outPortRAW;
+		case FramePipeline::OUTPUT_COLOR: return m_colorOutPort;
+		case FramePipeline::OUTPUT_PYRAMID: return m_pyramidOutPort;
+		default: return m_outPort;
+		}
+	}
+
+	/** pushes a completed batch and the times of its frames */
+	void sendBatch( const FrameBatch& batch );
+
+	/** frames kept for the pull port of a pipeline output, 0 if the pull port is not used */
+	FrameHistory* outputHistory( FramePipeline::Output output )
+	{
+		switch ( output )
+		{
+		case FramePipeline::OUTPUT_GREY: return m_latestHistory.get();
+		case FramePipeline::OUTPUT_COLOR: return m_latestColorHistory.get();
+		default: return 0;
+		}
+	}
+
+	/** handler method for incoming pull requests */
+	Measurement::Matrix3x3 getIntrinsic( Measurement::Timestamp t )
+	{ return Measurement::Matrix3x3( t, m_undistortionMaps->intrinsics().matrix ); }
+
+	/** handler methods of the latest frame pull ports, never wait for the capture */
+	Measurement::ImageMeasurement getLatest( Measurement::Timestamp t )
+	{ return latestFrame( *m_latestHistory, t ); }
+
+	Measurement::ImageMeasurement getLatestColor( Measurement::Timestamp t )
+	{ return latestFrame( *m_latestColorHistory, t ); }
+
+	static Measurement::ImageMeasurement latestFrame( const FrameHistory& history, Measurement::Timestamp t )
+	{
+		Measurement::ImageMeasurement image;
+		if ( !history.find( t, image ) )
+			UBITRACK_THROW( "No image available" );
+		return image;
+	}
+
+	// width of resulting image
+	LONG m_sampleWidth;
+
+	// height of resulting image
+	LONG m_sampleHeight;
+
+	// pixel format of the samples
+	SampleFormat m_sampleFormat;
+
+	// RGB24 samples are stored bottom-up
+	bool m_sampleBottomUp;
+
+	// accept YUY2, NV12 and MJPG samples and convert them in the component
+	bool m_nativeFormats;
+
+	// requested frame rate, 0 = as fast as possible
+	double m_desiredFrameRate;
+
+	// requested pixel format of the capture pin, SAMPLE_UNKNOWN = any
+	SampleFormat m_desiredPixelFormat;
+
+	// shift timestamps (ms)
+	int m_timeOffset;
+
+	// only send every nth image
+	int m_divisor;
+
+	/** desired width */
+	int m_desiredWidth;
+
+	/** desired image height */
+	int m_desiredHeight;
+
+	// desired camera name
+	std::string m_desiredName;
+
+	// desired camera index (e.g. for multiple cameras with the same name as the Vuzix HMD)
+	std::string m_desiredDevicePath;
+
+	/** devices and capture modes of earlier starts */
+	boost::shared_ptr< DeviceCache > m_pDeviceCache;
+
+	/** records the native samples if a file is given */
+	std::string m_recordingFile;
+	int m_recordingQueueSize;
+	boost::scoped_ptr< SampleRecorder > m_pRecorder;
+
+
+	/** exposure control */
+	int m_cameraExposure;
+	bool m_cameraExposureAuto;
+
+	/** brightness control */
+	int m_cameraBrightness;
+
+	/** contrast control */
+	int m_cameraContrast;
+
+	/** saturation control */
+	int m_cameraSaturation;
+
+	/** sharpness control */
+	int m_cameraSharpness;
+
+	/** gamma control */
+	int m_cameraGamma;
+
+	/** whitebalance control */
+	int m_cameraWhitebalance;
+	bool m_cameraWhitebalanceAuto;
+
+	/** gain control */
+	bool m_cameraBacklightComp;
+
+	/** gain control */
+	int m_cameraGain;
+
+	/** camera parameters given as attributes, only these are applied to the camera */
+	bool m_cameraParameterSet[ PARAM_COUNT ];
+
+
+	/** number of frames received */
+	int m_nFrames;
+
+	/** timestamp of last frame */
+	double m_lastTime;
+
+	/** automatic upload of images to the GPU*/
+	bool m_autoGPUUpload;
+
+	/** process frames in worker threads instead of the DirectShow streaming thread */
+	bool m_asyncProcessing;
+
+	/** maximum number of frames waiting for processing */
+	int m_frameQueueSize;
+
+	/** what to do with frames arriving while the queue is full */
+	bool m_frameQueueDropNewest;
+
+	/** number of worker threads */
+	int m_processingThreads;
+
+	/** pass the DirectShow sample buffers downstream instead of copying them */
+	bool m_zeroCopy;
+
+	/** number of sample buffers to request from the capture pin allocator, 0 = driver default */
+	int m_captureBuffers;
+
+	/** maximum number of unused image buffers per size and format kept for reuse */
+	int m_imagePoolSize;
+
+	/** recycles the buffers of the images created for the outputs */
+	boost::shared_ptr< ImagePool > m_imagePool;
+
+	/** a frame waiting for processing */
+	struct QueuedFrame
+	{
+		Measurement::Timestamp time;
+		boost::shared_ptr< Vision::Image > image;
+	};
+
+	/** frames handed over from SampleCB to the workers, only exists in asynchronous mode */
+	boost::scoped_ptr< FrameQueue< QueuedFrame > > m_frameQueue;
+
+	/** the processing workers */
+	std::vector< boost::shared_ptr< boost::thread > > m_workers;
+
+	/** set between \c startProcessing and \c stopProcessing, guarded by \c m_processingMutex like \c m_workers */
+	bool m_bProcessing;
+
+	/** the workers are stopped and started by the dataflow and the event thread */
+	boost::mutex m_processingMutex;
+
+	/** scheduling of the processing workers */
+	ThreadSettings m_workerThreadSettings;
+
+	/** scheduling of the threads delivering the samples */
+	CallbackThreadSettings m_streamingThreadSettings;
+
+	/** timestamp synchronizer */
+	Measurement::TimestampSync m_syncer;
+
+	/** stage timings and drop counters, logged every statisticsInterval seconds */
+	FrameStatistics m_statistics;
+
+	/** intrinsics and remap tables, updated in the background when new intrinsics arrive */
+	boost::scoped_ptr< UndistortionMapCache > m_undistortionMaps;
+
+	/** image processing of the captured frames */
+	boost::scoped_ptr< FramePipeline > m_pipeline;
+
+	/** recent frames of Output and ColorOutput, only if the corresponding pull port is used */
+	boost::scoped_ptr< FrameHistory > m_latestHistory;
+	boost::scoped_ptr< FrameHistory > m_latestColorHistory;
+
+	/** collects frames of m_batchSource for the batch output, only if BatchOutput is used */
+	boost::scoped_ptr< FrameBatcher > m_pBatcher;
+	FramePipeline::Output m_batchSource;
+
+	/** skips frames to meet the target rate and latency budget */
+	FrameScheduler m_scheduler;
+
+	/** skips frames while the scene is static */
+	MotionGate m_motionGate;
+
+	/** capture times of the samples */
+	GraphClock m_clock;
+
+	// the ports
+	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_outPort;
+	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_colorOutPort;
+	Dataflow::PullSupplier< Measurement::Matrix3x3 > m_intrinsicsPort;
+
+	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_outPortRAW;
+	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_pyramidOutPort;
+	boost::scoped_ptr< Dataflow::PullSupplier< Measurement::ImageMeasurement > > m_latestOutPort;
+	boost::scoped_ptr< Dataflow::PullSupplier< Measurement::ImageMeasurement > > m_latestColorOutPort;
+	boost::scoped_ptr< Dataflow::PushSupplier< Measurement::ImageMeasurement > > m_batchOutPort;
+	boost::scoped_ptr< Dataflow::PushSupplier< Measurement::DistanceList > > m_batchTimesOutPort;
+	boost::shared_ptr < Dataflow::PushConsumer< Measurement::CameraIntrinsics > > m_intrinsicInPort;
+	boost::shared_ptr< Dataflow::PushConsumer< Measurement::Vector4D > > m_regionInPort;
+
+	void newIntrinsicsPush(Measurement::CameraIntrinsics intrinsics);
+
+	/** new region of interest (x, y, width, height) from a tracker, a zero size selects the whole image */
+	void newRegionPush( Measurement::Vector4D region );
+
+	/** new value of a camera parameter (parameter, value, auto, unused), applied in the background */
+	void newCameraControlPush( Measurement::Vector4D control );
+
+	/** applies the camera parameters given as attributes */
+	void postCameraParameters();
+
+	/** starts the auto exposure controller with the current exposure and gain of the camera */
+	void initExposureControl();
+
+	/** feeds the brightness of a sample to the auto exposure controller */
+	void updateExposure( const cv::Mat& sample );
+
+	boost::shared_ptr< Dataflow::PushConsumer< Measurement::Vector4D > > m_cameraControlInPort;
+
+	/** sets camera parameters without blocking the streaming thread */
+	boost::scoped_ptr< CameraControlThread > m_pCameraControl;
+
+	/** software auto exposure with bounded exposure time */
+	ExposureController m_exposureController;
+
+	/** target mean brightness of the auto exposure, 0 if disabled */
+	double m_autoExposureTarget;
+
+	/** longest exposure the auto exposure may use in ms, 0 for the camera's maximum */
+	double m_maxExposureTime;
+
+	/** pointer to DirectShow filter graph, replaced under m_graphMutex when reconnecting */
+	AutoComPtr< IMediaControl > m_pMediaControl;
+	AutoComPtr< IMediaEventEx > m_pMediaEvent;
+	boost::mutex m_graphMutex;
+
+	/** watches the graph for lost devices */
+	boost::scoped_ptr< boost::thread > m_pEventThread;
+	boost::atomic< bool > m_bStopEvents;
+
+	/** when the device was lost, 0 while connected */
+	boost::atomic< Measurement::Timestamp > m_lostTime;
+
+	/** capture with Media Foundation instead of a DirectShow filter graph */
+	bool m_mediaFoundation;
+
+	/** decode compressed streams with hardware transforms, Media Foundation only */
+	bool m_hardwareDecode;
+
+	/** the Media Foundation capture device, replaced under m_graphMutex when reconnecting */
+	boost::scoped_ptr< MediaFoundationCapture > m_pMFCapture;
+
+	/** shares the decoded textures with OpenCL, created with the OpenCL context */
+	boost::scoped_ptr< D3D11Sharing > m_pD3D11Sharing;
+
+	/** capture modes of the capture pin and name of the camera, from the last initGraph */
+	std::vector< CaptureMode > m_captureModes;
+	std::string m_cameraName;
+
+	/** measurements of the running mode while probing */
+	CaptureProbe m_probe;
+
+	/** seconds each capture mode is measured, 0 disables probing */
+	double m_probeDuration;
+
+	/** file of the probe report, empty to only log the results */
+	std::string m_probeReport;
+
+	/** selection of the mode after probing */
+	ProbeGoal m_probeGoal;
+	double m_probeLatencyBudget;
+
+	/** the capture modes are probed once, by the event thread after capturing has started */
+	bool m_bProbed;
+	boost::atomic< bool > m_bProbePending;
+
+    // ISampleGrabberCB: fake reference counting.
+    STDMETHODIMP_(ULONG) AddRef() 
+	{ return 1; }
+
+    STDMETHODIMP_(ULONG) Release() 
+	{ return 2; }
+
+    STDMETHODIMP QueryInterface( REFIID riid, void **ppvObject )
+    {
+		if ( NULL == ppvObject ) 
+			return E_POINTER;
+		if ( riid == __uuidof( IUnknown ) )
+		{
+			*ppvObject = static_cast<IUnknown*>( this );
+			 return S_OK;
+		}
+		if ( riid == __uuidof( ISampleGrabberCB ) )
+		{
+			*ppvObject = static_cast<ISampleGrabberCB*>( this );
+			 return S_OK;
+		}
+		return E_NOTIMPL;
+	}
+
+	STDMETHODIMP SampleCB( double Time, IMediaSample *pSample );
+
+	STDMETHODIMP BufferCB( double Time, BYTE *pBuffer, long BufferLen )
+	{
+		LOG4CPP_INFO( logger, "BufferCB called" );
+		return E_NOTIMPL;
+	}
+};
+
+
+DirectShowFrameGrabber::DirectShowFrameGrabber( const std::string& sName, boost::shared_ptr< Graph::UTQLSubgraph > subgraph )
+	: Dataflow::Component( sName )
+	, m_sampleFormat( SAMPLE_RGB24 )
+	, m_sampleBottomUp( true )
+	, m_nativeFormats( false )
+	, m_desiredFrameRate( 0 )
+	, m_desiredPixelFormat( SAMPLE_UNKNOWN )
+	, m_timeOffset( 0 )
+	, m_divisor( 1 )
+	, m_desiredWidth( 320 )
+	, m_desiredHeight( 240 )
+	, m_recordingQueueSize( 64 )
+	, m_cameraExposure( 0 )
+	, m_cameraExposureAuto( true )
+	, m_cameraBrightness( 0 )
+	, m_cameraContrast( 11 )
+	, m_cameraSaturation( 4 )
+	, m_cameraSharpness( 3 )
+	, m_cameraGamma( 150 )
+	, m_cameraWhitebalance( 4500 )
+	, m_cameraWhitebalanceAuto( true )
+	, m_cameraBacklightComp( false )
+	, m_cameraGain( 34 )
+	, m_nFrames( 0 )
+	, m_lastTime( -1e10 )
+	, m_syncer( 1.0 )
+	//, m_undistorter( *subgraph )
+	, m_outPort( "Output", *this )
+	, m_colorOutPort( "ColorOutput", *this )
+	, m_intrinsicsPort( "Intrinsics", *this, boost::bind( &DirectShowFrameGrabber::getIntrinsic, this, _1 ) )
+	, m_outPortRAW("OutputRAW", *this)
+	, m_pyramidOutPort( "PyramidOutput", *this )
+	, m_autoExposureTarget( 0 )
+	, m_maxExposureTime( 0 )
+	, m_autoGPUUpload(false)
+	, m_asyncProcessing( false )
+	, m_frameQueueSize( 4 )
+	, m_frameQueueDropNewest( false )
+	, m_processingThreads( 1 )
+	, m_bProcessing( false )
+	, m_zeroCopy( false )
+	, m_captureBuffers( 0 )
+	, m_imagePoolSize( 4 )
+	, m_batchSource( FramePipeline::OUTPUT_GREY )
+	, m_bStopEvents( false )
+	, m_lostTime( 0 )
+	, m_mediaFoundation( false )
+	, m_hardwareDecode( true )
+	, m_probeDuration( 0 )
+	, m_probeGoal( PROBE_REPORT )
+	, m_probeLatencyBudget( 0 )
+	, m_bProbed( false )
+	, m_bProbePending( false )
+{
+	HRESULT hRes = CoInitializeEx( NULL, COINIT_MULTITHREADED );
+	if ( hRes == RPC_E_CHANGED_MODE )
+	{ 
+		LOG4CPP_WARN( logger, "CoInitializeEx failed with RPC_E_CHANGED_MODE, continuing..." );
+	}
+	else if ( FAILED( hRes ) )
+	{
+		std::ostringstream os;
+		os << "Error in CoInitializeEx:" << std::hex << hRes;
+		UBITRACK_THROW( os.str() );
+	}
+
+	std::fill( m_cameraParameterSet, m_cameraParameterSet + PARAM_COUNT, false );
+
+	subgraph->m_DataflowAttributes.getAttributeData( "timeOffset", m_timeOffset );
+	subgraph->m_DataflowAttributes.getAttributeData( "divisor", m_divisor );
+	subgraph->m_DataflowAttributes.getAttributeData( "imageWidth", m_desiredWidth );
+	subgraph->m_DataflowAttributes.getAttributeData( "imageHeight", m_desiredHeight );
+	m_desiredDevicePath = subgraph->m_DataflowAttributes.getAttributeString( "devicePath" );
+	m_desiredName = subgraph->m_DataflowAttributes.getAttributeString( "cameraName" );
+	m_pDeviceCache = DeviceCache::get( subgraph->m_DataflowAttributes.getAttributeString( "deviceCache" ) );
+	m_recordingFile = subgraph->m_DataflowAttributes.getAttributeString( "recordingFile" );
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "recordingQueueSize" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "recordingQueueSize", m_recordingQueueSize );
+	subgraph->m_DataflowAttributes.getAttributeData( "autoExposureTarget", m_autoExposureTarget );
+	subgraph->m_DataflowAttributes.getAttributeData( "maxExposureTime", m_maxExposureTime );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "frameRate" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "frameRate", m_desiredFrameRate );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "pixelFormat" ) )
+	{
+		std::string sPixelFormat = subgraph->m_DataflowAttributes.getAttributeString( "pixelFormat" );
+		m_desiredPixelFormat = sampleFormatFromName( sPixelFormat );
+		if ( m_desiredPixelFormat == SAMPLE_UNKNOWN && sPixelFormat != "any" )
+			UBITRACK_THROW( "Unsupported pixel format: " + sPixelFormat );
+	}
+	
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraExposure" ) )
+	{
+		subgraph->m_DataflowAttributes.getAttributeData( "cameraExposure", m_cameraExposure );
+		// an explicit exposure is meant to be used
+		m_cameraExposureAuto = false;
+		m_cameraParameterSet[ PARAM_EXPOSURE ] = true;
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraExposureAuto" ) )
+	{
+		m_cameraExposureAuto = subgraph->m_DataflowAttributes.getAttributeString( "cameraExposureAuto" ) == "true";
+		m_cameraParameterSet[ PARAM_EXPOSURE ] = true;
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraBrightness" ) )
+	{
+		subgraph->m_DataflowAttributes.getAttributeData( "cameraBrightness", m_cameraBrightness );
+		m_cameraParameterSet[ PARAM_BRIGHTNESS ] = true;
+	}
+	
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraContrast" ) )
+	{
+		subgraph->m_DataflowAttributes.getAttributeData( "cameraContrast", m_cameraContrast );
+		m_cameraParameterSet[ PARAM_CONTRAST ] = true;
+	}
+	
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraSaturation" ) )
+	{
+		subgraph->m_DataflowAttributes.getAttributeData( "cameraSaturation", m_cameraSaturation );
+		m_cameraParameterSet[ PARAM_SATURATION ] = true;
+	}
+	
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraSharpness" ) )
+	{
+		subgraph->m_DataflowAttributes.getAttributeData( "cameraSharpness", m_cameraSharpness );
+		m_cameraParameterSet[ PARAM_SHARPNESS ] = true;
+	}
+	
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraGamma" ) )
+	{
+		subgraph->m_DataflowAttributes.getAttributeData( "cameraGamma", m_cameraGamma );
+		m_cameraParameterSet[ PARAM_GAMMA ] = true;
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraWhitebalance" ) )
+	{
+		subgraph->m_DataflowAttributes.getAttributeData( "cameraWhitebalance", m_cameraWhitebalance );
+		m_cameraWhitebalanceAuto = false;
+		m_cameraParameterSet[ PARAM_WHITEBALANCE ] = true;
+	}
+	
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraWhitebalanceAuto" ) )
+	{
+		m_cameraWhitebalanceAuto = subgraph->m_DataflowAttributes.getAttributeString( "cameraWhitebalanceAuto" ) == "true";
+		m_cameraParameterSet[ PARAM_WHITEBALANCE ] = true;
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraBacklightComp" ) )
+	{
+		m_cameraBacklightComp = subgraph->m_DataflowAttributes.getAttributeString( "cameraBacklightComp" ) == "true";
+		m_cameraParameterSet[ PARAM_BACKLIGHT_COMPENSATION ] = true;
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraGain" ) )
+	{
+		subgraph->m_DataflowAttributes.getAttributeData( "cameraGain", m_cameraGain );
+		m_cameraParameterSet[ PARAM_GAIN ] = true;
+	}
+
+	boost::scoped_ptr< Vision::Undistortion > undistorter;
+	if (subgraph->m_DataflowAttributes.hasAttribute("cameraModelFile")){
+		std::string cameraModelFile = subgraph->m_DataflowAttributes.getAttributeString("cameraModelFile");
+		undistorter.reset(new Vision::Undistortion(cameraModelFile));
+	}
+	else {
+		std::string intrinsicFile = subgraph->m_DataflowAttributes.getAttributeString("intrinsicMatrixFile");
+		std::string distortionFile = subgraph->m_DataflowAttributes.getAttributeString("distortionFile");
+
+
+		undistorter.reset(new Vision::Undistortion(intrinsicFile, distortionFile));
+	}
+	m_undistortionMaps.reset( new UndistortionMapCache( undistorter->getIntrinsics() ) );
+
+	Vision::OpenCLManager& oclManager = Vision::OpenCLManager::singleton();
+	if (oclManager.isEnabled()) {
+		if (subgraph->m_DataflowAttributes.hasAttribute("uploadImageOnGPU")){
+			m_autoGPUUpload = subgraph->m_DataflowAttributes.getAttributeString("uploadImageOnGPU") == "true";
+			LOG4CPP_INFO(logger, "Upload to GPU enabled? " << m_autoGPUUpload);
+		}
+		if (m_autoGPUUpload){
+			oclManager.activate();
+			LOG4CPP_INFO(logger, "Require OpenCLManager");
+		}
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "asyncProcessing" ) )
+		m_asyncProcessing = subgraph->m_DataflowAttributes.getAttributeString( "asyncProcessing" ) == "true";
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "frameQueueSize" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "frameQueueSize", m_frameQueueSize );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "frameQueueDropPolicy" ) )
+		m_frameQueueDropNewest = subgraph->m_DataflowAttributes.getAttributeString( "frameQueueDropPolicy" ) == "dropNewest";
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "processingThreads" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "processingThreads", m_processingThreads );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "nativeFormats" ) )
+		m_nativeFormats = subgraph->m_DataflowAttributes.getAttributeString( "nativeFormats" ) == "true";
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "zeroCopy" ) )
+		m_zeroCopy = subgraph->m_DataflowAttributes.getAttributeString( "zeroCopy" ) == "true";
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "captureBackend" ) )
+	{
+		std::string sBackend = subgraph->m_DataflowAttributes.getAttributeString( "captureBackend" );
+		if ( sBackend != "directShow" && sBackend != "mediaFoundation" )
+			UBITRACK_THROW( "Unsupported capture backend: " + sBackend );
+		m_mediaFoundation = sBackend == "mediaFoundation";
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "hardwareDecode" ) )
+		m_hardwareDecode = subgraph->m_DataflowAttributes.getAttributeString( "hardwareDecode" ) == "true";
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "probeDuration" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "probeDuration", m_probeDuration );
+	if ( m_probeDuration > 0 )
+	{
+		m_probeReport = subgraph->m_DataflowAttributes.getAttributeString( "probeReport" );
+		m_probeGoal = probeGoalFromName( subgraph->m_DataflowAttributes.getAttributeString( "probeGoal" ) );
+		if ( subgraph->m_DataflowAttributes.hasAttribute( "probeLatencyBudget" ) )
+			subgraph->m_DataflowAttributes.getAttributeData( "probeLatencyBudget", m_probeLatencyBudget );
+		if ( m_mediaFoundation )
+		{
+			LOG4CPP_WARN( logger, "Probing capture modes needs the DirectShow backend, it is disabled with Media Foundation" );
+			m_probeDuration = 0;
+		}
+	}
+
+	m_streamingThreadSettings.configure( readThreadSettings( subgraph, "streamingThread" ) );
+	m_workerThreadSettings = readThreadSettings( subgraph, "workerThread" );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "statisticsInterval" ) )
+	{
+		int statisticsInterval = 0;
+		subgraph->m_DataflowAttributes.getAttributeData( "statisticsInterval", statisticsInterval );
+		m_statistics.setInterval( statisticsInterval );
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "targetRate" ) )
+	{
+		double targetRate = 0;
+		subgraph->m_DataflowAttributes.getAttributeData( "targetRate", targetRate );
+		m_scheduler.setTargetRate( targetRate );
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "latencyBudget" ) )
+	{
+		double latencyBudget = 0;
+		subgraph->m_DataflowAttributes.getAttributeData( "latencyBudget", latencyBudget );
+		m_scheduler.setLatencyBudget( latencyBudget );
+	}
+	m_scheduler.setWorkers( m_asyncProcessing ? m_processingThreads : 1 );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "motionThreshold" ) )
+	{
+		double motionThreshold = 0;
+		double motionKeepAlive = 1000;
+		int motionGridSize = 32;
+		subgraph->m_DataflowAttributes.getAttributeData( "motionThreshold", motionThreshold );
+		if ( subgraph->m_DataflowAttributes.hasAttribute( "motionKeepAlive" ) )
+			subgraph->m_DataflowAttributes.getAttributeData( "motionKeepAlive", motionKeepAlive );
+		if ( subgraph->m_DataflowAttributes.hasAttribute( "motionGridSize" ) )
+			subgraph->m_DataflowAttributes.getAttributeData( "motionGridSize", motionGridSize );
+		m_motionGate.configure( motionThreshold, motionKeepAlive, motionGridSize );
+		if ( m_motionGate.enabled() )
+			LOG4CPP_INFO( logger, "Motion gate enabled: threshold=" << motionThreshold << ", keep-alive=" << motionKeepAlive << 
+				"ms, grid=" << motionGridSize << "x" << motionGridSize );
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "imagePoolSize" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "imagePoolSize", m_imagePoolSize );
+	m_imagePool.reset( new ImagePool( m_imagePoolSize > 0 ? m_imagePoolSize : 0 ) );
+
+	// pull ports for polling consumers, fed from a history instead of delaying the capture
+	int pullHistorySize = 4;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "pullHistorySize" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "pullHistorySize", pullHistorySize );
+	if ( subgraph->m_Edges.find( "LatestOutput" ) != subgraph->m_Edges.end() )
+	{
+		m_latestHistory.reset( new FrameHistory( pullHistorySize > 0 ? pullHistorySize : 1 ) );
+		m_latestOutPort.reset( new Dataflow::PullSupplier< Measurement::ImageMeasurement >( "LatestOutput", *this,
+			boost::bind( &DirectShowFrameGrabber::getLatest, this, _1 ) ) );
+	}
+	if ( subgraph->m_Edges.find( "LatestColorOutput" ) != subgraph->m_Edges.end() )
+	{
+		m_latestColorHistory.reset( new FrameHistory( pullHistorySize > 0 ? pullHistorySize : 1 ) );
+		m_latestColorOutPort.reset( new Dataflow::PullSupplier< Measurement::ImageMeasurement >( "LatestColorOutput", *this,
+			boost::bind( &DirectShowFrameGrabber::getLatestColor, this, _1 ) ) );
+	}
+
+	// batches for throughput oriented consumers, in buffers of the image pool
+	if ( subgraph->m_Edges.find( "BatchOutput" ) != subgraph->m_Edges.end() )
+	{
+		int batchSize = 8;
+		double batchWindow = 0;
+		if ( subgraph->m_DataflowAttributes.hasAttribute( "batchSize" ) )
+			subgraph->m_DataflowAttributes.getAttributeData( "batchSize", batchSize );
+		if ( subgraph->m_DataflowAttributes.hasAttribute( "batchWindow" ) )
+			subgraph->m_DataflowAttributes.getAttributeData( "batchWindow", batchWindow );
+		if ( subgraph->m_DataflowAttributes.getAttributeString( "batchSource" ) == "color" )
+			m_batchSource = FramePipeline::OUTPUT_COLOR;
+
+		m_pBatcher.reset( new FrameBatcher( m_imagePool, batchSize > 0 ? batchSize : 1,
+			batchWindow > 0 ? static_cast< Measurement::Timestamp >( batchWindow * 1e6 ) : 0 ) );
+		m_batchOutPort.reset( new Dataflow::PushSupplier< Measurement::ImageMeasurement >( "BatchOutput", *this ) );
+		if ( subgraph->m_Edges.find( "BatchTimestamps" ) != subgraph->m_Edges.end() )
+			m_batchTimesOutPort.reset( new Dataflow::PushSupplier< Measurement::DistanceList >( "BatchTimestamps", *this ) );
+		LOG4CPP_INFO( logger, "Batch output enabled: size=" << ( batchSize > 0 ? batchSize : 1 ) << ", window=" << batchWindow <<
+			"ms, source=" << ( m_batchSource == FramePipeline::OUTPUT_COLOR ? "color" : "greyscale" ) );
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "captureBuffers" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "captureBuffers", m_captureBuffers );
+
+	// every frame held downstream (or in the queue, or in a pull history) blocks one sample buffer
+	if ( m_zeroCopy && m_captureBuffers <= 0 )
+	{
+		m_captureBuffers = ( m_asyncProcessing ? m_frameQueueSize + m_processingThreads : 1 ) + 4;
+		if ( m_latestHistory )
+			m_captureBuffers += m_latestHistory->size();
+		if ( m_latestColorHistory )
+			m_captureBuffers += m_latestColorHistory->size();
+	}
+
+	if ( m_asyncProcessing )
+	{
+		m_frameQueue.reset( new FrameQueue< QueuedFrame >( m_frameQueueSize > 0 ? m_frameQueueSize : 1,
+			m_frameQueueDropNewest ? FrameQueue< QueuedFrame >::DropNewest : FrameQueue< QueuedFrame >::DropOldest ) );
+		LOG4CPP_INFO( logger, "Asynchronous processing enabled: queue size=" << m_frameQueue->capacity() <<
+			", threads=" << m_processingThreads << ", drop " << ( m_frameQueueDropNewest ? "newest" : "oldest" ) );
+	}
+
+	m_pipeline.reset( new FramePipeline( m_imagePool, *m_undistortionMaps, m_statistics ) );
+	m_pipeline->setDesiredSize( m_desiredWidth, m_desiredHeight );
+	m_pipeline->setGPUUpload( m_autoGPUUpload );
+	configureBands( subgraph, *m_pipeline );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "binning" ) )
+	{
+		int binning = 1;
+		subgraph->m_DataflowAttributes.getAttributeData( "binning", binning );
+		m_pipeline->setBinning( binning );
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "pyramidLevels" ) )
+	{
+		int levels = 4;
+		subgraph->m_DataflowAttributes.getAttributeData( "pyramidLevels", levels );
+		m_pipeline->setPyramidLevels( levels );
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "regionOfInterest" ) )
+		m_pipeline->setRegionOfInterest( parseRegion( subgraph->m_DataflowAttributes.getAttributeString( "regionOfInterest" ) ) );
+
+	// dynamically generate input ports
+	for (Graph::UTQLSubgraph::EdgeMap::iterator it = subgraph->m_Edges.begin(); it != subgraph->m_Edges.end(); it++)
+	{
+		if (it->second->isInput())
+		{
+			if (0 == it->first.compare(0, 15, "InputIntrinsics")) {
+				m_intrinsicInPort.reset(new Dataflow::PushConsumer< Measurement::CameraIntrinsics >(it->first, *this,
+					boost::bind(&DirectShowFrameGrabber::newIntrinsicsPush, this, _1)));
+
+			}
+			else if ( it->first == "RegionOfInterest" )
+				m_regionInPort.reset( new Dataflow::PushConsumer< Measurement::Vector4D >( it->first, *this,
+					boost::bind( &DirectShowFrameGrabber::newRegionPush, this, _1 ) ) );
+			else if ( it->first == "CameraControl" )
+				m_cameraControlInPort.reset( new Dataflow::PushConsumer< Measurement::Vector4D >( it->first, *this,
+					boost::bind( &DirectShowFrameGrabber::newCameraControlPush, this, _1 ) ) );
+			
+		}
+	}
+
+	
+
+	initGraph();
+
+	m_pEventThread.reset( new boost::thread( boost::bind( &DirectShowFrameGrabber::eventThread, this ) ) );
+}
+
+void DirectShowFrameGrabber::newIntrinsicsPush(Measurement::CameraIntrinsics intrinsics) {
+	// the remap tables are built in the background, frames keep using the old ones until then
+	m_undistortionMaps->update( *intrinsics );
+}
+
+
+void DirectShowFrameGrabber::newRegionPush( Measurement::Vector4D region )
+{
+	// takes effect with the next frame
+	m_pipeline->setRegionOfInterest( cv::Rect( cvRound( (*region)( 0 ) ), cvRound( (*region)( 1 ) ), 
+		cvRound( (*region)( 2 ) ), cvRound( (*region)( 3 ) ) ) );
+}
+
+
+void DirectShowFrameGrabber::newCameraControlPush( Measurement::Vector4D control )
+{
+	int parameter = cvRound( (*control)( 0 ) );
+	long value = cvRound( (*control)( 1 ) );
+	bool bAuto = (*control)( 2 ) != 0;
+	if ( parameter < 0 || parameter >= PARAM_COUNT )
+	{
+		LOG4CPP_WARN( logger, "Unknown camera parameter " << parameter );
+		return;
+	}
+
+	// manual exposure or gain overrides the auto exposure, auto exposure hands over to the controller if there is one
+	if ( parameter == PARAM_EXPOSURE || parameter == PARAM_GAIN )
+	{
+		if ( bAuto && m_autoExposureTarget > 0 )
+		{
+			if ( parameter == PARAM_EXPOSURE )
+				m_exposureController.suspend( false );
+			return;
+		}
+		m_exposureController.suspend( true );
+	}
+
+	// the control thread is replaced when the graph is rebuilt after a device loss
+	boost::mutex::scoped_lock l( m_graphMutex );
+	if ( m_pCameraControl )
+		m_pCameraControl->post( CameraParameter( parameter ), value, bAuto );
+}
+
+
+void DirectShowFrameGrabber::postCameraParameters()
+{
+	// the attributes are applied again whenever the graph is rebuilt
+	const long values[ PARAM_COUNT ] = { m_cameraExposure, m_cameraGain, m_cameraBrightness, m_cameraContrast, m_cameraSaturation,
+		m_cameraSharpness, m_cameraGamma, m_cameraWhitebalance, m_cameraBacklightComp ? 1 : 0, 0 };
+	for ( int parameter = 0; parameter < PARAM_COUNT; parameter++ )
+	{
+		if ( !m_cameraParameterSet[ parameter ] )
+			continue;
+
+		bool bAuto = ( parameter == PARAM_EXPOSURE && m_cameraExposureAuto ) || ( parameter == PARAM_WHITEBALANCE && m_cameraWhitebalanceAuto );
+		m_pCameraControl->post( CameraParameter( parameter ), values[ parameter ], bAuto );
+	}
+}
+
+
+void DirectShowFrameGrabber::initExposureControl()
+{
+	long minExposure, maxExposure, minGain, maxGain, step, def, exposure, gain;
+	bool bAuto;
+	if ( !m_pCameraControl->range( PARAM_EXPOSURE, minExposure, maxExposure, step, def ) || 
+		!m_pCameraControl->get( PARAM_EXPOSURE, exposure, bAuto ) )
+	{
+		LOG4CPP_WARN( logger, "Camera does not support setting the exposure, auto exposure disabled" );
+		return;
+	}
+	if ( !m_pCameraControl->range( PARAM_GAIN, minGain, maxGain, step, def ) || !m_pCameraControl->get( PARAM_GAIN, gain, bAuto ) )
+	{
+		// exposure only
+		minGain = maxGain = gain = 0;
+		step = 1;
+	}
+
+	if ( m_maxExposureTime > 0 )
+	{
+		long bound = exposureFromMilliseconds( m_maxExposureTime );
+		if ( bound < minExposure )
+			bound = minExposure;
+		if ( bound < maxExposure )
+			maxExposure = bound;
+	}
+	if ( exposure > maxExposure )
+		exposure = maxExposure;
+
+	if ( m_sampleFormat == SAMPLE_MJPG )
+		LOG4CPP_WARN( logger, "Auto exposure needs uncompressed samples, it has no effect with MJPG" );
+	LOG4CPP_INFO( logger, "Auto exposure to brightness " << m_autoExposureTarget << " with exposure " << minExposure << ".." << maxExposure << 
+		" and gain " << minGain << ".." << maxGain );
+
+	m_exposureController.configure( m_autoExposureTarget, minExposure, maxExposure, minGain, maxGain, step );
+	m_exposureController.setCurrent( exposure, gain );
+
+	// the camera's own auto exposure would fight the controller
+	m_pCameraControl->post( PARAM_EXPOSURE, exposure, false );
+}
+
+
+void DirectShowFrameGrabber::updateExposure( const cv::Mat& sample )
+{
+	double luma = sampleMeanLuma( m_sampleFormat, sample, m_sampleWidth, m_sampleHeight, 32 );
+	long exposure, gain;
+	if ( luma >= 0 && m_exposureController.update( luma, exposure, gain ) )
+	{
+		// unchanged values are skipped by the control thread
+		m_pCameraControl->post( PARAM_EXPOSURE, exposure, false );
+		m_pCameraControl->post( PARAM_GAIN, gain, false );
+	}
+}
+
+
+DirectShowFrameGrabber::~DirectShowFrameGrabber()
+{
+	m_bStopEvents = true;
+	if ( m_pEventThread )
+		m_pEventThread->join();
+
+	if ( m_pMediaControl )
+		m_pMediaControl->Stop();
+	m_pMFCapture.reset();
+	stopProcessing();
+	m_pCameraControl.reset();
+	CoUninitialize();
+}
+
+
+void DirectShowFrameGrabber::start()
+{
+	if ( !m_running ) {
+		m_scheduler.reset();
+		m_motionGate.reset();
+		startProcessing();
+		if (m_autoGPUUpload) {
+			LOG4CPP_INFO(logger, "Waiting for OpenCLManager initialization callback.");
+			Vision::OpenCLManager& oclManager = Vision::OpenCLManager::singleton();
+			oclManager.registerInitCallback(boost::bind(&DirectShowFrameGrabber::startCapturing, this));
+		}
+		else {
+			startCapturing();
+		}
+		m_running = true;
+	}
+	Component::start();
+}
+
+void DirectShowFrameGrabber::startCapturing()
+{
+	boost::mutex::scoped_lock l( m_graphMutex );
+
+	// now that the OpenCL context exists, hardware decoded frames can be kept on its D3D11 device.
+	// Recording, auto exposure and the motion gate need the samples in host memory.
+	if ( m_pMFCapture && m_autoGPUUpload && m_hardwareDecode && !m_pD3D11Sharing && !m_pRecorder && 
+		!m_exposureController.enabled() && !m_motionGate.enabled() && m_pMFCapture->format() == SAMPLE_NV12 )
+	{
+		m_pD3D11Sharing.reset( new D3D11Sharing );
+		if ( m_pD3D11Sharing->available() )
+		{
+			LOG4CPP_INFO( logger, getName() << ": reopening the camera to decode on the D3D11 device of the OpenCL context" );
+			releaseGraph();
+			try
+			{
+				initGraph( true );
+			}
+			catch ( const std::exception& e )
+			{
+				LOG4CPP_WARN( logger, getName() << ": unable to decode on the D3D11 device of the OpenCL context: " << e.what() );
+				m_pD3D11Sharing.reset();
+				releaseGraph();
+				initGraph( true );
+			}
+		}
+	}
+
+	runGraph();
+
+	if ( m_probeDuration > 0 && !m_bProbed )
+	{
+		m_bProbed = true;
+		m_bProbePending = true;
+	}
+}
+
+void DirectShowFrameGrabber::runGraph()
+{
+	if ( m_pMFCapture )
+		m_pMFCapture->start();
+	else if ( m_pMediaControl )
+		m_clock.run( m_pMediaControl );
+}
+
+void DirectShowFrameGrabber::stop()
+{
+	{
+		boost::mutex::scoped_lock l( m_graphMutex );
+		if ( m_running && m_pMediaControl )
+			m_pMediaControl->Pause();
+		if ( m_running && m_pMFCapture )
+			m_pMFCapture->pause();
+	}
+	stopProcessing();
+
+	// the last frames would otherwise be batched with the first frames after a restart
+	FrameBatch batch;
+	if ( m_pBatcher && m_pBatcher->flush( batch ) )
+		sendBatch( batch );
+	Component::stop();
+}
+
+
+void DirectShowFrameGrabber::sendBatch( const FrameBatch& batch )
+{
+	Measurement::Timestamp batchTime = batch.times.front();
+	if ( m_batchTimesOutPort )
+	{
+		// offsets instead of absolute nanoseconds, which a double cannot hold exactly.
+		// Frames of several processing threads may be slightly out of order, so offsets can be negative.
+		std::vector< Math::Scalar< double > > offsets;
+		offsets.reserve( batch.times.size() );
+		for ( std::size_t i = 0; i < batch.times.size(); i++ )
+		{
+			long long offset = static_cast< long long >( batch.times[ i ] - batchTime );
+			offsets.push_back( Math::Scalar< double >( offset * 1e-6 ) );
+		}
+		m_batchTimesOutPort->send( Measurement::DistanceList( batchTime, offsets ) );
+	}
+	m_batchOutPort->send( Measurement::ImageMeasurement( batchTime, batch.image ) );
+}
+
+
+void DirectShowFrameGrabber::releaseGraph()
+{
+	if ( m_pMediaControl )
+		m_pMediaControl->Stop();
+	m_pMFCapture.reset();
+	m_streamingThreadSettings.reset();
+	m_pCameraControl.reset();
+	m_clock.release();
+	m_pMediaEvent.Release();
+	m_pMediaControl.Release();
+}
+
+
+void DirectShowFrameGrabber::eventThread()
+{
+	CoInitializeEx( NULL, COINIT_MULTITHREADED );
+
+	while ( !m_bStopEvents )
+	{
+		if ( m_bProbePending.exchange( false ) )
+		{
+			measureCaptureModes();
+			continue;
+		}
+
+		// a batch whose window has passed is sent even if no further frame comes, e.g. when frames are skipped
+		FrameBatch batch;
+		if ( m_pBatcher && m_pBatcher->expire( Measurement::now() + 1000000L * m_timeOffset, batch ) )
+			sendBatch( batch );
+
+		// only this thread replaces the graph, so the event interface stays valid while waiting
+		long code = 0;
+		if ( m_mediaFoundation )
+		{
+			// the source reader reports stream errors with the sample requests, there are no graph events.
+			// The capture device is also replaced when capturing starts, see startCapturing.
+			boost::this_thread::sleep( boost::posix_time::milliseconds( 200 ) );
+			boost::mutex::scoped_lock l( m_graphMutex );
+			if ( !m_pMFCapture || !m_pMFCapture->lost() )
+				continue;
+		}
+		else
+		{
+			LONG_PTR param1, param2;
+			if ( !m_pMediaEvent || FAILED( m_pMediaEvent->GetEvent( &code, &param1, &param2, 200 ) ) )
+			{
+				if ( !m_pMediaEvent )
+					boost::this_thread::sleep( boost::posix_time::milliseconds( 200 ) );
+				continue;
+			}
+			m_pMediaEvent->FreeEventParams( code, param1, param2 );
+
+			// EC_DEVICE_LOST is also sent with param2 = 1 when the device comes back
+			bool bLost = ( code == EC_DEVICE_LOST && param2 == 0 ) || code == EC_ERRORABORT || code == EC_STREAM_ERROR_STOPPED;
+			if ( !bLost )
+				continue;
+		}
+
+		LOG4CPP_WARN( logger, getName() << ": capture device lost (event " << code << "), reconnecting" );
+		m_statistics.count( FrameStatistics::COUNTER_DEVICE_LOST );
+		m_lostTime = Measurement::now();
+		reconnect();
+	}
+
+	CoUninitialize();
+}
+
+
+void DirectShowFrameGrabber::measureCaptureModes()
+{
+	// every mode of the pin with a usable pixel format, at its highest frame rate. The pipeline keeps
+	// its output size, so the measurements include resizing other sizes to it.
+	std::vector< CaptureMode > candidates;
+	{
+		boost::mutex::scoped_lock l( m_graphMutex );
+		for ( std::size_t i = 0; i < m_captureModes.size(); i++ )
+		{
+			const CaptureMode& mode = m_captureModes[ i ];
+			if ( mode.format == SAMPLE_UNKNOWN || ( m_desiredPixelFormat != SAMPLE_UNKNOWN && mode.format != m_desiredPixelFormat ) )
+				continue;
+
+			// drivers list some modes repeatedly
+			bool bDuplicate = false;
+			for ( std::size_t j = 0; j < candidates.size() && !bDuplicate; j++ )
+				bDuplicate = candidates[ j ].format == mode.format && candidates[ j ].width == mode.width &&
+					candidates[ j ].height == mode.height && candidates[ j ].minInterval == mode.minInterval;
+			if ( !bDuplicate )
+				candidates.push_back( mode );
+		}
+	}
+
+	if ( candidates.empty() )
+	{
+		LOG4CPP_WARN( logger, getName() << ": no capture modes to probe" );
+		return;
+	}
+	LOG4CPP_INFO( logger, getName() << ": probing " << candidates.size() << " capture modes for " << m_probeDuration << "s each" );
+
+	int desiredWidth = m_desiredWidth;
+	int desiredHeight = m_desiredHeight;
+	SampleFormat desiredPixelFormat = m_desiredPixelFormat;
+	double desiredFrameRate = m_desiredFrameRate;
+
+	std::vector< ProbeResult > results;
+	bool bStopped = false;
+	for ( std::size_t i = 0; i < candidates.size() && !bStopped; i++ )
+	{
+		ProbeResult result;
+		result.mode = candidates[ i ];
+		result.requestedRate = result.mode.minInterval > 0 ? 1e7 / result.mode.minInterval : 0;
+
+		// the workers convert the frames with the sample format, which changes with the mode
+		suspendProcessing();
+		try
+		{
+			boost::mutex::scoped_lock l( m_graphMutex );
+			releaseGraph();
+			m_desiredWidth = result.mode.width;
+			m_desiredHeight = result.mode.height;
+			m_desiredPixelFormat = result.mode.format;
+			m_desiredFrameRate = result.requestedRate;
+			initGraph( true );
+			m_scheduler.resetPacing();
+			if ( m_running )
+				runGraph();
+			result.opened = true;
+		}
+		catch ( const std::exception& e )
+		{
+			LOG4CPP_WARN( logger, getName() << ": unable to open capture mode " << result.mode.index << ": " << e.what() );
+			boost::mutex::scoped_lock l( m_graphMutex );
+			releaseGraph();
+		}
+		resumeProcessing();
+
+		// the first frames after starting are often late, e.g. while the camera adjusts its exposure
+		if ( result.opened && probeWait( 500 ) )
+		{
+			m_probe.begin();
+			bStopped = !probeWait( m_probeDuration * 1000 );
+			m_probe.end( result );
+		}
+		else if ( result.opened )
+			bStopped = true;
+
+		if ( !bStopped )
+		{
+			LOG4CPP_INFO( logger, getName() << ": mode " << result.mode.index << " " << result.mode.width << "x" << result.mode.height << " " <<
+				sampleFormatName( result.mode.format ) << " @ " << result.requestedRate << " fps: delivered " << result.frameRate << 
+				" fps, jitter " << result.jitter << "ms, cpu " << result.cpuPerFrame << "ms/frame, latency " << result.latency << 
+				"ms (max " << result.maxLatency << "ms)" );
+			results.push_back( result );
+		}
+	}
+
+	m_desiredWidth = desiredWidth;
+	m_desiredHeight = desiredHeight;
+	m_desiredPixelFormat = desiredPixelFormat;
+	m_desiredFrameRate = desiredFrameRate;
+
+	int selected = -1;
+	if ( bStopped )
+		LOG4CPP_WARN( logger, getName() << ": probing aborted, the component was stopped" );
+	else if ( m_probeGoal != PROBE_REPORT )
+	{
+		bool bConstraintsMet = false;
+		selected = selectProbeResult( results, m_probeGoal, desiredFrameRate, m_probeLatencyBudget, bConstraintsMet );
+		if ( selected < 0 )
+			LOG4CPP_WARN( logger, getName() << ": no capture mode delivered frames, keeping the configuration" );
+		else
+		{
+			const ProbeResult& best = results[ selected ];
+			if ( !bConstraintsMet )
+				LOG4CPP_WARN( logger, getName() << ": no capture mode reaches the frame rate and latency budget, using the best one" );
+			LOG4CPP_INFO( logger, getName() << ": selected mode " << best.mode.index << " " << best.mode.width << "x" << best.mode.height << 
+				" " << sampleFormatName( best.mode.format ) << " @ " << best.requestedRate << " fps" );
+			m_desiredWidth = best.mode.width;
+			m_desiredHeight = best.mode.height;
+			m_desiredPixelFormat = best.mode.format;
+			m_desiredFrameRate = best.requestedRate;
+		}
+	}
+
+	if ( !m_probeReport.empty() && !results.empty() )
+		writeProbeReport( m_probeReport, m_cameraName, results, selected );
+
+	// back to the configured or the selected mode
+	suspendProcessing();
+	try
+	{
+		boost::mutex::scoped_lock l( m_graphMutex );
+		releaseGraph();
+		initGraph( true );
+		m_scheduler.resetPacing();
+		if ( m_running )
+			runGraph();
+	}
+	catch ( const std::exception& e )
+	{
+		LOG4CPP_WARN( logger, getName() << ": unable to reopen the camera after probing: " << e.what() );
+		m_lostTime = Measurement::now();
+
+		// resumes the processing once the camera is open again
+		reconnect();
+		return;
+	}
+	resumeProcessing();
+}
+
+
+bool DirectShowFrameGrabber::probeWait( double ms )
+{
+	Measurement::Timestamp end = Measurement::now() + Measurement::Timestamp( ms * 1e6 );
+	while ( !m_bStopEvents && m_running && Measurement::now() < end )
+		boost::this_thread::sleep( boost::posix_time::milliseconds( 50 ) );
+	return !m_bStopEvents && m_running;
+}
+
+
+void DirectShowFrameGrabber::reconnect()
+{
+	suspendProcessing();
+	{
+		boost::mutex::scoped_lock l( m_graphMutex );
+		releaseGraph();
+	}
+
+	for ( int attempt = 1; !m_bStopEvents; attempt++ )
+	{
+		try
+		{
+			boost::mutex::scoped_lock l( m_graphMutex );
+			initGraph( true );
+			if ( m_running )
+				runGraph();
+			LOG4CPP_INFO( logger, getName() << ": reconnected after " << attempt << " attempts, " << 
+				( Measurement::now() - m_lostTime ) / 1000000 << "ms" );
+			resumeProcessing();
+			return;
+		}
+		catch ( const std::exception& e )
+		{
+			LOG4CPP_DEBUG( logger, getName() << ": reconnect attempt " << attempt << " failed: " << e.what() );
+			boost::mutex::scoped_lock l( m_graphMutex );
+			releaseGraph();
+		}
+
+		// a device that has just been plugged in needs some time until it can be opened
+		for ( int i = 0; i < 10 && !m_bStopEvents; i++ )
+			boost::this_thread::sleep( boost::posix_time::milliseconds( 100 ) );
+	}
+}
+
+
+void DirectShowFrameGrabber::startProcessing()
+{
+	if ( !m_frameQueue )
+		return;
+
+	boost::mutex::scoped_lock l( m_processingMutex );
+	m_bProcessing = true;
+	startWorkers();
+}
+
+
+void DirectShowFrameGrabber::stopProcessing()
+{
+	if ( !m_frameQueue )
+		return;
+
+	boost::mutex::scoped_lock l( m_processingMutex );
+	m_bProcessing = false;
+	stopWorkers();
+}
+
+
+void DirectShowFrameGrabber::suspendProcessing()
+{
+	if ( !m_frameQueue )
+		return;
+
+	boost::mutex::scoped_lock l( m_processingMutex );
+	stopWorkers();
+}
+
+
+void DirectShowFrameGrabber::resumeProcessing()
+{
+	if ( !m_frameQueue )
+		return;
+
+	boost::mutex::scoped_lock l( m_processingMutex );
+	if ( m_bProcessing )
+		startWorkers();
+}
+
+
+void DirectShowFrameGrabber::startWorkers()
+{
+	if ( !m_workers.empty() )
+		return;
+
+	// frames of the previous graph may have a different format. They were admitted by the scheduler,
+	// which would otherwise count them as in flight for good.
+	m_scheduler.discarded( static_cast< unsigned long >( m_frameQueue->reset() ) );
+	for ( int i = 0; i < m_processingThreads || i == 0; i++ )
+		m_workers.push_back( boost::shared_ptr< boost::thread >(
+			new boost::thread( boost::bind( &DirectShowFrameGrabber::processingThread, this ) ) ) );
+}
+
+
+void DirectShowFrameGrabber::stopWorkers()
+{
+	m_frameQueue->shutdown();
+	for ( std::size_t i = 0; i < m_workers.size(); i++ )
+		m_workers[ i ]->join();
+	m_workers.clear();
+}
+
+
+void DirectShowFrameGrabber::processingThread()
+{
+	ScopedThreadSettings threadSettings( m_workerThreadSettings, getName() + " worker" );
+
+	QueuedFrame frame;
+	while ( m_frameQueue->pop( frame ) )
+	{
+		Measurement::Timestamp start = Measurement::now();
+		try
+		{
+			handleFrame( frame.time, frame.image, false );
+		}
+		catch ( const std::exception& e )
+		{
+			// an uncaught exception would terminate the application
+			LOG4CPP_ERROR( logger, getName() << ": error processing a frame: " << e.what() );
+		}
+		frame.image.reset();
+		m_scheduler.finished( Measurement::now() - start );
+	}
+}
+
+
+void DirectShowFrameGrabber::initGraph( bool bReconnect )
+{
+	if ( m_mediaFoundation )
+	{
+		initMediaFoundation( bReconnect );
+		return;
+	}
+
+	AutoComPtr< IMoniker > pSelectedMoniker;
+	std::string sSelectedCamera;
+	std::string sSelectedPath;
+	findCaptureDevice( m_desiredName, m_desiredDevicePath, *m_pDeviceCache, pSelectedMoniker, sSelectedCamera, sSelectedPath );
+
+	// check if a capture device was found
+	if ( !pSelectedMoniker )
+		UBITRACK_THROW( "No video capture device found" );
+
+	// another camera must not silently replace the lost one
+	if ( bReconnect && sSelectedCamera.empty() && !m_desiredName.empty() )
+		UBITRACK_THROW( "Video capture device not found: " + m_desiredName );
+
+	LOG4CPP_INFO( logger, "Using camera: " << sSelectedCamera );
+
+	// create capture graph
+	AutoComPtr< IGraphBuilder > pGraph;
+	AutoComPtr< ICaptureGraphBuilder2 > pBuild;
+	createCaptureGraph( pGraph, pBuild );
+
+	CaptureSettings settings;
+	settings.width = m_desiredWidth;
+	settings.height = m_desiredHeight;
+	settings.frameRate = m_desiredFrameRate;
+	settings.pixelFormat = m_desiredPixelFormat;
+	settings.nativeFormats = m_nativeFormats;
+	settings.captureBuffers = m_captureBuffers;
+	settings.zeroCopy = m_zeroCopy;
+
+	AutoComPtr< IBaseFilter > pCaptureFilter;
+	CaptureFormat format;
+	addCaptureBranch( pGraph, pBuild, pSelectedMoniker, settings, *m_pDeviceCache, sSelectedPath, this, pCaptureFilter, format, &m_captureModes );
+	m_cameraName = sSelectedCamera;
+	setSampleFormat( format, bReconnect );
+
+	initCameraControl( pCaptureFilter );
+
+	// start stream
+	pGraph.QueryInterface< IMediaControl >( m_pMediaControl );
+	if ( FAILED( pGraph.QueryInterface< IMediaEventEx >( m_pMediaEvent ) ) )
+		LOG4CPP_WARN( logger, "Unable to get IMediaEventEx interface, lost devices are not detected" );
+	m_pMediaControl->Pause();
+	m_clock.init( pGraph );
+}
+
+
+void DirectShowFrameGrabber::initMediaFoundation( bool bReconnect )
+{
+	MediaFoundationSettings settings;
+	settings.width = m_desiredWidth;
+	settings.height = m_desiredHeight;
+	settings.frameRate = m_desiredFrameRate;
+	settings.pixelFormat = m_desiredPixelFormat;
+	settings.nativeFormats = m_nativeFormats;
+	settings.hardwareDecode = m_hardwareDecode;
+	if ( m_pD3D11Sharing && m_pD3D11Sharing->available() )
+	{
+		settings.pDevice = m_pD3D11Sharing->device();
+		settings.textureSamples = true;
+	}
+
+	// another camera must not silently replace the lost one
+	bool bFallback = !bReconnect || m_desiredName.empty();
+	m_pMFCapture.reset( new MediaFoundationCapture( m_desiredName, m_desiredDevicePath, bFallback, settings, 
+		boost::bind( &DirectShowFrameGrabber::mediaFoundationSample, this, _1 ) ) );
+
+	CaptureFormat format;
+	format.format = m_pMFCapture->format();
+	format.width = m_pMFCapture->width();
+	format.height = m_pMFCapture->height();
+	format.bottomUp = m_pMFCapture->bottomUp();
+	setSampleFormat( format, bReconnect );
+
+	initCameraControl( m_pMFCapture->device() );
+}
 
-	/** brightness control */
-	int m_cameraBrightness;
 
-	/** contrast control */
-	int m_cameraContrast;
+void DirectShowFrameGrabber::setSampleFormat( const CaptureFormat& format, bool bReconnect )
+{
+	m_sampleFormat = format.format;
+	m_sampleWidth = format.width;
+	m_sampleHeight = format.height;
+	m_sampleBottomUp = format.bottomUp;
+	m_pipeline->setSampleFormat( m_sampleFormat, m_sampleWidth, m_sampleHeight );
+
+	m_motionGate.reset();
+	if ( m_motionGate.enabled() && m_sampleFormat == SAMPLE_MJPG )
+		LOG4CPP_WARN( logger, "The motion gate needs uncompressed samples, it has no effect with MJPG" );
+
+	// a recording holds a single format, it is not continued if a reconnected device delivers another one
+	if ( !m_recordingFile.empty() )
+	{
+		RecordingFormat recordingFormat( m_sampleFormat, m_sampleWidth, m_sampleHeight, m_sampleBottomUp );
+		if ( !m_pRecorder && !bReconnect )
+			m_pRecorder.reset( new SampleRecorder( m_recordingFile, recordingFormat, m_recordingQueueSize ) );
+		else if ( m_pRecorder && !( m_pRecorder->format() == recordingFormat ) )
+		{
+			LOG4CPP_WARN( logger, "Sample format changed after reconnecting, recording stopped" );
+			m_pRecorder.reset();
+		}
+	}
+}
 
-	/** saturation control */
-	int m_cameraSaturation;
 
-	/** sharpness control */
-	int m_cameraSharpness;
+void DirectShowFrameGrabber::initCameraControl( IUnknown* pDevice )
+{
+	// parameters changed while capturing are applied in the background
+	m_pCameraControl.reset( new CameraControlThread( pDevice ) );
+	m_pCameraControl->logParameters();
+	postCameraParameters();
+	if ( m_autoExposureTarget > 0 )
+		initExposureControl();
+}
 
-	/** gamma control */
-	int m_cameraGamma;
 
-	/** whitebalance control */
-	int m_cameraWhitebalance;
-	bool m_cameraWhitebalanceAuto;
 
-	/** gain control */
-	bool m_cameraBacklightComp;
+void DirectShowFrameGrabber::handleFrame( Measurement::Timestamp utTime, boost::shared_ptr< Vision::Image > pBufferImage, bool bTransient )
+{
+#ifdef ENABLE_EVENT_TRACING
+	TRACEPOINT_MEASUREMENT_CREATE(getEventDomain(), utTime, getName().c_str(), "VideoCapture")
+#endif
 
-	/** gain control */
-	int m_cameraGain;
+	PortSink sink( *this, utTime );
+	m_pipeline->process( pBufferImage, bTransient, sink );
 
+	if ( m_probe.active() )
+	{
+		// end-to-end from the capture time, without the configured shift
+		Measurement::Timestamp captureTime = utTime - 1000000L * m_timeOffset;
+		Measurement::Timestamp now = Measurement::now();
+		m_probe.frameProcessed( now > captureTime ? now - captureTime : 0 );
+	}
+}
 
-	/** number of frames received */
-	int m_nFrames;
 
-	/** timestamp of last frame */
-	double m_lastTime;
+STDMETHODIMP DirectShowFrameGrabber::SampleCB( double Time, IMediaSample *pSample )
+{
+	LOG4CPP_DEBUG( logger, "SampleCB called" );
+	m_streamingThreadSettings.update( getName() );
+	//if(!Ubitrack::Vision::OpenCLManager::singleton().isInitialized())
+	//{
+	//	LOG4CPP_INFO( logger, "skipping frame; OpenCL Manager not initialized");
+	//	return S_OK;
+	//}
 
-	/** automatic upload of images to the GPU*/
-	bool m_autoGPUUpload;
+	// compressed samples only fill part of the buffer
+	long sampleLength = m_sampleFormat == SAMPLE_MJPG ? pSample->GetActualDataLength() : pSample->GetSize();
+	if ( !admitSample( Time, sampleLength ) )
+		return S_OK;
 
-	/** timestamp synchronizer */
-	Measurement::TimestampSync m_syncer;
+	BYTE* pBuffer;
+	if ( FAILED( pSample->GetPointer( &pBuffer ) ) )
+	{
+		LOG4CPP_INFO( logger, "GetPointer failed" );
+		return S_OK;
+	}
+	
 
-	/** undistorter */
-	boost::shared_ptr<Vision::Undistortion> m_undistorter;
+	// create Image, convert and send
+	Vision::Image::ImageFormatProperties fmt;
+	int imageWidth, imageHeight;
+	sampleImageFormat( m_sampleFormat, m_sampleWidth, m_sampleHeight, m_sampleBottomUp, sampleLength, fmt, imageWidth, imageHeight );
 
-	// the ports
-	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_outPort;
-	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_colorOutPort;
-	Dataflow::PullSupplier< Measurement::Matrix3x3 > m_intrinsicsPort;
+	boost::shared_ptr< Vision::Image > pBufferImage;
+	if ( m_zeroCopy )
+	{
+		// keep the sample alive until the last image referring to its buffer is gone
+		pBufferImage.reset( new Vision::Image( imageWidth, imageHeight, fmt, pBuffer ), MediaSampleReleaser( pSample ) );
+	}
+	else
+		pBufferImage.reset( new Vision::Image( imageWidth, imageHeight, fmt, pBuffer ) );
 
-	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_outPortRAW;
-	boost::shared_ptr < Dataflow::PushConsumer< Measurement::CameraIntrinsics > > m_intrinsicInPort;
+	// the delivery statistics then show the latency from capture to callback
+	Measurement::Timestamp utTime;
+	if ( !m_clock.captureTime( pSample, utTime ) )
+		utTime = m_syncer.convertNativeToLocal( Time );
 
-	void newIntrinsicsPush(Measurement::CameraIntrinsics intrinsics);
+	deliverSample( utTime, pBuffer, sampleLength, pBufferImage, !m_zeroCopy );
+	return S_OK;
+}
 
-	/** pointer to DirectShow filter graph */
-	AutoComPtr< IMediaControl > m_pMediaControl;
 
-    // ISampleGrabberCB: fake reference counting.
-    STDMETHODIMP_(ULONG) AddRef() 
-	{ return 1; }
+bool DirectShowFrameGrabber::mediaFoundationSample( const MediaFoundationSample& sample )
+{
+	m_streamingThreadSettings.update( getName() );
 
-    STDMETHODIMP_(ULONG) Release() 
-	{ return 2; }
+	// the capture time is unique per frame, the reader has no double frames
+	if ( !admitSample( double( sample.time ), long( sample.length ) ) )
+		return true;
 
-    STDMETHODIMP QueryInterface( REFIID riid, void **ppvObject )
-    {
-		if ( NULL == ppvObject ) 
-			return E_POINTER;
-		if ( riid == __uuidof( IUnknown ) )
-		{
-			*ppvObject = static_cast<IUnknown*>( this );
-			 return S_OK;
-		}
-		if ( riid == __uuidof( ISampleGrabberCB ) )
+	Vision::Image::ImageFormatProperties fmt;
+	int imageWidth, imageHeight;
+	sampleImageFormat( m_sampleFormat, m_sampleWidth, m_sampleHeight, m_sampleBottomUp, sample.length, fmt, imageWidth, imageHeight );
+
+	if ( sample.pTexture )
+	{
+		// the decoded frame goes from the texture into an OpenCL buffer without passing host memory
+		boost::shared_ptr< Vision::Image > pSampleImage( m_imagePool->getGPUImage( imageWidth, imageHeight, fmt ) );
 		{
-			*ppvObject = static_cast<ISampleGrabberCB*>( this );
-			 return S_OK;
+			FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_UPLOAD );
+			if ( !m_pD3D11Sharing->copyNV12( sample.pTexture, sample.subresource, pSampleImage->uMat() ) )
+				return false;
 		}
-		return E_NOTIMPL;
+
+		deliverSample( sample.time, 0, long( sample.length ), pSampleImage, false );
+		return true;
 	}
 
-	STDMETHODIMP SampleCB( double Time, IMediaSample *pSample );
+	// the buffer stays locked as long as an image refers to it
+	boost::shared_ptr< Vision::Image > pBufferImage;
+	if ( m_zeroCopy )
+		pBufferImage.reset( new Vision::Image( imageWidth, imageHeight, fmt, sample.pData ), MediaBufferReleaser( sample.buffer ) );
+	else
+		pBufferImage.reset( new Vision::Image( imageWidth, imageHeight, fmt, sample.pData ) );
 
-	STDMETHODIMP BufferCB( double Time, BYTE *pBuffer, long BufferLen )
-	{
-		LOG4CPP_INFO( logger, "BufferCB called" );
-		return E_NOTIMPL;
-	}
-};
+	deliverSample( sample.time, sample.pData, long( sample.length ), pBufferImage, !m_zeroCopy );
+	return true;
+}
 
 
-DirectShowFrameGrabber::DirectShowFrameGrabber( const std::string& sName, boost::shared_ptr< Graph::UTQLSubgraph > subgraph )
-	: Dataflow::Component( sName )
-	, m_timeOffset( 0 )
-	, m_divisor( 1 )
-	, m_desiredWidth( 320 )
-	, m_desiredHeight( 240 )
-	, m_cameraExposure( 0 )
-	, m_cameraExposureAuto( true )
-	, m_cameraBrightness( 0 )
-	, m_cameraContrast( 11 )
-	, m_cameraSaturation( 4 )
-	, m_cameraSharpness( 3 )
-	, m_cameraGamma( 150 )
-	, m_cameraWhitebalance( 4500 )
-	, m_cameraWhitebalanceAuto( true )
-	, m_cameraBacklightComp( false )
-	, m_cameraGain( 34 )
-	, m_nFrames( 0 )
-	, m_lastTime( -1e10 )
-	, m_syncer( 1.0 )
-	//, m_undistorter( *subgraph )
-	, m_outPort( "Output", *this )
-	, m_colorOutPort( "ColorOutput", *this )
-	, m_intrinsicsPort( "Intrinsics", *this, boost::bind( &DirectShowFrameGrabber::getIntrinsic, this, _1 ) )
-	, m_outPortRAW("OutputRAW", *this)
-	, m_autoGPUUpload(false)
+bool DirectShowFrameGrabber::admitSample( double time, long sampleLength )
 {
-	HRESULT hRes = CoInitializeEx( NULL, COINIT_MULTITHREADED );
-	if ( hRes == RPC_E_CHANGED_MODE )
-	{ 
-		LOG4CPP_WARN( logger, "CoInitializeEx failed with RPC_E_CHANGED_MODE, continuing..." );
-	}
-	else if ( FAILED( hRes ) )
+	m_statistics.count( FrameStatistics::COUNTER_RECEIVED );
+	if ( m_statistics.reportDue( Measurement::now() ) )
+		LOG4CPP_INFO( logger, getName() << " statistics: " << m_statistics.summary() << "; clock drift=" << m_clock.drift() << "ppm" );
+	if ( m_probe.active() )
+		m_probe.sampleArrived( Measurement::now() );
+
+	if ( time == m_lastTime )
 	{
-		std::ostringstream os;
-		os << "Error in CoInitializeEx:" << std::hex << hRes;
-		UBITRACK_THROW( os.str() );
+		// this was a problem with DSVideoLib and multiple cameras
+		LOG4CPP_INFO( logger, "Got double frame" );
+		m_statistics.count( FrameStatistics::COUNTER_DOUBLE_FRAME );
+		return false;
 	}
+	m_lastTime = time;
 
-	subgraph->m_DataflowAttributes.getAttributeData( "timeOffset", m_timeOffset );
-	subgraph->m_DataflowAttributes.getAttributeData( "divisor", m_divisor );
-	subgraph->m_DataflowAttributes.getAttributeData( "imageWidth", m_desiredWidth );
-	subgraph->m_DataflowAttributes.getAttributeData( "imageHeight", m_desiredHeight );
-	m_desiredDevicePath = subgraph->m_DataflowAttributes.getAttributeString( "devicePath" );
-	m_desiredName = subgraph->m_DataflowAttributes.getAttributeString( "cameraName" );
-	
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraExposure" ))
-		subgraph->m_DataflowAttributes.getAttributeData( "cameraExposure", m_cameraExposure );
-
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraExposureAuto" ))
-		m_cameraExposureAuto = subgraph->m_DataflowAttributes.getAttributeString( "cameraExposureAuto" ) == "true";
+	if ( !m_running )
+		return false;
 
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraBrightness" ))
-		subgraph->m_DataflowAttributes.getAttributeData( "cameraBrightness", m_cameraBrightness );
-	
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraContrast" ))
-		subgraph->m_DataflowAttributes.getAttributeData( "cameraContrast", m_cameraContrast );
-	
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraSaturation" ))
-		subgraph->m_DataflowAttributes.getAttributeData( "cameraSaturation", m_cameraSaturation );
-	
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraSharpness" ))
-		subgraph->m_DataflowAttributes.getAttributeData( "cameraSharpness", m_cameraSharpness );
-	
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraGamma" ))
-		subgraph->m_DataflowAttributes.getAttributeData( "cameraGamma", m_cameraGamma );
+	if ( ++m_nFrames % m_divisor )
+	{
+		m_statistics.count( FrameStatistics::COUNTER_DIVISOR );
+		return false;
+	}
 
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraWhitebalance" ))
-		subgraph->m_DataflowAttributes.getAttributeData( "cameraWhitebalance", m_cameraWhitebalance );
-	
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraWhitebalanceAuto" ))
-		m_cameraWhitebalanceAuto = subgraph->m_DataflowAttributes.getAttributeString( "cameraWhitebalanceAuto" ) == "true";
+	if ( sampleLength <= 0 || std::size_t( sampleLength ) < minimumSampleSize( m_sampleFormat, m_sampleWidth, m_sampleHeight ) )
+	{
+		LOG4CPP_INFO( logger, "Invalid sample size" );
+		m_statistics.count( FrameStatistics::COUNTER_INVALID_SIZE );
+		return false;
+	}
+	return true;
+}
 
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraBacklightComp" ))
-		m_cameraBacklightComp = subgraph->m_DataflowAttributes.getAttributeString( "cameraBacklightComp" ) == "true";
 
-	if (subgraph->m_DataflowAttributes.hasAttribute( "cameraGain" ))
-		subgraph->m_DataflowAttributes.getAttributeData( "cameraGain", m_cameraGain );
+void DirectShowFrameGrabber::deliverSample( Measurement::Timestamp utTime, BYTE* pBuffer, long sampleLength, boost::shared_ptr< Vision::Image > pBufferImage, 
+	bool bTransient )
+{
+	// auto exposure also sees the frames the scheduler skips
+	if ( m_exposureController.enabled() )
+		updateExposure( pBufferImage->Mat() );
 
-	if (subgraph->m_DataflowAttributes.hasAttribute("cameraModelFile")){
-		std::string cameraModelFile = subgraph->m_DataflowAttributes.getAttributeString("cameraModelFile");
-		m_undistorter.reset(new Vision::Undistortion(cameraModelFile));
+	if ( m_statistics.enabled() )
+	{
+		Measurement::Timestamp now = Measurement::now();
+		m_statistics.record( FrameStatistics::STAGE_DELIVERY, now > utTime ? now - utTime : 0 );
 	}
-	else {
-		std::string intrinsicFile = subgraph->m_DataflowAttributes.getAttributeString("intrinsicMatrixFile");
-		std::string distortionFile = subgraph->m_DataflowAttributes.getAttributeString("distortionFile");
 
+	// the recording gets all frames at the capture rate, before the scheduler skips any
+	if ( m_pRecorder && !m_pRecorder->record( utTime + 1000000L * m_timeOffset, pBuffer, sampleLength ) )
+		LOG4CPP_DEBUG( logger, "Recording queue full, dropped sample" );
 
-		m_undistorter.reset(new Vision::Undistortion(intrinsicFile, distortionFile));
+	Measurement::Timestamp lostTime = m_lostTime.exchange( 0 );
+	if ( lostTime )
+	{
+		Measurement::Timestamp reconnectTime = Measurement::now() - lostTime;
+		m_statistics.record( FrameStatistics::STAGE_RECONNECT, reconnectTime );
+		LOG4CPP_INFO( logger, getName() << ": first frame " << reconnectTime / 1000000 << "ms after the device was lost" );
 	}
 
-	Vision::OpenCLManager& oclManager = Vision::OpenCLManager::singleton();
-	if (oclManager.isEnabled()) {
-		if (subgraph->m_DataflowAttributes.hasAttribute("uploadImageOnGPU")){
-			m_autoGPUUpload = subgraph->m_DataflowAttributes.getAttributeString("uploadImageOnGPU") == "true";
-			LOG4CPP_INFO(logger, "Upload to GPU enabled? " << m_autoGPUUpload);
-		}
-		if (m_autoGPUUpload){
-			oclManager.activate();
-			LOG4CPP_INFO(logger, "Require OpenCLManager");
-		}
+	if ( m_scheduler.enabled() && !m_scheduler.admit( utTime, Measurement::now() ) )
+	{
+		m_statistics.count( FrameStatistics::COUNTER_SCHEDULER );
+		return;
 	}
 
-	// dynamically generate input ports
-	for (Graph::UTQLSubgraph::EdgeMap::iterator it = subgraph->m_Edges.begin(); it != subgraph->m_Edges.end(); it++)
+	// after the scheduler, so that the gate compares with frames that are actually processed
+	if ( m_motionGate.enabled() && !m_motionGate.admit( m_sampleFormat, pBufferImage->Mat(), m_sampleWidth, m_sampleHeight, utTime ) )
 	{
-		if (it->second->isInput())
-		{
-			if (0 == it->first.compare(0, 15, "InputIntrinsics")) {
-				m_intrinsicInPort.reset(new Dataflow::PushConsumer< Measurement::CameraIntrinsics >(it->first, *this,
-					boost::bind(&DirectShowFrameGrabber::newIntrinsicsPush, this, _1)));
+		m_statistics.count( FrameStatistics::COUNTER_STATIC );
+		m_scheduler.discarded();
+		return;
+	}
 
-			}
-			
+	if ( m_frameQueue )
+	{
+		// a transient sample buffer is only valid during this callback, so the workers get a copy
+		QueuedFrame frame;
+		frame.time = utTime + 1000000L * m_timeOffset;
+		frame.image = bTransient ? m_imagePool->clone( *pBufferImage ) : pBufferImage;
+		unsigned long nDropped = m_frameQueue->droppedCount();
+		if ( !m_frameQueue->push( frame ) )
+		{
+			LOG4CPP_DEBUG( logger, "Frame queue full, dropped " << ( m_frameQueueDropNewest ? "newest" : "oldest" ) << " frame" );
+			m_statistics.count( FrameStatistics::COUNTER_QUEUE_OVERFLOW, m_frameQueue->droppedCount() - nDropped );
+			m_scheduler.discarded( m_frameQueue->droppedCount() - nDropped );
 		}
+		return;
 	}
 
-	
-
-	initGraph();
-}
-
-void DirectShowFrameGrabber::newIntrinsicsPush(Measurement::CameraIntrinsics intrinsics) {
-	m_undistorter.reset(new Vision::Undistortion(*intrinsics));
+	Measurement::Timestamp start = Measurement::now();
+	handleFrame( utTime + 1000000L * m_timeOffset, pBufferImage, bTransient );
+	m_scheduler.finished( Measurement::now() - start );
 }
 
-
-DirectShowFrameGrabber::~DirectShowFrameGrabber()
+/** splits a comma separated attribute value, surrounding whitespace is removed */
+static std::vector< std::string > splitList( const std::string& s )
 {
-	if ( m_pMediaControl )
-		m_pMediaControl->Stop();
-	CoUninitialize();
+	std::vector< std::string > items;
+	std::istringstream is( s );
+	std::string item;
+	while ( std::getline( is, item, ',' ) )
+	{
+		std::size_t first = item.find_first_not_of( " \t" );
+		std::size_t last = item.find_last_not_of( " \t" );
+		items.push_back( first == std::string::npos ? std::string() : item.substr( first, last - first + 1 ) );
+	}
+	return items;
 }
 
 
-void DirectShowFrameGrabber::start()
+/**
+ * @ingroup vision_components
+ * Captures several cameras in one DirectShow filter graph and pushes their frames as sets.
+ *
+ * All capture filters share the reference clock of the graph, so the sample times of different
+ * cameras are directly comparable. A frame is held back until every camera has delivered one whose
+ * sample time lies within \c syncTolerance milliseconds, then all images of the set are pushed with
+ * the same timestamp. Frames that can no longer be part of a set are dropped.
+ *
+ * @par Input Ports
+ * None.
+ *
+ * @par Output Ports
+ * \c Output<i>, \c ColorOutput<i>, \c OutputRAW<i> and \c PyramidOutput<i> push ports of type Ubitrack::Measurement::ImageMeasurement
+ * and \c Intrinsics<i> pull ports of type Ubitrack::Measurement::Matrix3x3 for camera \c i.
+ *
+ * @par Configuration
+ * \c cameraNames, \c devicePaths and \c cameraModelFiles are comma separated lists with one entry per camera,
+ * all other attributes apply to every camera.
+ */
+class DirectShowMultiFrameGrabber
+	: public Dataflow::Component
 {
-	if ( !m_running ) {
-		if (m_autoGPUUpload) {
-			LOG4CPP_INFO(logger, "Waiting for OpenCLManager initialization callback.");
-			Vision::OpenCLManager& oclManager = Vision::OpenCLManager::singleton();
-			oclManager.registerInitCallback(boost::bind(&DirectShowFrameGrabber::startCapturing, this));
-		}
-		else {
-			startCapturing();
-		}
-		m_running = true;
-	}
-	Component::start();
-}
+public:
 
-void DirectShowFrameGrabber::startCapturing()
-{
-	if ( m_pMediaControl )
-		m_pMediaControl->Run();
-}
+	/** constructor */
+	DirectShowMultiFrameGrabber( const std::string& sName, boost::shared_ptr< Graph::UTQLSubgraph > subgraph );
 
-void DirectShowFrameGrabber::stop()
-{
-	if ( m_running && m_pMediaControl )
-		m_pMediaControl->Pause();	
-	Component::stop();
-}
+	/** destructor */
+	~DirectShowMultiFrameGrabber();
 
+	/** starts the cameras */
+	void start();
 
-void DirectShowFrameGrabber::initGraph()
-{
-	// Create the System Device Enumerator.
-	AutoComPtr< ICreateDevEnum > pDevEnum;
-	AutoComPtr< IEnumMoniker > pEnum;
+	/** starts the capturing */
+	void startCapturing();
 
-	HRESULT hr = pDevEnum.CoCreateInstance( CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER );
-	if ( SUCCEEDED( hr ) )
-		// Create an enumerator for the video capture category.
-		hr = pDevEnum->CreateClassEnumerator( CLSID_VideoInputDeviceCategory, &pEnum.p, 0 );
+	/** stops the cameras */
+	void stop();
 
-	AutoComPtr< IMoniker > pMoniker;
-	AutoComPtr< IMoniker > pSelectedMoniker;
-	std::string sSelectedCamera;
-	while ( pEnum->Next( 1, &pMoniker.p, NULL ) == S_OK )
-	{
-		if ( !pSelectedMoniker )
-			pSelectedMoniker = pMoniker;
+protected:
 
-		AutoComPtr< IPropertyBag > pPropBag;
-		hr = pMoniker->BindToStorage( 0, 0, IID_IPropertyBag, (void**)(&pPropBag.p) );
-		if ( FAILED( hr ) )
+	/** callback of one capture branch */
+	class Camera
+		: public ISampleGrabberCB
+	{
+	public:
+		Camera( DirectShowMultiFrameGrabber& owner, std::size_t index )
+			: m_owner( owner )
+			, m_index( index )
+			, m_lastTime( -1e10 )
+			, m_threadName( owner.getName() + " camera " + indexName( index ) )
+			, m_outPort( "Output" + indexName( index ), owner )
+			, m_colorOutPort( "ColorOutput" + indexName( index ), owner )
+			, m_outPortRAW( "OutputRAW" + indexName( index ), owner )
+			, m_pyramidOutPort( "PyramidOutput" + indexName( index ), owner )
+		{}
+
+		/** port of a pipeline output */
+		Dataflow::PushSupplier< Measurement::ImageMeasurement >& outputPort( FramePipeline::Output output )
 		{
-			pMoniker.Release();
-			continue;  // Skip this one, maybe the next one will work.
-		} 
-
-		// Find the device of the camera.
-		VARIANT varDevicePath;
-		VariantInit( &varDevicePath );
-		hr = pPropBag->Read( L"DevicePath", &varDevicePath, 0 );
-		char sDevicePath[ 128 ];
-		if ( SUCCEEDED( hr ) )
-			// could be optimized somehow ..
-			WideCharToMultiByte( CP_ACP, 0, varDevicePath.bstrVal, -1, sDevicePath, 128, 0, 0 );
-
-		// Find the description or friendly name.
-		VARIANT varName;
-		VariantInit( &varName );
-		hr = pPropBag->Read( L"Description", &varName, 0 );
-		if ( FAILED( hr ) )
-			hr = pPropBag->Read( L"FriendlyName", &varName, 0 );
+			switch ( output )
+			{
+			case FramePipeline::OUTPUT_RAW: return m_outPortRAW;
+			case FramePipeline::OUTPUT_COLOR: return m_colorOutPort;
+			case FramePipeline::OUTPUT_PYRAMID: return m_pyramidOutPort;
+			default: return m_outPort;
+			}
+		}
 
-		
+		/** handler method for incoming pull requests */
+		Measurement::Matrix3x3 getIntrinsic( Measurement::Timestamp t )
+		{ return Measurement::Matrix3x3( t, m_undistortionMaps->intrinsics().matrix ); }
 
-		if ( SUCCEEDED( hr ) )
+		static std::string indexName( std::size_t index )
 		{
-			char sName[ 128 ];
-			WideCharToMultiByte( CP_ACP, 0, varName.bstrVal, -1, sName, 128, 0, 0 );
-			LOG4CPP_INFO( logger, "Possible capture device: " << &sName[0] << " device path: " << sDevicePath );
+			std::ostringstream os;
+			os << index;
+			return os.str();
+		}
+
+		// ISampleGrabberCB: fake reference counting.
+		STDMETHODIMP_(ULONG) AddRef() 
+		{ return 1; }
 
-			// select device based on name
-			if ( !m_desiredName.empty() && strstr( sName, m_desiredName.c_str() ) )
+		STDMETHODIMP_(ULONG) Release() 
+		{ return 2; }
+
+		STDMETHODIMP QueryInterface( REFIID riid, void **ppvObject )
+		{
+			if ( NULL == ppvObject ) 
+				return E_POINTER;
+			if ( riid == __uuidof( IUnknown ) )
 			{
-				if( m_desiredDevicePath.empty() )
-				{
-					sSelectedCamera = sName;
-					pSelectedMoniker = pMoniker;
-					break;
-				}
-				else if ( strstr( sDevicePath, m_desiredDevicePath.c_str() ) )
-				{
-					sSelectedCamera = sName;
-					pSelectedMoniker = pMoniker;
-					LOG4CPP_INFO( logger, "Found device with path-identifier: " << m_desiredDevicePath );
-					break;
-				}
+				*ppvObject = static_cast<IUnknown*>( this );
+				 return S_OK;
+			}
+			if ( riid == __uuidof( ISampleGrabberCB ) )
+			{
+				*ppvObject = static_cast<ISampleGrabberCB*>( this );
+				 return S_OK;
 			}
+			return E_NOTIMPL;
+		}
 
-			VariantClear( &varName ); 
+		STDMETHODIMP SampleCB( double Time, IMediaSample *pSample )
+		{
+			m_streamingThreadSettings.update( m_threadName );
+			m_owner.sampleArrived( m_index, Time, pSample );
+			return S_OK;
 		}
 
-		pMoniker.Release();
-	}
+		STDMETHODIMP BufferCB( double Time, BYTE *pBuffer, long BufferLen )
+		{
+			LOG4CPP_INFO( logger, "BufferCB called" );
+			return E_NOTIMPL;
+		}
 
-	// check if a capture device was found
-	if ( !pSelectedMoniker )
-		UBITRACK_THROW( "No video capture device found" );
+		DirectShowMultiFrameGrabber& m_owner;
+		std::size_t m_index;
 
-	LOG4CPP_INFO( logger, "Using camera: " << sSelectedCamera );
+		/** format of the samples */
+		CaptureFormat m_format;
 
-	// create capture graph
-    AutoComPtr< IGraphBuilder > pGraph;
-    AutoComPtr< ICaptureGraphBuilder2 > pBuild;
+		/** sample time of the last frame, for detecting double frames */
+		double m_lastTime;
 
-    // Create the Capture Graph Builder.
-    hr = pBuild.CoCreateInstance( CLSID_CaptureGraphBuilder2, NULL, CLSCTX_INPROC_SERVER );
-    if ( SUCCEEDED( hr ) )
-    {
-        // Create the Filter Graph Manager.
-        hr = pGraph.CoCreateInstance( CLSID_FilterGraph, 0, CLSCTX_INPROC_SERVER );
-        if ( SUCCEEDED( hr ) )
-            // Initialize the Capture Graph Builder.
-            pBuild->SetFiltergraph( pGraph );
-        else
-			UBITRACK_THROW( "Error creating filter graph manager" );
-    }
-	else
-		UBITRACK_THROW( "Error creating capture graph builder" );
+		/** scheduling of the streaming thread of this capture branch */
+		CallbackThreadSettings m_streamingThreadSettings;
 
-	// create capture device filter
-	AutoComPtr< IBaseFilter > pCaptureFilter;
-	if ( FAILED( pSelectedMoniker->BindToObject( 0, 0, IID_IBaseFilter, (void**)&pCaptureFilter.p ) ) )
-		UBITRACK_THROW( "Unable to create capture filter" );
+		/** name of the camera in the log messages about its streaming thread */
+		std::string m_threadName;
 
-	if ( FAILED( pGraph->AddFilter( pCaptureFilter, L"Capture" ) ) )
-		UBITRACK_THROW( "Unable to add capture filter" );
+		/** intrinsics and remap tables of this camera */
+		boost::scoped_ptr< UndistortionMapCache > m_undistortionMaps;
 
-	// find output pin for configuration
-	AutoComPtr< IPin > pPin;
-	if ( FAILED( pBuild->FindPin( pCaptureFilter, PINDIR_OUTPUT, &PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, FALSE, 0, &pPin.p ) ) )
-		UBITRACK_THROW( "Unable to find pin" );
+		/** image processing of the captured frames */
+		boost::scoped_ptr< FramePipeline > m_pipeline;
 
-	// enumerate media types
-	AutoComPtr< IAMStreamConfig > pStreamConfig;
-	if ( FAILED( pPin.QueryInterface< IAMStreamConfig >( pStreamConfig ) ) )
-	{ LOG4CPP_WARN( logger, "Unable to get IAMStreamConfig interface" ); }
-	else
-	{
-		int iCount, iSize;
-		pStreamConfig->GetNumberOfCapabilities( &iCount, &iSize );
-		boost::scoped_array< BYTE > buf( new BYTE[ iSize ] );
+		/** the capture filter in the shared graph */
+		AutoComPtr< IBaseFilter > m_pCaptureFilter;
 
-		bool bSet = false;
-		for ( int iCap = 0; iCap < iCount; iCap++ )
-		{
-			AM_MEDIA_TYPE *pMediaType;
-			pStreamConfig->GetStreamCaps( iCap, &pMediaType, buf.get() );
+		// the ports
+		Dataflow::PushSupplier< Measurement::ImageMeasurement > m_outPort;
+		Dataflow::PushSupplier< Measurement::ImageMeasurement > m_colorOutPort;
+		Dataflow::PushSupplier< Measurement::ImageMeasurement > m_outPortRAW;
+		Dataflow::PushSupplier< Measurement::ImageMeasurement > m_pyramidOutPort;
+		boost::scoped_ptr< Dataflow::PullSupplier< Measurement::Matrix3x3 > > m_intrinsicsPort;
+	};
 
-			if ( pMediaType->majortype != MEDIATYPE_Video || pMediaType->formattype != FORMAT_VideoInfo )
-				continue;
-			VIDEOINFOHEADER* pInfo = (VIDEOINFOHEADER*)pMediaType->pbFormat;
+	/** forwards the pipeline outputs of one camera to its ports */
+	class PortSink
+		: public FramePipeline::Sink
+	{
+	public:
+		PortSink( Camera& camera, Measurement::Timestamp t )
+			: m_camera( camera )
+			, m_time( t )
+		{}
 
-			LOG4CPP_INFO( logger, "Media type: fps=" << 1e7 / pInfo->AvgTimePerFrame << 
-				", width=" << pInfo->bmiHeader.biWidth << ", height=" << pInfo->bmiHeader.biHeight <<
-				", type=" << ( pMediaType->subtype == MEDIASUBTYPE_RGB24 ? "RGB24" : "?" ) );
+		bool isConnected( FramePipeline::Output output ) const
+		{ return m_camera.outputPort( output ).isConnected(); }
 
-			// set first format with correct size, but prefer RGB24 
-			if ( ( m_desiredWidth <= 0 || pInfo->bmiHeader.biWidth == m_desiredWidth ) && 
-				( m_desiredHeight <= 0 || pInfo->bmiHeader.biHeight == m_desiredHeight ) &&
-				( !bSet || pMediaType->subtype == MEDIASUBTYPE_RGB24 ) )
-			{
-				pStreamConfig->SetFormat( pMediaType );
-				if ( bSet )
-					break;
-				bSet = true;
-			}
+		void send( FramePipeline::Output output, boost::shared_ptr< Vision::Image > pImage )
+		{ m_camera.outputPort( output ).send( Measurement::ImageMeasurement( m_time, pImage ) ); }
 
-			// TODO: DeleteMediaType
-		}
-	}
+	protected:
+		Camera& m_camera;
+		Measurement::Timestamp m_time;
+	};
 
-	// create sample grabber filter
-	AutoComPtr< IBaseFilter > pSampleGrabberFilter;
-	if ( FAILED( pSampleGrabberFilter.CoCreateInstance( CLSID_SampleGrabber, NULL, CLSCTX_INPROC_SERVER ) ) )
-		UBITRACK_THROW( "Unable to create sample grabber filter" );
+	/** a frame waiting for the other cameras */
+	struct PendingFrame
+	{
+		PendingFrame()
+			: time( 0 )
+			, captureTime( 0 )
+		{}
 
-	if ( FAILED( pGraph->AddFilter( pSampleGrabberFilter, L"SampleGrab" ) ) )
-		UBITRACK_THROW( "Unable to add sample grabber filter" );
+		double time;
 
-	// configure sample grabber
-	AutoComPtr< ISampleGrabber > pSampleGrabber;
-	pSampleGrabberFilter.QueryInterface( pSampleGrabber );
-	pSampleGrabber->SetOneShot( FALSE );
-	pSampleGrabber->SetBufferSamples( FALSE );
-	pSampleGrabber->SetCallback( this, 0 ); // 0 = Use the SampleCB callback method.
+		/** capture time on the local clock, 0 if unknown */
+		Measurement::Timestamp captureTime;
+		boost::shared_ptr< Vision::Image > image;
+	};
 
+	/** builds the shared filter graph with one branch per camera */
+	void initGraph();
 
+	/** called from the streaming thread of camera \c index */
+	void sampleArrived( std::size_t index, double Time, IMediaSample *pSample );
 
+	/** the cameras */
+	std::vector< boost::shared_ptr< Camera > > m_cameras;
 
-	// make it picky on media types
-	AM_MEDIA_TYPE mediaType;
-	memset( &mediaType, 0, sizeof( mediaType ) );
-	mediaType.majortype = MEDIATYPE_Video;
-	mediaType.subtype = MEDIASUBTYPE_RGB24;
-	pSampleGrabber->SetMediaType( &mediaType );
+	// desired camera names and device paths
+	std::vector< std::string > m_desiredNames;
+	std::vector< std::string > m_desiredDevicePaths;
 
-	// null renderer
-	AutoComPtr< IBaseFilter > pNullRenderer;
-	if ( FAILED( pNullRenderer.CoCreateInstance( CLSID_NullRenderer, NULL, CLSCTX_INPROC_SERVER ) ) )
-		UBITRACK_THROW( "Unable to create null renderer filter" );
+	/** devices and capture modes of earlier starts */
+	boost::shared_ptr< DeviceCache > m_pDeviceCache;
 
-	if ( FAILED( pGraph->AddFilter( pNullRenderer, L"NullRender" ) ) )
-		UBITRACK_THROW( "Unable to add null renderer filter" );
+	/** settings shared by all capture pins */
+	CaptureSettings m_settings;
 
-	// connect all filters
-	hr = pBuild->RenderStream(
-		&PIN_CATEGORY_CAPTURE, // Connect this pin ...
-		&MEDIATYPE_Video,      // with this media type ...
-		pCaptureFilter,        // on this filter ...
-		pSampleGrabberFilter,  // to the Sample Grabber ...
-		pNullRenderer );       // ... and finally to the Null Renderer.
-	if ( FAILED( hr ) )
-		UBITRACK_THROW( "Unable to render stream" );
+	// shift timestamps (ms)
+	int m_timeOffset;
 
-	// get media type
-	pSampleGrabber->GetConnectedMediaType( &mediaType );
-	if ( mediaType.majortype != MEDIATYPE_Video || mediaType.subtype != MEDIASUBTYPE_RGB24 ||
-		mediaType.formattype != FORMAT_VideoInfo )
-		UBITRACK_THROW( "Unsupported MEDIATYPE" );
+	/** maximum difference of the sample times within a frame set (ms) */
+	double m_syncTolerance;
 
-	VIDEOINFOHEADER* pVidInfo = (VIDEOINFOHEADER*)mediaType.pbFormat;
-	m_sampleWidth = pVidInfo->bmiHeader.biWidth;
-	m_sampleHeight = pVidInfo->bmiHeader.biHeight;
-	double fps = (1.0 / pVidInfo->AvgTimePerFrame) * 10000000.0;
-	LOG4CPP_INFO( logger, "Image dimensions: " << m_sampleWidth << "x" << m_sampleHeight << " FPS: " << fps );
-	// TODO: FreeMediaType( &mediaType );
+	/** automatic upload of images to the GPU*/
+	bool m_autoGPUUpload;
 
+	/** recycles the buffers of the images created for the outputs */
+	boost::shared_ptr< ImagePool > m_imagePool;
 
+	/** stage timings and drop counters of all cameras */
+	FrameStatistics m_statistics;
 
-#ifdef HAVE_DIRECTSHOW
-	/* additionally control camera parameters infos at:
-	 * http://msdn.microsoft.com/en-us/library/dd318253(v=vs.85).aspx
-	 */
+	/** the newest frame of each camera not yet sent, protected by m_pendingMutex */
+	std::vector< PendingFrame > m_pending;
+	boost::mutex m_pendingMutex;
 
-	LOG4CPP_INFO( logger, "Setting additional direct show parameter ");
-
-	IAMCameraControl *pCameraControl; 
-	hr = pCaptureFilter->QueryInterface(IID_IAMCameraControl, (void **)&pCameraControl); 
-	if ( SUCCEEDED(hr) ) {
-
-		// could check if provided value is within range
-		//hr = pCameraControl->GetRange(CameraControl_Exposure,
-		//						NULL, // min
-		//						NULL, // max
-		//						NULL, // minstep
-		//						&defaultExposureValue, // default
-		//						NULL); // capflags
-
-		int expFlag = CameraControl_Flags_Manual;
-		if (m_cameraExposureAuto)
-			expFlag = CameraControl_Flags_Auto;
-
-		hr = pCameraControl->Set(CameraControl_Exposure, // property
-								m_cameraExposure, // value
-								expFlag); 
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera exposure property to " << m_cameraExposure);
-	}
-
-	IAMVideoProcAmp *pAMVideoProcAmp;
-	hr = pCaptureFilter->QueryInterface(IID_IAMVideoProcAmp, (void**)&pAMVideoProcAmp);
-	if (SUCCEEDED(hr)) {
-
-		long Min, Max, Step, Default, Flags, Val;
-
-		pAMVideoProcAmp->GetRange(VideoProcAmp_Brightness, &Min, &Max, &Step, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Possible Settings for VideoProcAmp_Brightness: min=" <<Min << " max="<<Max << " Step=" << Step << " Default="<<Default << " Flags="<<Flags );
-		pAMVideoProcAmp->Get(VideoProcAmp_Brightness, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Current Settings for VideoProcAmp_Brightness: Default=" << Default << " Flags=" << Flags);
-
-		pAMVideoProcAmp->GetRange(VideoProcAmp_Contrast, &Min, &Max, &Step, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Possible Settings for VideoProcAmp_Contrast: min=" << Min << " max=" << Max << " Step=" << Step << " Default=" << Default << " Flags=" << Flags);
-		pAMVideoProcAmp->Get(VideoProcAmp_Contrast, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Current Settings for VideoProcAmp_Contrast: Default=" << Default << " Flags=" << Flags);
-		
-		pAMVideoProcAmp->GetRange(VideoProcAmp_Saturation, &Min, &Max, &Step, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Possible Settings for VideoProcAmp_Saturation: min=" << Min << " max=" << Max << " Step=" << Step << " Default=" << Default << " Flags=" << Flags);
-		pAMVideoProcAmp->Get(VideoProcAmp_Saturation, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Current Settings for VideoProcAmp_Saturation: Default=" << Default << " Flags=" << Flags);
-		
-		pAMVideoProcAmp->GetRange(VideoProcAmp_Sharpness, &Min, &Max, &Step, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Possible Settings for VideoProcAmp_Sharpness: min=" << Min << " max=" << Max << " Step=" << Step << " Default=" << Default << " Flags=" << Flags);
-		pAMVideoProcAmp->Get(VideoProcAmp_Sharpness, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Current Settings for VideoProcAmp_Sharpness: Default=" << Default << " Flags=" << Flags);
-		
-		pAMVideoProcAmp->GetRange(VideoProcAmp_Gamma, &Min, &Max, &Step, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Possible Settings for VideoProcAmp_Gamma: min=" << Min << " max=" << Max << " Step=" << Step << " Default=" << Default << " Flags=" << Flags);
-		pAMVideoProcAmp->Get(VideoProcAmp_Gamma, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Current Settings for VideoProcAmp_Gamma: Default=" << Default << " Flags=" << Flags);
-		
-		pAMVideoProcAmp->GetRange(VideoProcAmp_WhiteBalance, &Min, &Max, &Step, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Possible Settings for VideoProcAmp_WhiteBalance: min=" << Min << " max=" << Max << " Step=" << Step << " Default=" << Default << " Flags=" << Flags);
-		pAMVideoProcAmp->Get(VideoProcAmp_WhiteBalance, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Current Settings for VideoProcAmp_WhiteBalance: Default=" << Default << " Flags=" << Flags);
-		
-		pAMVideoProcAmp->GetRange(VideoProcAmp_BacklightCompensation, &Min, &Max, &Step, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Possible Settings for VideoProcAmp_BacklightCompensation: min=" << Min << " max=" << Max << " Step=" << Step << " Default=" << Default << " Flags=" << Flags);
-		pAMVideoProcAmp->Get(VideoProcAmp_BacklightCompensation, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Current Settings for VideoProcAmp_BacklightCompensation: Default=" << Default << " Flags=" << Flags);
-		
-		pAMVideoProcAmp->GetRange(VideoProcAmp_Gain, &Min, &Max, &Step, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Possible Settings for VideoProcAmp_Gain: min=" << Min << " max=" << Max << " Step=" << Step << " Default=" << Default << " Flags=" << Flags);
-		pAMVideoProcAmp->Get(VideoProcAmp_Gain, &Default, &Flags);
-		LOG4CPP_INFO(logger, "Current Settings for VideoProcAmp_Gain: Default=" << Default << " Flags=" << Flags);
-		
-
-		hr = pAMVideoProcAmp->Set(VideoProcAmp_Brightness, m_cameraBrightness, VideoProcAmp_Flags_Manual);
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera exposure brightness to " << m_cameraBrightness);
-
-		hr = pAMVideoProcAmp->Set(VideoProcAmp_Contrast, m_cameraContrast, VideoProcAmp_Flags_Manual);
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera contrast property to " << m_cameraContrast);
-
-		hr = pAMVideoProcAmp->Set(VideoProcAmp_Saturation, m_cameraSaturation, VideoProcAmp_Flags_Manual);
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera saturation property to " << m_cameraSaturation);
-
-		hr = pAMVideoProcAmp->Set(VideoProcAmp_Sharpness, m_cameraSharpness, VideoProcAmp_Flags_Manual);
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera sharpness property to " << m_cameraSharpness);
-
-		hr = pAMVideoProcAmp->Set(VideoProcAmp_Gamma, m_cameraGamma, VideoProcAmp_Flags_Manual);
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera gamma property to " << m_cameraGamma);
-
-		int wbFlags = VideoProcAmp_Flags_Manual;
-		if (m_cameraWhitebalanceAuto)
-			wbFlags = VideoProcAmp_Flags_Auto;
-		hr = pAMVideoProcAmp->Set(VideoProcAmp_WhiteBalance, m_cameraWhitebalance, wbFlags);
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera whitebalance property to " << m_cameraWhitebalance);
-
-		int backlightComp = m_cameraBacklightComp ? 1 : 0;
-		hr = pAMVideoProcAmp->Set(VideoProcAmp_BacklightCompensation, backlightComp, VideoProcAmp_Flags_Manual);
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera backlight compensation property to " << backlightComp);
-
-		hr = pAMVideoProcAmp->Set(VideoProcAmp_Gain, m_cameraGain, VideoProcAmp_Flags_Manual);
-		if (FAILED(hr))
-			LOG4CPP_ERROR( logger, "Error setting camera gain property to " << m_cameraGain);
+	/** timestamp synchronizer for the shared graph clock, protected by m_pendingMutex */
+	Measurement::TimestampSync m_syncer;
 
-	}
+	/** capture times of the samples, protected by m_pendingMutex */
+	GraphClock m_clock;
 
-#endif
+	/**
+	 * number of completed sets, protected by m_pendingMutex, and of processed sets, protected by m_processMutex.
+	 * Sets are completed on the streaming thread of any camera, they are processed one at a time in this order.
+	 */
+	unsigned long m_setsCompleted;
+	unsigned long m_setsProcessed;
+	boost::mutex m_processMutex;
+	boost::condition_variable m_processCond;
+
+	/** pointer to DirectShow filter graph */
+	AutoComPtr< IMediaControl > m_pMediaControl;
+};
 
 
-	// start stream
-	pGraph.QueryInterface< IMediaControl >( m_pMediaControl );
-	m_pMediaControl->Pause();
-}
+DirectShowMultiFrameGrabber::DirectShowMultiFrameGrabber( const std::string& sName, boost::shared_ptr< Graph::UTQLSubgraph > subgraph )
+	: Dataflow::Component( sName )
+	, m_timeOffset( 0 )
+	, m_syncTolerance( 5 )
+	, m_autoGPUUpload( false )
+	, m_syncer( 1.0 )
+	, m_setsCompleted( 0 )
+	, m_setsProcessed( 0 )
+{
+	HRESULT hRes = CoInitializeEx( NULL, COINIT_MULTITHREADED );
+	if ( hRes == RPC_E_CHANGED_MODE )
+	{ 
+		LOG4CPP_WARN( logger, "CoInitializeEx failed with RPC_E_CHANGED_MODE, continuing..." );
+	}
+	else if ( FAILED( hRes ) )
+	{
+		std::ostringstream os;
+		os << "Error in CoInitializeEx:" << std::hex << hRes;
+		UBITRACK_THROW( os.str() );
+	}
 
+	m_desiredNames = splitList( subgraph->m_DataflowAttributes.getAttributeString( "cameraNames" ) );
+	if ( m_desiredNames.empty() )
+		UBITRACK_THROW( "DirectShowMultiFrameGrabber requires a list of camera names" );
+	m_desiredDevicePaths = splitList( subgraph->m_DataflowAttributes.getAttributeString( "devicePaths" ) );
+	m_desiredDevicePaths.resize( m_desiredNames.size() );
+	m_pDeviceCache = DeviceCache::get( subgraph->m_DataflowAttributes.getAttributeString( "deviceCache" ) );
 
+	std::vector< std::string > cameraModelFiles;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraModelFiles" ) )
+		cameraModelFiles = splitList( subgraph->m_DataflowAttributes.getAttributeString( "cameraModelFiles" ) );
+	cameraModelFiles.resize( m_desiredNames.size() );
 
-void DirectShowFrameGrabber::handleFrame( Measurement::Timestamp utTime, Vision::Image& bufferImage )
-{
+	m_settings.width = 320;
+	m_settings.height = 240;
+	subgraph->m_DataflowAttributes.getAttributeData( "timeOffset", m_timeOffset );
+	subgraph->m_DataflowAttributes.getAttributeData( "imageWidth", m_settings.width );
+	subgraph->m_DataflowAttributes.getAttributeData( "imageHeight", m_settings.height );
 
-#ifdef ENABLE_EVENT_TRACING
-	TRACEPOINT_MEASUREMENT_CREATE(getEventDomain(), utTime, getName().c_str(), "VideoCapture")
-#endif
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "syncTolerance" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "syncTolerance", m_syncTolerance );
 
-	if (m_autoGPUUpload){
-		Vision::OpenCLManager& oclManager = Vision::OpenCLManager::singleton();
-		if (oclManager.isInitialized()) {
-			//force upload to the GPU
-			bufferImage.uMat();
-		}
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "frameRate" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "frameRate", m_settings.frameRate );
 
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "pixelFormat" ) )
+	{
+		std::string sPixelFormat = subgraph->m_DataflowAttributes.getAttributeString( "pixelFormat" );
+		m_settings.pixelFormat = sampleFormatFromName( sPixelFormat );
+		if ( m_settings.pixelFormat == SAMPLE_UNKNOWN && sPixelFormat != "any" )
+			UBITRACK_THROW( "Unsupported pixel format: " + sPixelFormat );
 	}
 
-	boost::shared_ptr< Vision::Image > pColorImage;
-	bool bColorImageDistorted = true;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "nativeFormats" ) )
+		m_settings.nativeFormats = subgraph->m_DataflowAttributes.getAttributeString( "nativeFormats" ) == "true";
 
-	Vision::Image::ImageFormatProperties fmt;
-	
-	if ( ( m_desiredWidth > 0 && m_desiredHeight > 0 ) && 
-		( bufferImage.width() > m_desiredWidth || bufferImage.height() > m_desiredHeight ) )
+	Vision::OpenCLManager& oclManager = Vision::OpenCLManager::singleton();
+	if ( oclManager.isEnabled() && subgraph->m_DataflowAttributes.hasAttribute( "uploadImageOnGPU" ) )
 	{
-		bufferImage.getFormatProperties(fmt);
-		pColorImage.reset( new Vision::Image( m_desiredWidth, m_desiredHeight, fmt ) );
-		pColorImage->copyImageFormatFrom(bufferImage);
-		cv::resize( bufferImage.Mat(), pColorImage->Mat(), cv::Size(m_desiredWidth, m_desiredHeight) );
+		m_autoGPUUpload = subgraph->m_DataflowAttributes.getAttributeString( "uploadImageOnGPU" ) == "true";
+		if ( m_autoGPUUpload )
+			oclManager.activate();
 	}
-	
-	if (m_outPortRAW.isConnected()) {
-		m_outPortRAW.send(Measurement::ImageMeasurement(utTime, bufferImage.Clone()));
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "statisticsInterval" ) )
+	{
+		int statisticsInterval = 0;
+		subgraph->m_DataflowAttributes.getAttributeData( "statisticsInterval", statisticsInterval );
+		m_statistics.setInterval( statisticsInterval );
 	}
 
-	if ( m_colorOutPort.isConnected() )
+	// one pool for all cameras, a frame set holds one buffer per camera
+	int pyramidLevels = 4;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "pyramidLevels" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "pyramidLevels", pyramidLevels );
+
+	int imagePoolSize = 4;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "imagePoolSize" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "imagePoolSize", imagePoolSize );
+	m_imagePool.reset( new ImagePool( imagePoolSize > 0 ? imagePoolSize * m_desiredNames.size() : 0 ) );
+
+	// one affinity mask per camera, so that every capture branch can get its own core
+	std::vector< std::string > affinities;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "streamingThreadAffinity" ) )
+		affinities = splitList( subgraph->m_DataflowAttributes.getAttributeString( "streamingThreadAffinity" ) );
+	if ( affinities.size() == 1 )
+		affinities.resize( m_desiredNames.size(), affinities[ 0 ] );
+	affinities.resize( m_desiredNames.size() );
+
+	for ( std::size_t i = 0; i < m_desiredNames.size(); i++ )
 	{
-		if ( pColorImage )
-			pColorImage = m_undistorter->undistort( pColorImage );
-		else
-			pColorImage = m_undistorter->undistort( bufferImage );
-		bColorImageDistorted = false;
+		boost::shared_ptr< Camera > pCamera( new Camera( *this, i ) );
+		pCamera->m_streamingThreadSettings.configure( readThreadSettings( subgraph, "streamingThread", &affinities[ i ] ) );
 
-		//memcpy( pColorImage->iplImage()->channelSeq, "BGR", 4 );
-		//LOG4CPP_INFO( logger, "senind color image" );
-		//fixme
-		//m_colorOutPort.send( Measurement::ImageMeasurement(utTime, bufferImage.Clone() )  );
-		
-		m_colorOutPort.send( Measurement::ImageMeasurement(utTime, pColorImage )  );
+		// cameras without a model file are treated as uncalibrated
+		boost::scoped_ptr< Vision::Undistortion > undistorter;
+		if ( !cameraModelFiles[ i ].empty() )
+			undistorter.reset( new Vision::Undistortion( cameraModelFiles[ i ] ) );
+		else
+			undistorter.reset( new Vision::Undistortion( "", "" ) );
+		pCamera->m_undistortionMaps.reset( new UndistortionMapCache( undistorter->getIntrinsics() ) );
+
+		pCamera->m_pipeline.reset( new FramePipeline( m_imagePool, *pCamera->m_undistortionMaps, m_statistics ) );
+		pCamera->m_pipeline->setDesiredSize( m_settings.width, m_settings.height );
+		pCamera->m_pipeline->setGPUUpload( m_autoGPUUpload );
+		pCamera->m_pipeline->setPyramidLevels( pyramidLevels );
+		configureBands( subgraph, *pCamera->m_pipeline );
+
+		// only create the pull ports that are used
+		std::string intrinsicsName = "Intrinsics" + Camera::indexName( i );
+		if ( subgraph->m_Edges.find( intrinsicsName ) != subgraph->m_Edges.end() )
+			pCamera->m_intrinsicsPort.reset( new Dataflow::PullSupplier< Measurement::Matrix3x3 >( intrinsicsName, *this,
+				boost::bind( &Camera::getIntrinsic, pCamera.get(), _1 ) ) );
+
+		m_cameras.push_back( pCamera );
 	}
+	m_pending.resize( m_cameras.size() );
 
-	
-	if ( m_outPort.isConnected() )
-	{
+	initGraph();
+}
 
-		bufferImage.getFormatProperties(fmt);
-		fmt.imageFormat = Vision::Image::LUMINANCE;
-		fmt.channels = 1;
-		fmt.bitsPerPixel = 8;
 
-		// @todo remove unnecessary allocation if image is on gpu .. and refactor this mess here ..
-		boost::shared_ptr< Vision::Image > pGreyImage( new Vision::Image( bufferImage.width(), bufferImage.height(), fmt));
+DirectShowMultiFrameGrabber::~DirectShowMultiFrameGrabber()
+{
+	if ( m_pMediaControl )
+		m_pMediaControl->Stop();
+	CoUninitialize();
+}
 
-		if ( pColorImage ){
-			if (pColorImage->getImageState() == Image::ImageUploadState::OnCPUGPU || pColorImage->getImageState() == Image::ImageUploadState::OnGPU)
-				cv::cvtColor(pColorImage->uMat(), pGreyImage->uMat(), cv::COLOR_RGB2GRAY);
-			else
-				pGreyImage = pColorImage->CvtColor(CV_BGR2GRAY, 1);
-		}else{
-			if (bufferImage.getImageState() == Image::ImageUploadState::OnCPUGPU || bufferImage.getImageState() == Image::ImageUploadState::OnGPU)
-				cv::cvtColor(bufferImage.uMat(), pGreyImage->uMat(), cv::COLOR_RGB2GRAY);
-			else
-				pGreyImage = bufferImage.CvtColor(CV_BGR2GRAY, 1);
+
+void DirectShowMultiFrameGrabber::start()
+{
+	if ( !m_running ) {
+		{
+			boost::mutex::scoped_lock l( m_pendingMutex );
+			m_pending.assign( m_cameras.size(), PendingFrame() );
+		}
+		if ( m_autoGPUUpload ) {
+			LOG4CPP_INFO( logger, "Waiting for OpenCLManager initialization callback." );
+			Vision::OpenCLManager& oclManager = Vision::OpenCLManager::singleton();
+			oclManager.registerInitCallback( boost::bind( &DirectShowMultiFrameGrabber::startCapturing, this ) );
+		}
+		else {
+			startCapturing();
 		}
+		m_running = true;
+	}
+	Component::start();
+}
+
+
+void DirectShowMultiFrameGrabber::startCapturing()
+{
+	// all capture filters start together with the graph clock
+	if ( m_pMediaControl )
+		m_clock.run( m_pMediaControl );
+}
+
+
+void DirectShowMultiFrameGrabber::stop()
+{
+	if ( m_running && m_pMediaControl )
+		m_pMediaControl->Pause();
+	Component::stop();
+}
+
 
-		if ( bColorImageDistorted )
-			pGreyImage = m_undistorter->undistort( pGreyImage );
-		
-		
+void DirectShowMultiFrameGrabber::initGraph()
+{
+	AutoComPtr< IGraphBuilder > pGraph;
+	AutoComPtr< ICaptureGraphBuilder2 > pBuild;
+	createCaptureGraph( pGraph, pBuild );
+
+	for ( std::size_t i = 0; i < m_cameras.size(); i++ )
+	{
+		AutoComPtr< IMoniker > pSelectedMoniker;
+		std::string sSelectedCamera;
+		std::string sSelectedPath;
+		findCaptureDevice( m_desiredNames[ i ], m_desiredDevicePaths[ i ], *m_pDeviceCache, pSelectedMoniker, sSelectedCamera, sSelectedPath );
+
+		// the fallback to the first device would capture the same camera twice
+		if ( !pSelectedMoniker || sSelectedCamera.empty() )
+			UBITRACK_THROW( "Video capture device not found: " + m_desiredNames[ i ] );
 
-		m_outPort.send(Measurement::ImageMeasurement(utTime, pGreyImage));
+		LOG4CPP_INFO( logger, "Using camera " << i << ": " << sSelectedCamera );
+
+		Camera& camera = *m_cameras[ i ];
+		addCaptureBranch( pGraph, pBuild, pSelectedMoniker, m_settings, *m_pDeviceCache, sSelectedPath, &camera, camera.m_pCaptureFilter, camera.m_format );
+		camera.m_pipeline->setSampleFormat( camera.m_format.format, camera.m_format.width, camera.m_format.height );
 	}
+
+	// start stream
+	pGraph.QueryInterface< IMediaControl >( m_pMediaControl );
+	m_pMediaControl->Pause();
+	m_clock.init( pGraph );
 }
 
 
-STDMETHODIMP DirectShowFrameGrabber::SampleCB( double Time, IMediaSample *pSample )
+void DirectShowMultiFrameGrabber::sampleArrived( std::size_t index, double Time, IMediaSample *pSample )
 {
-	// TODO: check for double frames when using multiple cameras...
-	LOG4CPP_DEBUG( logger, "SampleCB called" );
-	//if(!Ubitrack::Vision::OpenCLManager::singleton().isInitialized())
-	//{
-	//	LOG4CPP_INFO( logger, "skipping frame; OpenCL Manager not initialized");
-	//	return S_OK;
-	//}
+	Camera& camera = *m_cameras[ index ];
 
-	if ( Time == m_lastTime )
+	m_statistics.count( FrameStatistics::COUNTER_RECEIVED );
+	if ( m_statistics.reportDue( Measurement::now() ) )
 	{
-		// this was a problem with DSVideoLib and multiple cameras
-		LOG4CPP_INFO( logger, "Got double frame" );
-		return S_OK;
+		double drift;
+		{
+			boost::mutex::scoped_lock l( m_pendingMutex );
+			drift = m_clock.drift();
+		}
+		LOG4CPP_INFO( logger, getName() << " statistics: " << m_statistics.summary() << "; clock drift=" << drift << "ppm" );
 	}
-	m_lastTime = Time;
 
-	if ( !m_running || ( ++m_nFrames % m_divisor ) )
-		return S_OK;
+	if ( Time == camera.m_lastTime )
+	{
+		LOG4CPP_INFO( logger, "Got double frame from camera " << index );
+		m_statistics.count( FrameStatistics::COUNTER_DOUBLE_FRAME );
+		return;
+	}
+	camera.m_lastTime = Time;
 
-	if ( pSample->GetSize() < m_sampleWidth * m_sampleHeight * 3 )
+	if ( !m_running )
+		return;
+
+	// compressed samples only fill part of the buffer
+	long sampleLength = camera.m_format.format == SAMPLE_MJPG ? pSample->GetActualDataLength() : pSample->GetSize();
+	if ( sampleLength <= 0 || std::size_t( sampleLength ) < minimumSampleSize( camera.m_format.format, camera.m_format.width, camera.m_format.height ) )
 	{
 		LOG4CPP_INFO( logger, "Invalid sample size" );
-		return S_OK;
+		m_statistics.count( FrameStatistics::COUNTER_INVALID_SIZE );
+		return;
 	}
 
 	BYTE* pBuffer;
 	if ( FAILED( pSample->GetPointer( &pBuffer ) ) )
 	{
 		LOG4CPP_INFO( logger, "GetPointer failed" );
-		return S_OK;
+		return;
 	}
-	
 
-	// create Image, convert and send
+	// the sample buffer is only valid during this callback, but the frame may have to wait for the other cameras
 	Vision::Image::ImageFormatProperties fmt;
-	fmt.imageFormat = Vision::Image::BGR;
-	fmt.channels = 3;
-	fmt.depth = CV_8U;
-	fmt.bitsPerPixel = 24;
-	fmt.origin = 1;
+	int imageWidth, imageHeight;
+	sampleImageFormat( camera.m_format.format, camera.m_format.width, camera.m_format.height, camera.m_format.bottomUp, sampleLength, 
+		fmt, imageWidth, imageHeight );
+	Vision::Image bufferImage( imageWidth, imageHeight, fmt, pBuffer );
+
+	PendingFrame frame;
+	frame.time = Time;
+	frame.image = m_imagePool->clone( bufferImage );
+
+	std::vector< PendingFrame > frameSet;
+	Measurement::Timestamp utTime;
+	unsigned long setNumber;
+	{
+		boost::mutex::scoped_lock l( m_pendingMutex );
+		if ( !m_clock.captureTime( pSample, frame.captureTime ) )
+			frame.captureTime = 0;
+		if ( m_pending[ index ].image )
+			m_statistics.count( FrameStatistics::COUNTER_UNMATCHED );
+		m_pending[ index ] = frame;
+
+		double tMin = Time;
+		double tMax = Time;
+		for ( std::size_t i = 0; i < m_pending.size(); i++ )
+		{
+			if ( !m_pending[ i ].image )
+				return;
+			if ( m_pending[ i ].time < tMin )
+				tMin = m_pending[ i ].time;
+			if ( m_pending[ i ].time > tMax )
+				tMax = m_pending[ i ].time;
+		}
+
+		// sample times are in seconds of the graph clock
+		double tolerance = m_syncTolerance * 1e-3;
+		if ( tMax - tMin > tolerance )
+		{
+			// frames too old to be matched by any later frame of the newest camera
+			for ( std::size_t i = 0; i < m_pending.size(); i++ )
+				if ( m_pending[ i ].time < tMax - tolerance )
+				{
+					m_pending[ i ] = PendingFrame();
+					m_statistics.count( FrameStatistics::COUNTER_UNMATCHED );
+				}
+			return;
+		}
+
+		// mean capture time of the set, relative to the first frame to keep the precision
+		double tSum = 0;
+		double captureSum = 0;
+		bool bCaptureKnown = true;
+		for ( std::size_t i = 0; i < m_pending.size(); i++ )
+		{
+			tSum += m_pending[ i ].time;
+			captureSum += double( (long long)( m_pending[ i ].captureTime - m_pending[ 0 ].captureTime ) );
+			bCaptureKnown = bCaptureKnown && m_pending[ i ].captureTime != 0;
+		}
+		if ( bCaptureKnown )
+			utTime = m_pending[ 0 ].captureTime + (long long)( captureSum / m_pending.size() );
+		else
+			utTime = m_syncer.convertNativeToLocal( tSum / m_pending.size() );
+		utTime += 1000000L * m_timeOffset;
 
-	Vision::Image bufferImage( m_sampleWidth, m_sampleHeight, fmt, pBuffer);
+		frameSet.swap( m_pending );
+		m_pending.resize( frameSet.size() );
+		setNumber = m_setsCompleted++;
+	}
 
-	Measurement::Timestamp utTime = m_syncer.convertNativeToLocal( Time );
+#ifdef ENABLE_EVENT_TRACING
+	TRACEPOINT_MEASUREMENT_CREATE(getEventDomain(), utTime, getName().c_str(), "VideoCapture")
+#endif
 
-	handleFrame( utTime + 1000000L * m_timeOffset, bufferImage );
+	if ( m_statistics.enabled() )
+	{
+		Measurement::Timestamp now = Measurement::now();
+		m_statistics.record( FrameStatistics::STAGE_DELIVERY, now > utTime ? now - utTime : 0 );
+	}
 
-	return S_OK;
+	// the pipelines are not reentrant, and the sets have to be pushed in the order of their timestamps
+	boost::mutex::scoped_lock l( m_processMutex );
+	while ( m_setsProcessed != setNumber )
+		m_processCond.wait( l );
+
+	try
+	{
+		// all images of the set carry the same timestamp
+		for ( std::size_t i = 0; i < frameSet.size(); i++ )
+		{
+			PortSink sink( *m_cameras[ i ], utTime );
+			m_cameras[ i ]->m_pipeline->process( frameSet[ i ].image, false, sink );
+		}
+	}
+	catch ( const std::exception& e )
+	{
+		LOG4CPP_ERROR( logger, getName() << ": error processing a frame set: " << e.what() );
+	}
+
+	m_setsProcessed++;
+	m_processCond.notify_all();
 }
 
 } } // namespace Ubitrack::Driver
 
 UBITRACK_REGISTER_COMPONENT( Dataflow::ComponentFactory* const cf ) {
 	cf->registerComponent< Ubitrack::Drivers::DirectShowFrameGrabber > ( "DirectShowFrameGrabber" );
+	cf->registerComponent< Ubitrack::Drivers::DirectShowMultiFrameGrabber > ( "DirectShowMultiFrameGrabber" );
+	cf->registerComponent< Ubitrack::Drivers::ReplayFrameGrabber > ( "DirectShowReplayFrameGrabber" );
 }
 
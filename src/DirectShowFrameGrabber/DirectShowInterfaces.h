@@ -119,6 +119,42 @@ typedef interface IMediaSample IMediaSample;
 #endif 	/* __IMediaSample_FWD_DEFINED__ */
 
 
+#ifndef __IAMBufferNegotiation_FWD_DEFINED__
+#define __IAMBufferNegotiation_FWD_DEFINED__
+typedef interface IAMBufferNegotiation IAMBufferNegotiation;
+#endif 	/* __IAMBufferNegotiation_FWD_DEFINED__ */
+
+
+#ifndef __IReferenceClock_FWD_DEFINED__
+#define __IReferenceClock_FWD_DEFINED__
+typedef interface IReferenceClock IReferenceClock;
+#endif 	/* __IReferenceClock_FWD_DEFINED__ */
+
+
+#ifndef __IAMVideoProcAmp_FWD_DEFINED__
+#define __IAMVideoProcAmp_FWD_DEFINED__
+typedef interface IAMVideoProcAmp IAMVideoProcAmp;
+#endif 	/* __IAMVideoProcAmp_FWD_DEFINED__ */
+
+
+#ifndef __IAMCameraControl_FWD_DEFINED__
+#define __IAMCameraControl_FWD_DEFINED__
+typedef interface IAMCameraControl IAMCameraControl;
+#endif 	/* __IAMCameraControl_FWD_DEFINED__ */
+
+
+#ifndef __IMediaEvent_FWD_DEFINED__
+#define __IMediaEvent_FWD_DEFINED__
+typedef interface IMediaEvent IMediaEvent;
+#endif 	/* __IMediaEvent_FWD_DEFINED__ */
+
+
+#ifndef __IMediaEventEx_FWD_DEFINED__
+#define __IMediaEventEx_FWD_DEFINED__
+typedef interface IMediaEventEx IMediaEventEx;
+#endif 	/* __IMediaEventEx_FWD_DEFINED__ */
+
+
 /* header files for imported files */
 #include "oaidl.h"
 
@@ -2386,6 +2422,929 @@ EXTERN_C const IID IID_IMediaSample;
 #endif 	/* __IMediaSample_INTERFACE_DEFINED__ */
 
 
+/* interface __MIDL_itf_DirectShowInterfaces_0000_0013 */
+/* [local] */ 
+
+typedef struct _AllocatorProperties
+    {
+    long cBuffers;
+    long cbBuffer;
+    long cbAlign;
+    long cbPrefix;
+    } 	ALLOCATOR_PROPERTIES;
+
+
+
+#ifndef __IAMBufferNegotiation_INTERFACE_DEFINED__
+#define __IAMBufferNegotiation_INTERFACE_DEFINED__
+
+/* interface IAMBufferNegotiation */
+/* [unique][uuid][local][object] */ 
+
+
+EXTERN_C const IID IID_IAMBufferNegotiation;
+
+#if defined(__cplusplus) && !defined(CINTERFACE)
+    
+    MIDL_INTERFACE("56ED71A0-AF5F-11D0-B3F0-00AA003761C5")
+    IAMBufferNegotiation : public IUnknown
+    {
+    public:
+        virtual HRESULT STDMETHODCALLTYPE SuggestAllocatorProperties( 
+            /* [in] */ 
+            __in  const ALLOCATOR_PROPERTIES *pprop) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE GetAllocatorProperties( 
+            /* [out] */ 
+            __out  ALLOCATOR_PROPERTIES *pprop) = 0;
+        
+    };
+    
+#else 	/* C style interface */
+
+    typedef struct IAMBufferNegotiationVtbl
+    {
+        BEGIN_INTERFACE
+        
+        HRESULT ( STDMETHODCALLTYPE *QueryInterface )( 
+            IAMBufferNegotiation * This,
+            /* [in] */ REFIID riid,
+            /* [iid_is][out] */ 
+            __RPC__deref_out  void **ppvObject);
+        
+        ULONG ( STDMETHODCALLTYPE *AddRef )( 
+            IAMBufferNegotiation * This);
+        
+        ULONG ( STDMETHODCALLTYPE *Release )( 
+            IAMBufferNegotiation * This);
+        
+        HRESULT ( STDMETHODCALLTYPE *SuggestAllocatorProperties )( 
+            IAMBufferNegotiation * This,
+            /* [in] */ 
+            __in  const ALLOCATOR_PROPERTIES *pprop);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetAllocatorProperties )( 
+            IAMBufferNegotiation * This,
+            /* [out] */ 
+            __out  ALLOCATOR_PROPERTIES *pprop);
+        
+        END_INTERFACE
+    } IAMBufferNegotiationVtbl;
+
+    interface IAMBufferNegotiation
+    {
+        CONST_VTBL struct IAMBufferNegotiationVtbl *lpVtbl;
+    };
+
+    
+
+#ifdef COBJMACROS
+
+
+#define IAMBufferNegotiation_QueryInterface(This,riid,ppvObject)	\
+    ( (This)->lpVtbl -> QueryInterface(This,riid,ppvObject) ) 
+
+#define IAMBufferNegotiation_AddRef(This)	\
+    ( (This)->lpVtbl -> AddRef(This) ) 
+
+#define IAMBufferNegotiation_Release(This)	\
+    ( (This)->lpVtbl -> Release(This) ) 
+
+
+#define IAMBufferNegotiation_SuggestAllocatorProperties(This,pprop)	\
+    ( (This)->lpVtbl -> SuggestAllocatorProperties(This,pprop) ) 
+
+#define IAMBufferNegotiation_GetAllocatorProperties(This,pprop)	\
+    ( (This)->lpVtbl -> GetAllocatorProperties(This,pprop) ) 
+
+#endif /* COBJMACROS */
+
+
+#endif 	/* C style interface */
+
+
+
+
+#endif 	/* __IAMBufferNegotiation_INTERFACE_DEFINED__ */
+
+
+typedef DWORD_PTR HSEMAPHORE;
+
+typedef DWORD_PTR HEVENT;
+
+#ifndef __IReferenceClock_INTERFACE_DEFINED__
+#define __IReferenceClock_INTERFACE_DEFINED__
+
+/* interface IReferenceClock */
+/* [unique][local][uuid][object] */ 
+
+
+EXTERN_C const IID IID_IReferenceClock;
+
+#if defined(__cplusplus) && !defined(CINTERFACE)
+    
+    MIDL_INTERFACE("56A86897-0AD4-11CE-B03A-0020AF0BA770")
+    IReferenceClock : public IUnknown
+    {
+    public:
+        virtual HRESULT STDMETHODCALLTYPE GetTime( 
+            /* [annotation][out] */ 
+            __out  REFERENCE_TIME *pTime) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE AdviseTime( 
+            /* [in] */ REFERENCE_TIME baseTime,
+            /* [in] */ REFERENCE_TIME streamTime,
+            /* [in] */ HEVENT hEvent,
+            /* [annotation][out] */ 
+            __out  DWORD_PTR *pdwAdviseCookie) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE AdvisePeriodic( 
+            /* [in] */ REFERENCE_TIME startTime,
+            /* [in] */ REFERENCE_TIME periodTime,
+            /* [in] */ HSEMAPHORE hSemaphore,
+            /* [annotation][out] */ 
+            __out  DWORD_PTR *pdwAdviseCookie) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE Unadvise( 
+            /* [in] */ DWORD_PTR dwAdviseCookie) = 0;
+        
+    };
+    
+#else 	/* C style interface */
+
+    typedef struct IReferenceClockVtbl
+    {
+        BEGIN_INTERFACE
+        
+        HRESULT ( STDMETHODCALLTYPE *QueryInterface )( 
+            IReferenceClock * This,
+            /* [in] */ REFIID riid,
+            /* [iid_is][out] */ 
+            __RPC__deref_out  void **ppvObject);
+        
+        ULONG ( STDMETHODCALLTYPE *AddRef )( 
+            IReferenceClock * This);
+        
+        ULONG ( STDMETHODCALLTYPE *Release )( 
+            IReferenceClock * This);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetTime )( 
+            IReferenceClock * This,
+            /* [annotation][out] */ 
+            __out  REFERENCE_TIME *pTime);
+        
+        HRESULT ( STDMETHODCALLTYPE *AdviseTime )( 
+            IReferenceClock * This,
+            /* [in] */ REFERENCE_TIME baseTime,
+            /* [in] */ REFERENCE_TIME streamTime,
+            /* [in] */ HEVENT hEvent,
+            /* [annotation][out] */ 
+            __out  DWORD_PTR *pdwAdviseCookie);
+        
+        HRESULT ( STDMETHODCALLTYPE *AdvisePeriodic )( 
+            IReferenceClock * This,
+            /* [in] */ REFERENCE_TIME startTime,
+            /* [in] */ REFERENCE_TIME periodTime,
+            /* [in] */ HSEMAPHORE hSemaphore,
+            /* [annotation][out] */ 
+            __out  DWORD_PTR *pdwAdviseCookie);
+        
+        HRESULT ( STDMETHODCALLTYPE *Unadvise )( 
+            IReferenceClock * This,
+            /* [in] */ DWORD_PTR dwAdviseCookie);
+        
+        END_INTERFACE
+    } IReferenceClockVtbl;
+
+    interface IReferenceClock
+    {
+        CONST_VTBL struct IReferenceClockVtbl *lpVtbl;
+    };
+
+    
+
+#ifdef COBJMACROS
+
+
+#define IReferenceClock_QueryInterface(This,riid,ppvObject)	\
+    ( (This)->lpVtbl -> QueryInterface(This,riid,ppvObject) ) 
+
+#define IReferenceClock_AddRef(This)	\
+    ( (This)->lpVtbl -> AddRef(This) ) 
+
+#define IReferenceClock_Release(This)	\
+    ( (This)->lpVtbl -> Release(This) ) 
+
+
+#define IReferenceClock_GetTime(This,pTime)	\
+    ( (This)->lpVtbl -> GetTime(This,pTime) ) 
+
+#define IReferenceClock_AdviseTime(This,baseTime,streamTime,hEvent,pdwAdviseCookie)	\
+    ( (This)->lpVtbl -> AdviseTime(This,baseTime,streamTime,hEvent,pdwAdviseCookie) ) 
+
+#define IReferenceClock_AdvisePeriodic(This,startTime,periodTime,hSemaphore,pdwAdviseCookie)	\
+    ( (This)->lpVtbl -> AdvisePeriodic(This,startTime,periodTime,hSemaphore,pdwAdviseCookie) ) 
+
+#define IReferenceClock_Unadvise(This,dwAdviseCookie)	\
+    ( (This)->lpVtbl -> Unadvise(This,dwAdviseCookie) ) 
+
+#endif /* COBJMACROS */
+
+
+#endif 	/* C style interface */
+
+
+
+
+#endif 	/* __IReferenceClock_INTERFACE_DEFINED__ */
+
+
+typedef 
+enum tagVideoProcAmpProperty
+    {	VideoProcAmp_Brightness	= 0,
+	VideoProcAmp_Contrast	= ( VideoProcAmp_Brightness + 1 ),
+	VideoProcAmp_Hue	= ( VideoProcAmp_Contrast + 1 ),
+	VideoProcAmp_Saturation	= ( VideoProcAmp_Hue + 1 ),
+	VideoProcAmp_Sharpness	= ( VideoProcAmp_Saturation + 1 ),
+	VideoProcAmp_Gamma	= ( VideoProcAmp_Sharpness + 1 ),
+	VideoProcAmp_ColorEnable	= ( VideoProcAmp_Gamma + 1 ),
+	VideoProcAmp_WhiteBalance	= ( VideoProcAmp_ColorEnable + 1 ),
+	VideoProcAmp_BacklightCompensation	= ( VideoProcAmp_WhiteBalance + 1 ),
+	VideoProcAmp_Gain	= ( VideoProcAmp_BacklightCompensation + 1 )
+    } 	VideoProcAmpProperty;
+
+typedef 
+enum tagVideoProcAmpFlags
+    {	VideoProcAmp_Flags_Auto	= 0x1,
+	VideoProcAmp_Flags_Manual	= 0x2
+    } 	VideoProcAmpFlags;
+
+typedef 
+enum tagCameraControlProperty
+    {	CameraControl_Pan	= 0,
+	CameraControl_Tilt	= ( CameraControl_Pan + 1 ),
+	CameraControl_Roll	= ( CameraControl_Tilt + 1 ),
+	CameraControl_Zoom	= ( CameraControl_Roll + 1 ),
+	CameraControl_Exposure	= ( CameraControl_Zoom + 1 ),
+	CameraControl_Iris	= ( CameraControl_Exposure + 1 ),
+	CameraControl_Focus	= ( CameraControl_Iris + 1 )
+    } 	CameraControlProperty;
+
+typedef 
+enum tagCameraControlFlags
+    {	CameraControl_Flags_Auto	= 0x1,
+	CameraControl_Flags_Manual	= 0x2
+    } 	CameraControlFlags;
+
+#ifndef __IAMVideoProcAmp_INTERFACE_DEFINED__
+#define __IAMVideoProcAmp_INTERFACE_DEFINED__
+
+/* interface IAMVideoProcAmp */
+/* [unique][uuid][object] */ 
+
+
+EXTERN_C const IID IID_IAMVideoProcAmp;
+
+#if defined(__cplusplus) && !defined(CINTERFACE)
+    
+    MIDL_INTERFACE("C6E13360-30AC-11D0-A18C-00A0C9118956")
+    IAMVideoProcAmp : public IUnknown
+    {
+    public:
+        virtual HRESULT STDMETHODCALLTYPE GetRange( 
+            /* [in] */ long Property,
+            /* [annotation][out] */ 
+            __out  long *pMin,
+            /* [annotation][out] */ 
+            __out  long *pMax,
+            /* [annotation][out] */ 
+            __out  long *pSteppingDelta,
+            /* [annotation][out] */ 
+            __out  long *pDefault,
+            /* [annotation][out] */ 
+            __out  long *pCapsFlags) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE Set( 
+            /* [in] */ long Property,
+            /* [in] */ long lValue,
+            /* [in] */ long Flags) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE Get( 
+            /* [in] */ long Property,
+            /* [annotation][out] */ 
+            __out  long *lValue,
+            /* [annotation][out] */ 
+            __out  long *Flags) = 0;
+        
+    };
+    
+#else 	/* C style interface */
+
+    typedef struct IAMVideoProcAmpVtbl
+    {
+        BEGIN_INTERFACE
+        
+        HRESULT ( STDMETHODCALLTYPE *QueryInterface )( 
+            IAMVideoProcAmp * This,
+            /* [in] */ REFIID riid,
+            /* [iid_is][out] */ 
+            __RPC__deref_out  void **ppvObject);
+        
+        ULONG ( STDMETHODCALLTYPE *AddRef )( 
+            IAMVideoProcAmp * This);
+        
+        ULONG ( STDMETHODCALLTYPE *Release )( 
+            IAMVideoProcAmp * This);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetRange )( 
+            IAMVideoProcAmp * This,
+            /* [in] */ long Property,
+            /* [annotation][out] */ 
+            __out  long *pMin,
+            /* [annotation][out] */ 
+            __out  long *pMax,
+            /* [annotation][out] */ 
+            __out  long *pSteppingDelta,
+            /* [annotation][out] */ 
+            __out  long *pDefault,
+            /* [annotation][out] */ 
+            __out  long *pCapsFlags);
+        
+        HRESULT ( STDMETHODCALLTYPE *Set )( 
+            IAMVideoProcAmp * This,
+            /* [in] */ long Property,
+            /* [in] */ long lValue,
+            /* [in] */ long Flags);
+        
+        HRESULT ( STDMETHODCALLTYPE *Get )( 
+            IAMVideoProcAmp * This,
+            /* [in] */ long Property,
+            /* [annotation][out] */ 
+            __out  long *lValue,
+            /* [annotation][out] */ 
+            __out  long *Flags);
+        
+        END_INTERFACE
+    } IAMVideoProcAmpVtbl;
+
+    interface IAMVideoProcAmp
+    {
+        CONST_VTBL struct IAMVideoProcAmpVtbl *lpVtbl;
+    };
+
+    
+
+#ifdef COBJMACROS
+
+
+#define IAMVideoProcAmp_QueryInterface(This,riid,ppvObject)	\
+    ( (This)->lpVtbl -> QueryInterface(This,riid,ppvObject) ) 
+
+#define IAMVideoProcAmp_AddRef(This)	\
+    ( (This)->lpVtbl -> AddRef(This) ) 
+
+#define IAMVideoProcAmp_Release(This)	\
+    ( (This)->lpVtbl -> Release(This) ) 
+
+
+#define IAMVideoProcAmp_GetRange(This,Property,pMin,pMax,pSteppingDelta,pDefault,pCapsFlags)	\
+    ( (This)->lpVtbl -> GetRange(This,Property,pMin,pMax,pSteppingDelta,pDefault,pCapsFlags) ) 
+
+#define IAMVideoProcAmp_Set(This,Property,lValue,Flags)	\
+    ( (This)->lpVtbl -> Set(This,Property,lValue,Flags) ) 
+
+#define IAMVideoProcAmp_Get(This,Property,lValue,Flags)	\
+    ( (This)->lpVtbl -> Get(This,Property,lValue,Flags) ) 
+
+#endif /* COBJMACROS */
+
+
+#endif 	/* C style interface */
+
+
+
+
+#endif 	/* __IAMVideoProcAmp_INTERFACE_DEFINED__ */
+
+
+#ifndef __IAMCameraControl_INTERFACE_DEFINED__
+#define __IAMCameraControl_INTERFACE_DEFINED__
+
+/* interface IAMCameraControl */
+/* [unique][uuid][object] */ 
+
+
+EXTERN_C const IID IID_IAMCameraControl;
+
+#if defined(__cplusplus) && !defined(CINTERFACE)
+    
+    MIDL_INTERFACE("C6E13370-30AC-11D0-A18C-00A0C9118956")
+    IAMCameraControl : public IUnknown
+    {
+    public:
+        virtual HRESULT STDMETHODCALLTYPE GetRange( 
+            /* [in] */ long Property,
+            /* [annotation][out] */ 
+            __out  long *pMin,
+            /* [annotation][out] */ 
+            __out  long *pMax,
+            /* [annotation][out] */ 
+            __out  long *pSteppingDelta,
+            /* [annotation][out] */ 
+            __out  long *pDefault,
+            /* [annotation][out] */ 
+            __out  long *pCapsFlags) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE Set( 
+            /* [in] */ long Property,
+            /* [in] */ long lValue,
+            /* [in] */ long Flags) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE Get( 
+            /* [in] */ long Property,
+            /* [annotation][out] */ 
+            __out  long *lValue,
+            /* [annotation][out] */ 
+            __out  long *Flags) = 0;
+        
+    };
+    
+#else 	/* C style interface */
+
+    typedef struct IAMCameraControlVtbl
+    {
+        BEGIN_INTERFACE
+        
+        HRESULT ( STDMETHODCALLTYPE *QueryInterface )( 
+            IAMCameraControl * This,
+            /* [in] */ REFIID riid,
+            /* [iid_is][out] */ 
+            __RPC__deref_out  void **ppvObject);
+        
+        ULONG ( STDMETHODCALLTYPE *AddRef )( 
+            IAMCameraControl * This);
+        
+        ULONG ( STDMETHODCALLTYPE *Release )( 
+            IAMCameraControl * This);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetRange )( 
+            IAMCameraControl * This,
+            /* [in] */ long Property,
+            /* [annotation][out] */ 
+            __out  long *pMin,
+            /* [annotation][out] */ 
+            __out  long *pMax,
+            /* [annotation][out] */ 
+            __out  long *pSteppingDelta,
+            /* [annotation][out] */ 
+            __out  long *pDefault,
+            /* [annotation][out] */ 
+            __out  long *pCapsFlags);
+        
+        HRESULT ( STDMETHODCALLTYPE *Set )( 
+            IAMCameraControl * This,
+            /* [in] */ long Property,
+            /* [in] */ long lValue,
+            /* [in] */ long Flags);
+        
+        HRESULT ( STDMETHODCALLTYPE *Get )( 
+            IAMCameraControl * This,
+            /* [in] */ long Property,
+            /* [annotation][out] */ 
+            __out  long *lValue,
+            /* [annotation][out] */ 
+            __out  long *Flags);
+        
+        END_INTERFACE
+    } IAMCameraControlVtbl;
+
+    interface IAMCameraControl
+    {
+        CONST_VTBL struct IAMCameraControlVtbl *lpVtbl;
+    };
+
+    
+
+#ifdef COBJMACROS
+
+
+#define IAMCameraControl_QueryInterface(This,riid,ppvObject)	\
+    ( (This)->lpVtbl -> QueryInterface(This,riid,ppvObject) ) 
+
+#define IAMCameraControl_AddRef(This)	\
+    ( (This)->lpVtbl -> AddRef(This) ) 
+
+#define IAMCameraControl_Release(This)	\
+    ( (This)->lpVtbl -> Release(This) ) 
+
+
+#define IAMCameraControl_GetRange(This,Property,pMin,pMax,pSteppingDelta,pDefault,pCapsFlags)	\
+    ( (This)->lpVtbl -> GetRange(This,Property,pMin,pMax,pSteppingDelta,pDefault,pCapsFlags) ) 
+
+#define IAMCameraControl_Set(This,Property,lValue,Flags)	\
+    ( (This)->lpVtbl -> Set(This,Property,lValue,Flags) ) 
+
+#define IAMCameraControl_Get(This,Property,lValue,Flags)	\
+    ( (This)->lpVtbl -> Get(This,Property,lValue,Flags) ) 
+
+#endif /* COBJMACROS */
+
+
+#endif 	/* C style interface */
+
+
+
+
+#endif 	/* __IAMCameraControl_INTERFACE_DEFINED__ */
+
+
+typedef LONG_PTR OAEVENT;
+
+typedef LONG_PTR OAHWND;
+
+/* event codes of evcode.h used by the frame grabber */
+#define EC_COMPLETE                         0x01
+#define EC_USERABORT                        0x02
+#define EC_ERRORABORT                       0x03
+#define EC_STREAM_ERROR_STOPPED             0x06
+#define EC_DEVICE_LOST                      0x1F
+
+#ifndef __IMediaEvent_INTERFACE_DEFINED__
+#define __IMediaEvent_INTERFACE_DEFINED__
+
+/* interface IMediaEvent */
+/* [unique][helpstring][uuid][object] */ 
+
+
+EXTERN_C const IID IID_IMediaEvent;
+
+#if defined(__cplusplus) && !defined(CINTERFACE)
+    
+    MIDL_INTERFACE("56A868B6-0AD4-11CE-B03A-0020AF0BA770")
+    IMediaEvent : public IDispatch
+    {
+    public:
+        virtual HRESULT STDMETHODCALLTYPE GetEventHandle( 
+            /* [out] */ OAEVENT *hEvent) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE GetEvent( 
+            /* [out] */ long *lEventCode,
+            /* [out] */ LONG_PTR *lParam1,
+            /* [out] */ LONG_PTR *lParam2,
+            /* [in] */ long msTimeout) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE WaitForCompletion( 
+            /* [in] */ long msTimeout,
+            /* [out] */ long *pEvCode) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE CancelDefaultHandling( 
+            /* [in] */ long lEvCode) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE RestoreDefaultHandling( 
+            /* [in] */ long lEvCode) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE FreeEventParams( 
+            /* [in] */ long lEvCode,
+            /* [in] */ LONG_PTR lParam1,
+            /* [in] */ LONG_PTR lParam2) = 0;
+        
+    };
+    
+#else 	/* C style interface */
+
+    typedef struct IMediaEventVtbl
+    {
+        BEGIN_INTERFACE
+        
+        HRESULT ( STDMETHODCALLTYPE *QueryInterface )( 
+            IMediaEvent * This,
+            /* [in] */ REFIID riid,
+            /* [iid_is][out] */ 
+            __RPC__deref_out  void **ppvObject);
+        
+        ULONG ( STDMETHODCALLTYPE *AddRef )( 
+            IMediaEvent * This);
+        
+        ULONG ( STDMETHODCALLTYPE *Release )( 
+            IMediaEvent * This);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetTypeInfoCount )( 
+            IMediaEvent * This,
+            /* [out] */ UINT *pctinfo);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetTypeInfo )( 
+            IMediaEvent * This,
+            /* [in] */ UINT iTInfo,
+            /* [in] */ LCID lcid,
+            /* [out] */ ITypeInfo **ppTInfo);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetIDsOfNames )( 
+            IMediaEvent * This,
+            /* [in] */ REFIID riid,
+            /* [size_is][in] */ LPOLESTR *rgszNames,
+            /* [range][in] */ UINT cNames,
+            /* [in] */ LCID lcid,
+            /* [size_is][out] */ DISPID *rgDispId);
+        
+        /* [local] */ HRESULT ( STDMETHODCALLTYPE *Invoke )( 
+            IMediaEvent * This,
+            /* [in] */ DISPID dispIdMember,
+            /* [in] */ REFIID riid,
+            /* [in] */ LCID lcid,
+            /* [in] */ WORD wFlags,
+            /* [out][in] */ DISPPARAMS *pDispParams,
+            /* [out] */ VARIANT *pVarResult,
+            /* [out] */ EXCEPINFO *pExcepInfo,
+            /* [out] */ UINT *puArgErr);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetEventHandle )( 
+            IMediaEvent * This,
+            /* [out] */ OAEVENT *hEvent);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetEvent )( 
+            IMediaEvent * This,
+            /* [out] */ long *lEventCode,
+            /* [out] */ LONG_PTR *lParam1,
+            /* [out] */ LONG_PTR *lParam2,
+            /* [in] */ long msTimeout);
+        
+        HRESULT ( STDMETHODCALLTYPE *WaitForCompletion )( 
+            IMediaEvent * This,
+            /* [in] */ long msTimeout,
+            /* [out] */ long *pEvCode);
+        
+        HRESULT ( STDMETHODCALLTYPE *CancelDefaultHandling )( 
+            IMediaEvent * This,
+            /* [in] */ long lEvCode);
+        
+        HRESULT ( STDMETHODCALLTYPE *RestoreDefaultHandling )( 
+            IMediaEvent * This,
+            /* [in] */ long lEvCode);
+        
+        HRESULT ( STDMETHODCALLTYPE *FreeEventParams )( 
+            IMediaEvent * This,
+            /* [in] */ long lEvCode,
+            /* [in] */ LONG_PTR lParam1,
+            /* [in] */ LONG_PTR lParam2);
+        
+        END_INTERFACE
+    } IMediaEventVtbl;
+
+    interface IMediaEvent
+    {
+        CONST_VTBL struct IMediaEventVtbl *lpVtbl;
+    };
+
+    
+
+#ifdef COBJMACROS
+
+
+#define IMediaEvent_QueryInterface(This,riid,ppvObject)	\
+    ( (This)->lpVtbl -> QueryInterface(This,riid,ppvObject) ) 
+
+#define IMediaEvent_AddRef(This)	\
+    ( (This)->lpVtbl -> AddRef(This) ) 
+
+#define IMediaEvent_Release(This)	\
+    ( (This)->lpVtbl -> Release(This) ) 
+
+
+#define IMediaEvent_GetTypeInfoCount(This,pctinfo)	\
+    ( (This)->lpVtbl -> GetTypeInfoCount(This,pctinfo) ) 
+
+#define IMediaEvent_GetTypeInfo(This,iTInfo,lcid,ppTInfo)	\
+    ( (This)->lpVtbl -> GetTypeInfo(This,iTInfo,lcid,ppTInfo) ) 
+
+#define IMediaEvent_GetIDsOfNames(This,riid,rgszNames,cNames,lcid,rgDispId)	\
+    ( (This)->lpVtbl -> GetIDsOfNames(This,riid,rgszNames,cNames,lcid,rgDispId) ) 
+
+#define IMediaEvent_Invoke(This,dispIdMember,riid,lcid,wFlags,pDispParams,pVarResult,pExcepInfo,puArgErr)	\
+    ( (This)->lpVtbl -> Invoke(This,dispIdMember,riid,lcid,wFlags,pDispParams,pVarResult,pExcepInfo,puArgErr) ) 
+
+
+#define IMediaEvent_GetEventHandle(This,hEvent)	\
+    ( (This)->lpVtbl -> GetEventHandle(This,hEvent) ) 
+
+#define IMediaEvent_GetEvent(This,lEventCode,lParam1,lParam2,msTimeout)	\
+    ( (This)->lpVtbl -> GetEvent(This,lEventCode,lParam1,lParam2,msTimeout) ) 
+
+#define IMediaEvent_WaitForCompletion(This,msTimeout,pEvCode)	\
+    ( (This)->lpVtbl -> WaitForCompletion(This,msTimeout,pEvCode) ) 
+
+#define IMediaEvent_CancelDefaultHandling(This,lEvCode)	\
+    ( (This)->lpVtbl -> CancelDefaultHandling(This,lEvCode) ) 
+
+#define IMediaEvent_RestoreDefaultHandling(This,lEvCode)	\
+    ( (This)->lpVtbl -> RestoreDefaultHandling(This,lEvCode) ) 
+
+#define IMediaEvent_FreeEventParams(This,lEvCode,lParam1,lParam2)	\
+    ( (This)->lpVtbl -> FreeEventParams(This,lEvCode,lParam1,lParam2) ) 
+
+#endif /* COBJMACROS */
+
+
+#endif 	/* C style interface */
+
+
+
+
+#endif 	/* __IMediaEvent_INTERFACE_DEFINED__ */
+
+
+#ifndef __IMediaEventEx_INTERFACE_DEFINED__
+#define __IMediaEventEx_INTERFACE_DEFINED__
+
+/* interface IMediaEventEx */
+/* [unique][helpstring][uuid][object] */ 
+
+
+EXTERN_C const IID IID_IMediaEventEx;
+
+#if defined(__cplusplus) && !defined(CINTERFACE)
+    
+    MIDL_INTERFACE("56A868C0-0AD4-11CE-B03A-0020AF0BA770")
+    IMediaEventEx : public IMediaEvent
+    {
+    public:
+        virtual HRESULT STDMETHODCALLTYPE SetNotifyWindow( 
+            /* [in] */ OAHWND hwnd,
+            /* [in] */ long lMsg,
+            /* [in] */ LONG_PTR lInstanceData) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE SetNotifyFlags( 
+            /* [in] */ long lNoNotifyFlags) = 0;
+        
+        virtual HRESULT STDMETHODCALLTYPE GetNotifyFlags( 
+            /* [out] */ long *lplNoNotifyFlags) = 0;
+        
+    };
+    
+#else 	/* C style interface */
+
+    typedef struct IMediaEventExVtbl
+    {
+        BEGIN_INTERFACE
+        
+        HRESULT ( STDMETHODCALLTYPE *QueryInterface )( 
+            IMediaEventEx * This,
+            /* [in] */ REFIID riid,
+            /* [iid_is][out] */ 
+            __RPC__deref_out  void **ppvObject);
+        
+        ULONG ( STDMETHODCALLTYPE *AddRef )( 
+            IMediaEventEx * This);
+        
+        ULONG ( STDMETHODCALLTYPE *Release )( 
+            IMediaEventEx * This);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetTypeInfoCount )( 
+            IMediaEventEx * This,
+            /* [out] */ UINT *pctinfo);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetTypeInfo )( 
+            IMediaEventEx * This,
+            /* [in] */ UINT iTInfo,
+            /* [in] */ LCID lcid,
+            /* [out] */ ITypeInfo **ppTInfo);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetIDsOfNames )( 
+            IMediaEventEx * This,
+            /* [in] */ REFIID riid,
+            /* [size_is][in] */ LPOLESTR *rgszNames,
+            /* [range][in] */ UINT cNames,
+            /* [in] */ LCID lcid,
+            /* [size_is][out] */ DISPID *rgDispId);
+        
+        /* [local] */ HRESULT ( STDMETHODCALLTYPE *Invoke )( 
+            IMediaEventEx * This,
+            /* [in] */ DISPID dispIdMember,
+            /* [in] */ REFIID riid,
+            /* [in] */ LCID lcid,
+            /* [in] */ WORD wFlags,
+            /* [out][in] */ DISPPARAMS *pDispParams,
+            /* [out] */ VARIANT *pVarResult,
+            /* [out] */ EXCEPINFO *pExcepInfo,
+            /* [out] */ UINT *puArgErr);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetEventHandle )( 
+            IMediaEventEx * This,
+            /* [out] */ OAEVENT *hEvent);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetEvent )( 
+            IMediaEventEx * This,
+            /* [out] */ long *lEventCode,
+            /* [out] */ LONG_PTR *lParam1,
+            /* [out] */ LONG_PTR *lParam2,
+            /* [in] */ long msTimeout);
+        
+        HRESULT ( STDMETHODCALLTYPE *WaitForCompletion )( 
+            IMediaEventEx * This,
+            /* [in] */ long msTimeout,
+            /* [out] */ long *pEvCode);
+        
+        HRESULT ( STDMETHODCALLTYPE *CancelDefaultHandling )( 
+            IMediaEventEx * This,
+            /* [in] */ long lEvCode);
+        
+        HRESULT ( STDMETHODCALLTYPE *RestoreDefaultHandling )( 
+            IMediaEventEx * This,
+            /* [in] */ long lEvCode);
+        
+        HRESULT ( STDMETHODCALLTYPE *FreeEventParams )( 
+            IMediaEventEx * This,
+            /* [in] */ long lEvCode,
+            /* [in] */ LONG_PTR lParam1,
+            /* [in] */ LONG_PTR lParam2);
+        
+        HRESULT ( STDMETHODCALLTYPE *SetNotifyWindow )( 
+            IMediaEventEx * This,
+            /* [in] */ OAHWND hwnd,
+            /* [in] */ long lMsg,
+            /* [in] */ LONG_PTR lInstanceData);
+        
+        HRESULT ( STDMETHODCALLTYPE *SetNotifyFlags )( 
+            IMediaEventEx * This,
+            /* [in] */ long lNoNotifyFlags);
+        
+        HRESULT ( STDMETHODCALLTYPE *GetNotifyFlags )( 
+            IMediaEventEx * This,
+            /* [out] */ long *lplNoNotifyFlags);
+        
+        END_INTERFACE
+    } IMediaEventExVtbl;
+
+    interface IMediaEventEx
+    {
+        CONST_VTBL struct IMediaEventExVtbl *lpVtbl;
+    };
+
+    
+
+#ifdef COBJMACROS
+
+
+#define IMediaEventEx_QueryInterface(This,riid,ppvObject)	\
+    ( (This)->lpVtbl -> QueryInterface(This,riid,ppvObject) ) 
+
+#define IMediaEventEx_AddRef(This)	\
+    ( (This)->lpVtbl -> AddRef(This) ) 
+
+#define IMediaEventEx_Release(This)	\
+    ( (This)->lpVtbl -> Release(This) ) 
+
+
+#define IMediaEventEx_GetTypeInfoCount(This,pctinfo)	\
+    ( (This)->lpVtbl -> GetTypeInfoCount(This,pctinfo) ) 
+
+#define IMediaEventEx_GetTypeInfo(This,iTInfo,lcid,ppTInfo)	\
+    ( (This)->lpVtbl -> GetTypeInfo(This,iTInfo,lcid,ppTInfo) ) 
+
+#define IMediaEventEx_GetIDsOfNames(This,riid,rgszNames,cNames,lcid,rgDispId)	\
+    ( (This)->lpVtbl -> GetIDsOfNames(This,riid,rgszNames,cNames,lcid,rgDispId) ) 
+
+#define IMediaEventEx_Invoke(This,dispIdMember,riid,lcid,wFlags,pDispParams,pVarResult,pExcepInfo,puArgErr)	\
+    ( (This)->lpVtbl -> Invoke(This,dispIdMember,riid,lcid,wFlags,pDispParams,pVarResult,pExcepInfo,puArgErr) ) 
+
+#define IMediaEventEx_GetEventHandle(This,hEvent)	\
+    ( (This)->lpVtbl -> GetEventHandle(This,hEvent) ) 
+
+#define IMediaEventEx_GetEvent(This,lEventCode,lParam1,lParam2,msTimeout)	\
+    ( (This)->lpVtbl -> GetEvent(This,lEventCode,lParam1,lParam2,msTimeout) ) 
+
+#define IMediaEventEx_WaitForCompletion(This,msTimeout,pEvCode)	\
+    ( (This)->lpVtbl -> WaitForCompletion(This,msTimeout,pEvCode) ) 
+
+#define IMediaEventEx_CancelDefaultHandling(This,lEvCode)	\
+    ( (This)->lpVtbl -> CancelDefaultHandling(This,lEvCode) ) 
+
+#define IMediaEventEx_RestoreDefaultHandling(This,lEvCode)	\
+    ( (This)->lpVtbl -> RestoreDefaultHandling(This,lEvCode) ) 
+
+#define IMediaEventEx_FreeEventParams(This,lEvCode,lParam1,lParam2)	\
+    ( (This)->lpVtbl -> FreeEventParams(This,lEvCode,lParam1,lParam2) ) 
+
+
+#define IMediaEventEx_SetNotifyWindow(This,hwnd,lMsg,lInstanceData)	\
+    ( (This)->lpVtbl -> SetNotifyWindow(This,hwnd,lMsg,lInstanceData) ) 
+
+#define IMediaEventEx_SetNotifyFlags(This,lNoNotifyFlags)	\
+    ( (This)->lpVtbl -> SetNotifyFlags(This,lNoNotifyFlags) ) 
+
+#define IMediaEventEx_GetNotifyFlags(This,lplNoNotifyFlags)	\
+    ( (This)->lpVtbl -> GetNotifyFlags(This,lplNoNotifyFlags) ) 
+
+#endif /* COBJMACROS */
+
+
+#endif 	/* C style interface */
+
+
+
+
+#endif 	/* __IMediaEventEx_INTERFACE_DEFINED__ */
+
+
 /* interface __MIDL_itf_DirectShowInterfaces_0000_0012 */
 /* [local] */ 
 
@@ -2399,6 +3358,21 @@ typedef struct tagVIDEOINFOHEADER {
     REFERENCE_TIME  AvgTimePerFrame;   // Average time per frame (100ns units)
     BITMAPINFOHEADER bmiHeader;
 } VIDEOINFOHEADER;
+
+typedef struct tagVIDEOINFOHEADER2 {
+    RECT            rcSource;
+    RECT            rcTarget;
+    DWORD           dwBitRate;
+    DWORD           dwBitErrorRate;
+    REFERENCE_TIME  AvgTimePerFrame;
+    DWORD           dwInterlaceFlags;
+    DWORD           dwCopyProtectFlags;
+    DWORD           dwPictAspectRatioX;
+    DWORD           dwPictAspectRatioY;
+    DWORD           dwControlFlags;
+    DWORD           dwReserved2;
+    BITMAPINFOHEADER bmiHeader;
+} VIDEOINFOHEADER2;
 #include "DirectShowGuids.h"
 
 
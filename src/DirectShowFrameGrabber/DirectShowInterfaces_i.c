@@ -102,6 +102,24 @@ MIDL_DEFINE_GUID(IID, IID_ISampleGrabber,0x6B652FFF,0x11FE,0x4fce,0x92,0xAD,0x02
 
 MIDL_DEFINE_GUID(IID, IID_IMediaSample,0x56a8689a,0x0ad4,0x11ce,0xb0,0x3a,0x00,0x20,0xaf,0x0b,0xa7,0x70);
 
+
+MIDL_DEFINE_GUID(IID, IID_IAMBufferNegotiation,0x56ED71A0,0xAF5F,0x11D0,0xB3,0xF0,0x00,0xAA,0x00,0x37,0x61,0xC5);
+
+
+MIDL_DEFINE_GUID(IID, IID_IReferenceClock,0x56a86897,0x0ad4,0x11ce,0xb0,0x3a,0x00,0x20,0xaf,0x0b,0xa7,0x70);
+
+
+MIDL_DEFINE_GUID(IID, IID_IAMVideoProcAmp,0xC6E13360,0x30AC,0x11d0,0xA1,0x8C,0x00,0xA0,0xC9,0x11,0x89,0x56);
+
+
+MIDL_DEFINE_GUID(IID, IID_IAMCameraControl,0xC6E13370,0x30AC,0x11d0,0xA1,0x8C,0x00,0xA0,0xC9,0x11,0x89,0x56);
+
+
+MIDL_DEFINE_GUID(IID, IID_IMediaEvent,0x56a868b6,0x0ad4,0x11ce,0xb0,0x3a,0x00,0x20,0xaf,0x0b,0xa7,0x70);
+
+
+MIDL_DEFINE_GUID(IID, IID_IMediaEventEx,0x56a868c0,0x0ad4,0x11ce,0xb0,0x3a,0x00,0x20,0xaf,0x0b,0xa7,0x70);
+
 #undef MIDL_DEFINE_GUID
 
 #ifdef __cplusplus
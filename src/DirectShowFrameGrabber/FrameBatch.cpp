@@ -0,0 +1,165 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Batches of processed frames stored as a single image
+ */
+
+#include "FrameBatch.h"
+
+namespace Ubitrack { namespace Drivers {
+
+cv::Size batchImageSize( cv::Size frame, int count )
+{
+	return cv::Size( frame.width, frame.height * count );
+}
+
+
+cv::Rect batchFrameRect( cv::Size frame, int index )
+{
+	return cv::Rect( cv::Point( 0, frame.height * index ), frame );
+}
+
+
+/** true if the image is (also) in GPU memory */
+static bool imageOnGPU( Vision::Image& image )
+{
+	return image.getImageState() == Vision::Image::ImageUploadState::OnCPUGPU ||
+		image.getImageState() == Vision::Image::ImageUploadState::OnGPU;
+}
+
+
+FrameBatcher::FrameBatcher( boost::shared_ptr< ImagePool > pImagePool, std::size_t size, Measurement::Timestamp window )
+	: m_pImagePool( pImagePool )
+	, m_size( size > 0 ? size : 1 )
+	, m_window( window )
+	, m_frameType( 0 )
+	, m_bGPU( false )
+{}
+
+
+bool FrameBatcher::add( Measurement::Timestamp t, Vision::Image& image, FrameBatch& completed )
+{
+	bool bGPU = imageOnGPU( image );
+	cv::Size frameSize( image.width(), image.height() );
+	int frameType = bGPU ? image.uMat().type() : image.Mat().type();
+
+	boost::mutex::scoped_lock l( m_mutex );
+
+	// frames of multiple processing threads need not arrive in time order
+	bool bCompleted = false;
+	if ( !m_pending.times.empty() && ( frameSize != m_frameSize || frameType != m_frameType || bGPU != m_bGPU ||
+		( m_window > 0 && t > m_pending.times.front() && t - m_pending.times.front() > m_window ) ) )
+	{
+		complete( completed );
+		bCompleted = true;
+	}
+
+	if ( m_pending.times.empty() )
+	{
+		Vision::Image::ImageFormatProperties fmt;
+		image.getFormatProperties( fmt );
+		cv::Size size = batchImageSize( frameSize, static_cast< int >( m_size ) );
+		m_pending.image = bGPU ? m_pImagePool->getGPUImage( size.width, size.height, fmt ) :
+			m_pImagePool->getImage( size.width, size.height, fmt );
+		m_frameSize = frameSize;
+		m_frameType = frameType;
+		m_bGPU = bGPU;
+	}
+
+	cv::Rect rect = batchFrameRect( frameSize, static_cast< int >( m_pending.times.size() ) );
+	if ( bGPU )
+		image.uMat().copyTo( m_pending.image->uMat()( rect ) );
+	else
+		image.Mat().copyTo( m_pending.image->Mat()( rect ) );
+	m_pending.times.push_back( t );
+
+	// with m_size == 1 no frame is ever pending, so a call completes at most one batch
+	if ( m_pending.times.size() >= m_size )
+	{
+		complete( completed );
+		bCompleted = true;
+	}
+	return bCompleted;
+}
+
+
+bool FrameBatcher::expire( Measurement::Timestamp now, FrameBatch& completed )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( m_window == 0 || m_pending.times.empty() || now <= m_pending.times.front() || now - m_pending.times.front() <= m_window )
+		return false;
+
+	complete( completed );
+	return true;
+}
+
+
+bool FrameBatcher::flush( FrameBatch& completed )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( m_pending.times.empty() )
+		return false;
+
+	complete( completed );
+	return true;
+}
+
+
+void FrameBatcher::reset()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_pending = FrameBatch();
+}
+
+
+void FrameBatcher::complete( FrameBatch& completed )
+{
+	int count = static_cast< int >( m_pending.times.size() );
+	if ( static_cast< std::size_t >( count ) < m_size )
+	{
+		// only the filled part of an incomplete batch is handed out
+		Vision::Image::ImageFormatProperties fmt;
+		m_pending.image->getFormatProperties( fmt );
+		cv::Size size = batchImageSize( m_frameSize, count );
+		cv::Rect filled( cv::Point( 0, 0 ), size );
+		boost::shared_ptr< Vision::Image > pImage;
+		if ( m_bGPU )
+		{
+			pImage = m_pImagePool->getGPUImage( size.width, size.height, fmt );
+			m_pending.image->uMat()( filled ).copyTo( pImage->uMat() );
+		}
+		else
+		{
+			pImage = m_pImagePool->getImage( size.width, size.height, fmt );
+			m_pending.image->Mat()( filled ).copyTo( pImage->Mat() );
+		}
+		m_pending.image = pImage;
+	}
+
+	completed = m_pending;
+	m_pending = FrameBatch();
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,134 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Batches of processed frames stored as a single image
+ */
+
+#ifndef __UBITRACK_DRIVERS_FRAMEBATCH_H_INCLUDED__
+#define __UBITRACK_DRIVERS_FRAMEBATCH_H_INCLUDED__
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <utMeasurement/Measurement.h>
+#include <utVision/Image.h>
+
+#include "ImagePool.h"
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Layout of a batch in one image.
+ *
+ * The frames (all W x H with the same format) are stacked from top to bottom in the order they were
+ * added, so the batch image is W pixels wide and N * H pixels high. Like a N x H x W x C tensor, the
+ * pixels of all frames form one contiguous buffer.
+ */
+
+/** size of the image holding \c count frames of size \c frame */
+cv::Size batchImageSize( cv::Size frame, int count );
+
+/** area of frame \c index in a batch image */
+cv::Rect batchFrameRect( cv::Size frame, int index );
+
+/** a completed batch */
+struct FrameBatch
+{
+	/** the frames, see batchImageSize */
+	boost::shared_ptr< Vision::Image > image;
+
+	/** timestamps of the frames */
+	std::vector< Measurement::Timestamp > times;
+};
+
+/**
+ * Collects frames of one output into batches.
+ *
+ * A batch is completed when it holds \c size frames, or when a frame arrives more than \c window
+ * nanoseconds after the first frame of the batch (0 waits for \c size frames), see also \c expire. A frame of a different
+ * size, format or memory (CPU or GPU) also completes the pending batch and starts a new one.
+ *
+ * Every frame is copied into a batch buffer from the image pool right away, so the frame itself is
+ * released immediately. GPU frames are batched in GPU memory. All methods are thread-safe, frames
+ * of concurrent callers are copied one after the other.
+ */
+class FrameBatcher
+	: private boost::noncopyable
+{
+public:
+
+	/** constructor */
+	FrameBatcher( boost::shared_ptr< ImagePool > pImagePool, std::size_t size, Measurement::Timestamp window );
+
+	/**
+	 * adds a frame.
+	 * @return true if a batch has been completed, which is returned in \c completed
+	 */
+	bool add( Measurement::Timestamp t, Vision::Image& image, FrameBatch& completed );
+
+	/**
+	 * completes the pending batch if the window has passed at time \c now without a further frame.
+	 * Called periodically, since otherwise only the next frame would complete it.
+	 * @return true if a batch has been completed, which is returned in \c completed
+	 */
+	bool expire( Measurement::Timestamp now, FrameBatch& completed );
+
+	/**
+	 * completes the pending batch, e.g. when capturing stops.
+	 * @return true if frames were pending, which are returned in \c completed
+	 */
+	bool flush( FrameBatch& completed );
+
+	/** discards the pending frames */
+	void reset();
+
+protected:
+
+	/** moves the pending frames into \c completed, m_mutex must be locked */
+	void complete( FrameBatch& completed );
+
+	boost::shared_ptr< ImagePool > m_pImagePool;
+	std::size_t m_size;
+	Measurement::Timestamp m_window;
+
+	/** batch being filled, allocated for m_size frames, protected by m_mutex */
+	FrameBatch m_pending;
+
+	/** frame size, OpenCV type and memory of the pending batch */
+	cv::Size m_frameSize;
+	int m_frameType;
+	bool m_bGPU;
+
+	boost::mutex m_mutex;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
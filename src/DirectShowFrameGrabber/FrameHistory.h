@@ -0,0 +1,117 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Recent frames of an output, for pull ports that must not slow down the capture
+ */
+
+#ifndef __UBITRACK_DRIVERS_FRAMEHISTORY_H_INCLUDED__
+#define __UBITRACK_DRIVERS_FRAMEHISTORY_H_INCLUDED__
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <utMeasurement/Measurement.h>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Ring of the most recent frames of an output.
+ *
+ * Publishing a frame replaces the oldest slot with an atomic pointer swap, so the capture never waits
+ * for readers, and readers of any number and rate only see complete frames. A frame stays valid for a
+ * reader as long as it holds the measurement, even if the slot has been reused in the meantime.
+ *
+ * All methods are thread-safe.
+ */
+class FrameHistory
+	: private boost::noncopyable
+{
+public:
+
+	/** constructor, keeps the last \c size frames */
+	FrameHistory( std::size_t size )
+		: m_slots( size > 0 ? size : 1 )
+		, m_next( 0 )
+	{}
+
+	std::size_t size() const
+	{ return m_slots.size(); }
+
+	/** adds a frame, never blocks */
+	void publish( const Measurement::ImageMeasurement& image )
+	{
+		boost::shared_ptr< const Measurement::ImageMeasurement > pEntry( new Measurement::ImageMeasurement( image ) );
+		boost::atomic_store( &m_slots[ m_next++ % m_slots.size() ], pEntry );
+	}
+
+	/**
+	 * the newest frame if \c t is 0 or not older than it, otherwise the frame nearest to \c t.
+	 * @return false if no frame has been published yet
+	 */
+	bool find( Measurement::Timestamp t, Measurement::ImageMeasurement& image ) const
+	{
+		// with several processing threads the slots are not necessarily in time order, so all are compared
+		boost::shared_ptr< const Measurement::ImageMeasurement > pNewest;
+		boost::shared_ptr< const Measurement::ImageMeasurement > pNearest;
+		Measurement::Timestamp nearestDistance = 0;
+		for ( std::size_t i = 0; i < m_slots.size(); i++ )
+		{
+			boost::shared_ptr< const Measurement::ImageMeasurement > pEntry = boost::atomic_load( &m_slots[ i ] );
+			if ( !pEntry )
+				continue;
+
+			Measurement::Timestamp time = pEntry->time();
+			if ( !pNewest || time > pNewest->time() )
+				pNewest = pEntry;
+
+			Measurement::Timestamp distance = time > t ? time - t : t - time;
+			if ( !pNearest || distance < nearestDistance )
+			{
+				pNearest = pEntry;
+				nearestDistance = distance;
+			}
+		}
+
+		if ( !pNewest )
+			return false;
+		image = ( t == 0 || t >= pNewest->time() ) ? *pNewest : *pNearest;
+		return true;
+	}
+
+protected:
+
+	/** only accessed with boost::atomic_load/atomic_store */
+	std::vector< boost::shared_ptr< const Measurement::ImageMeasurement > > m_slots;
+
+	/** number of frames published */
+	boost::atomic< std::size_t > m_next;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
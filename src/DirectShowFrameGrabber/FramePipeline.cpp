@@ -0,0 +1,900 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Per-frame image processing of the DirectShow frame grabber
+ */
+
+#include "FramePipeline.h"
+#include "ImagePyramid.h"
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <log4cpp/Category.hh>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <utVision/OpenCLManager.h>
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+using namespace Ubitrack::Vision;
+
+namespace Ubitrack { namespace Drivers {
+
+/** deleter for images that refer to the buffer of another image, keeps that image alive */
+class SampleKeepAlive
+{
+public:
+	SampleKeepAlive( boost::shared_ptr< Vision::Image > pOwner )
+		: m_pOwner( pOwner )
+	{}
+
+	void operator()( Vision::Image* pImage )
+	{
+		delete pImage;
+		m_pOwner.reset();
+	}
+
+protected:
+	boost::shared_ptr< Vision::Image > m_pOwner;
+};
+
+/** converts a band of sample rows to BGR, clears \c *pOk on failure */
+static void bgrBand( SampleFormat format, const cv::Mat& sample, int width, int height, cv::Mat bgr, boost::atomic< bool >* pOk, 
+	const cv::Range& rows )
+{
+	if ( !convertSampleRegionToBGR( format, sample, width, height, cv::Rect( 0, rows.start, width, rows.size() ), bgr.rowRange( rows ) ) )
+		*pOk = false;
+}
+
+/** converts a band of sample rows to greyscale, clears \c *pOk on failure */
+static void greySampleBand( SampleFormat format, const cv::Mat& sample, int width, int height, cv::Mat grey, boost::atomic< bool >* pOk, 
+	const cv::Range& rows )
+{
+	if ( !convertSampleRegionToGrey( format, sample, width, height, cv::Rect( 0, rows.start, width, rows.size() ), grey.rowRange( rows ) ) )
+		*pOk = false;
+}
+
+/** converts a band of a BGR image to greyscale */
+static void greyBand( const cv::Mat& color, cv::Mat grey, const cv::Range& rows )
+{
+	cv::Mat target( grey.rowRange( rows ) );
+	cv::cvtColor( color.rowRange( rows ), target, cv::COLOR_BGR2GRAY );
+}
+
+/** remaps a band of the target image, and converts it to greyscale right away if \c grey is given */
+static void undistortBand( const UndistortionMap& map, const cv::Mat& source, cv::Mat target, cv::Mat grey, const cv::Range& rows )
+{
+	cv::Mat band( target.rowRange( rows ) );
+	map.remap( source, band, cv::Rect( 0, rows.start, target.cols, rows.size() ) );
+	if ( !grey.empty() )
+	{
+		cv::Mat greyBand( grey.rowRange( rows ) );
+		cv::cvtColor( band, greyBand, cv::COLOR_BGR2GRAY );
+	}
+}
+
+
+FramePipeline::FramePipeline( boost::shared_ptr< ImagePool > pImagePool, UndistortionMapCache& undistortionMaps, FrameStatistics& statistics )
+	: m_sampleFormat( SAMPLE_RGB24 )
+	, m_sampleWidth( 0 )
+	, m_sampleHeight( 0 )
+	, m_desiredWidth( 0 )
+	, m_desiredHeight( 0 )
+	, m_autoGPUUpload( false )
+	, m_binning( 1 )
+	, m_pyramidLevels( 4 )
+	, m_bands( 1 )
+	, m_imagePool( pImagePool )
+	, m_undistortionMaps( undistortionMaps )
+	, m_statistics( statistics )
+{
+}
+
+
+void FramePipeline::setSampleFormat( SampleFormat format, int width, int height )
+{
+	m_sampleFormat = format;
+	m_sampleWidth = width;
+	m_sampleHeight = height;
+}
+
+
+void FramePipeline::setDesiredSize( int width, int height )
+{
+	m_desiredWidth = width;
+	m_desiredHeight = height;
+}
+
+
+void FramePipeline::setGPUUpload( bool bUpload )
+{
+	m_autoGPUUpload = bUpload;
+}
+
+
+void FramePipeline::setBandPool( boost::shared_ptr< BandPool > pPool, int bands )
+{
+	m_pBandPool = pPool;
+	m_bands = bands;
+}
+
+
+void FramePipeline::forBands( int rows, int alignment, const BandPool::BandFunction& function )
+{
+	if ( banded() )
+		m_pBandPool->run( rows, m_bands, alignment, function );
+	else
+		function( cv::Range( 0, rows ) );
+}
+
+
+void FramePipeline::setPyramidLevels( int levels )
+{
+	m_pyramidLevels = levels > 1 ? levels : 1;
+}
+
+
+void FramePipeline::setBinning( int factor )
+{
+	m_binning = factor > 1 ? factor : 1;
+}
+
+
+void FramePipeline::setRegionOfInterest( const cv::Rect& region )
+{
+	boost::mutex::scoped_lock l( m_regionMutex );
+	m_region = region;
+}
+
+
+cv::Rect FramePipeline::regionOfInterest() const
+{
+	boost::mutex::scoped_lock l( m_regionMutex );
+	return m_region;
+}
+
+
+cv::Size FramePipeline::outputSize( cv::Size size ) const
+{
+	if ( m_binning > 1 )
+		return cv::Size( size.width / m_binning, size.height / m_binning );
+	if ( ( m_desiredWidth > 0 && m_desiredHeight > 0 ) && ( size.width > m_desiredWidth || size.height > m_desiredHeight ) )
+		return cv::Size( m_desiredWidth, m_desiredHeight );
+	return size;
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::decodeSample( Vision::Image& sampleImage )
+{
+	FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_CONVERT );
+
+	Vision::Image::ImageFormatProperties fmt;
+	fmt.imageFormat = Vision::Image::BGR;
+	fmt.channels = 3;
+	fmt.depth = CV_8U;
+	fmt.bitsPerPixel = 24;
+	fmt.origin = 0;
+
+	boost::shared_ptr< Vision::Image > pImage( m_imagePool->getImage( m_sampleWidth, m_sampleHeight, fmt ) );
+	bool bConverted;
+	if ( banded() && m_sampleFormat != SAMPLE_MJPG )
+	{
+		// bands of even height keep the NV12 chroma rows together
+		boost::atomic< bool > bOk( true );
+		forBands( m_sampleHeight, 2, boost::bind( &bgrBand, m_sampleFormat, sampleImage.Mat(), m_sampleWidth, m_sampleHeight, 
+			pImage->Mat(), &bOk, _1 ) );
+		bConverted = bOk;
+	}
+	else
+		bConverted = convertSampleToBGR( m_sampleFormat, sampleImage.Mat(), pImage->Mat() );
+
+	if ( !bConverted )
+	{
+		LOG4CPP_WARN( logger, "Unable to convert " << sampleFormatName( m_sampleFormat ) << " sample" );
+		pImage.reset();
+	}
+	return pImage;
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::greyFromColor( Vision::Image& colorImage )
+{
+	FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_CONVERT );
+
+	Vision::Image::ImageFormatProperties fmt;
+	colorImage.getFormatProperties( fmt );
+	fmt.imageFormat = Vision::Image::LUMINANCE;
+	fmt.channels = 1;
+	fmt.bitsPerPixel = 8;
+
+	boost::shared_ptr< Vision::Image > pGreyImage;
+	if ( colorImage.getImageState() == Image::ImageUploadState::OnCPUGPU || colorImage.getImageState() == Image::ImageUploadState::OnGPU )
+	{
+		pGreyImage = m_imagePool->getGPUImage( colorImage.width(), colorImage.height(), fmt );
+		cv::cvtColor( colorImage.uMat(), pGreyImage->uMat(), cv::COLOR_BGR2GRAY );
+	}
+	else
+	{
+		pGreyImage = m_imagePool->getImage( colorImage.width(), colorImage.height(), fmt );
+		forBands( colorImage.height(), 1, boost::bind( &greyBand, colorImage.Mat(), pGreyImage->Mat(), _1 ) );
+	}
+	return pGreyImage;
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::greyFromSample( boost::shared_ptr< Vision::Image > pSampleImage, bool bTransient )
+{
+	FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_CONVERT );
+
+	Vision::Image::ImageFormatProperties fmt;
+	fmt.imageFormat = Vision::Image::LUMINANCE;
+	fmt.channels = 1;
+	fmt.depth = CV_8U;
+	fmt.bitsPerPixel = 8;
+	fmt.origin = 0;
+
+	// NV12: use the Y plane in place
+	cv::Mat lumaPlane = sampleLumaPlane( m_sampleFormat, pSampleImage->Mat(), m_sampleWidth, m_sampleHeight );
+	if ( !lumaPlane.empty() )
+	{
+		boost::shared_ptr< Vision::Image > pLuma;
+		if ( bTransient )
+			pLuma.reset( new Vision::Image( m_sampleWidth, m_sampleHeight, fmt, lumaPlane.data ) );
+		else
+			pLuma.reset( new Vision::Image( m_sampleWidth, m_sampleHeight, fmt, lumaPlane.data ), SampleKeepAlive( pSampleImage ) );
+
+		// a transient view must not leave this frame, resizing creates a copy anyway
+		if ( bTransient && !needsResize( *pLuma ) )
+			return m_imagePool->clone( *pLuma );
+		return pLuma;
+	}
+
+	boost::shared_ptr< Vision::Image > pGreyImage( m_imagePool->getImage( m_sampleWidth, m_sampleHeight, fmt ) );
+	bool bConverted;
+	if ( banded() && m_sampleFormat != SAMPLE_MJPG )
+	{
+		boost::atomic< bool > bOk( true );
+		forBands( m_sampleHeight, 2, boost::bind( &greySampleBand, m_sampleFormat, pSampleImage->Mat(), m_sampleWidth, m_sampleHeight, 
+			pGreyImage->Mat(), &bOk, _1 ) );
+		bConverted = bOk;
+	}
+	else
+		bConverted = convertSampleToGrey( m_sampleFormat, pSampleImage->Mat(), pGreyImage->Mat() );
+
+	if ( !bConverted )
+	{
+		LOG4CPP_WARN( logger, "Unable to convert " << sampleFormatName( m_sampleFormat ) << " sample to greyscale" );
+		pGreyImage.reset();
+	}
+	return pGreyImage;
+}
+
+
+bool FramePipeline::needsResize( const Vision::Image& image ) const
+{
+	cv::Size size( image.width(), image.height() );
+	return outputSize( size ) != size;
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::resizeImage( Vision::Image& image )
+{
+	FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_RESIZE );
+
+	Vision::Image::ImageFormatProperties fmt;
+	image.getFormatProperties(fmt);
+	cv::Size size = outputSize( cv::Size( image.width(), image.height() ) );
+	bool bFlip = fmt.origin != 0;
+	fmt.origin = 0;
+
+	// area interpolation averages the pixel blocks when binning. Bottom-up images only get here
+	// when binning, the other resizes are done by remap tables that flip as well, so flipping
+	// the small result in place is cheap
+	int interpolation = m_binning > 1 ? cv::INTER_AREA : cv::INTER_LINEAR;
+	boost::shared_ptr< Vision::Image > pResized;
+	if ( image.getImageState() == Image::ImageUploadState::OnCPUGPU || image.getImageState() == Image::ImageUploadState::OnGPU )
+	{
+		pResized = m_imagePool->getGPUImage( size.width, size.height, fmt );
+		cv::resize( image.uMat(), pResized->uMat(), size, 0, 0, interpolation );
+		if ( bFlip )
+			cv::flip( pResized->uMat(), pResized->uMat(), 0 );
+	}
+	else
+	{
+		pResized = m_imagePool->getImage( size.width, size.height, fmt );
+		cv::Mat target( pResized->Mat() );
+		cv::resize( image.Mat(), target, size, 0, 0, interpolation );
+		if ( bFlip )
+			cv::flip( target, target, 0 );
+	}
+	return pResized;
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::flipImage( Vision::Image& image )
+{
+	Vision::Image::ImageFormatProperties fmt;
+	image.getFormatProperties( fmt );
+	fmt.origin = 0;
+
+	boost::shared_ptr< Vision::Image > pFlipped;
+	if ( image.getImageState() == Image::ImageUploadState::OnCPUGPU || image.getImageState() == Image::ImageUploadState::OnGPU )
+	{
+		pFlipped = m_imagePool->getGPUImage( image.width(), image.height(), fmt );
+		cv::flip( image.uMat(), pFlipped->uMat(), 0 );
+	}
+	else
+	{
+		pFlipped = m_imagePool->getImage( image.width(), image.height(), fmt );
+		cv::Mat target( pFlipped->Mat() );
+		cv::flip( image.Mat(), target, 0 );
+	}
+	return pFlipped;
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::undistortImage( boost::shared_ptr< Vision::Image > pImage, bool bTransient, 
+	boost::shared_ptr< Vision::Image >* pGrey )
+{
+	bool bResize = needsResize( *pImage );
+	bool bottomUp = pImage->origin() != 0;
+	cv::Size sourceSize( pImage->width(), pImage->height() );
+	cv::Size targetSize = outputSize( sourceSize );
+
+	// bottom-up images are resized with a table that flips them, except for the area resampling of binning
+	boost::shared_ptr< UndistortionMap > pMap = m_undistortionMaps.get( sourceSize, targetSize, bottomUp, 
+		bottomUp && bResize && m_binning == 1 );
+	if ( !pMap )
+	{
+		if ( bResize )
+			return resizeImage( *pImage );
+		if ( bottomUp )
+			return flipImage( *pImage );
+		return bTransient ? m_imagePool->clone( *pImage ) : pImage;
+	}
+
+	FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_UNDISTORT );
+	Vision::Image::ImageFormatProperties fmt;
+	pImage->getFormatProperties( fmt );
+	fmt.origin = 0;
+
+	boost::shared_ptr< Vision::Image > pResult;
+	if ( pImage->getImageState() == Image::ImageUploadState::OnCPUGPU || pImage->getImageState() == Image::ImageUploadState::OnGPU )
+	{
+		pResult = m_imagePool->getGPUImage( targetSize.width, targetSize.height, fmt );
+		pMap->remap( pImage->uMat(), pResult->uMat() );
+	}
+	else if ( banded() )
+	{
+		// the remap tables only read the source, so the bands of the target are independent
+		pResult = m_imagePool->getImage( targetSize.width, targetSize.height, fmt );
+		cv::Mat grey;
+		if ( pGrey && fmt.channels == 3 )
+		{
+			fmt.imageFormat = Vision::Image::LUMINANCE;
+			fmt.channels = 1;
+			fmt.bitsPerPixel = 8;
+			*pGrey = m_imagePool->getImage( targetSize.width, targetSize.height, fmt );
+			grey = (*pGrey)->Mat();
+		}
+		forBands( targetSize.height, 1, boost::bind( &undistortBand, boost::cref( *pMap ), pImage->Mat(), pResult->Mat(), grey, _1 ) );
+	}
+	else
+	{
+		pResult = m_imagePool->getImage( targetSize.width, targetSize.height, fmt );
+		pMap->remap( pImage->Mat(), pResult->Mat() );
+	}
+	return pResult;
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::uploadSample( Vision::Image& sampleImage )
+{
+	FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_UPLOAD );
+
+	Vision::Image::ImageFormatProperties fmt;
+	sampleImage.getFormatProperties( fmt );
+
+	// host accessible (pinned) buffers are transferred by DMA, or not at all on integrated GPUs
+	boost::shared_ptr< Vision::Image > pUpload( m_imagePool->getGPUImage( sampleImage.width(), sampleImage.height(), fmt, 
+		cv::USAGE_ALLOCATE_HOST_MEMORY ) );
+	sampleImage.Mat().copyTo( pUpload->uMat() );
+	return pUpload;
+}
+
+
+/**
+ * Lazily computed intermediate images of one frame.
+ *
+ * Every stage is computed at most once, on its first request, from the cheapest input that is
+ * available at that time. The outputs are requested in the order of FramePipeline::Output, so the
+ * color image can start from the flipped RAW image and the greyscale image is converted from the
+ * color image if those were needed anyway. Nothing is computed for outputs nobody asks for.
+ */
+class FramePipeline::FrameStages
+	: private boost::noncopyable
+{
+public:
+
+	enum Stage
+	{
+		STAGE_UPLOAD,     ///< the sample in GPU memory
+		STAGE_BGR,        ///< full resolution color image in sample orientation
+		STAGE_RAW,        ///< full resolution top-down color image
+		STAGE_COLOR,      ///< resized, undistorted and cropped color image
+		STAGE_GREY_FULL,  ///< full resolution greyscale image in sample orientation
+		STAGE_GREY,       ///< resized, undistorted and cropped greyscale image
+		STAGE_PYRAMID,
+		STAGE_COUNT
+	};
+
+	/**
+	 * @param bGPU process the sample with OpenCL after a single upload
+	 * @param bFuseGrey compute the greyscale image together with the undistorted color image
+	 * @param region crops the color and greyscale images, empty for the whole image
+	 */
+	FrameStages( FramePipeline& pipeline, boost::shared_ptr< Vision::Image > pSample, bool bTransient, bool bGPU, bool bFuseGrey, 
+		const cv::Rect& region )
+		: m_pipeline( pipeline )
+		, m_pSample( pSample )
+		, m_bTransient( bTransient )
+		, m_bGPU( bGPU )
+		, m_bFuseGrey( bFuseGrey )
+		, m_region( region )
+	{
+		for ( int i = 0; i < STAGE_COUNT; i++ )
+			m_bComputed[ i ] = false;
+	}
+
+	/** image of a pipeline output, an empty pointer if it could not be computed */
+	boost::shared_ptr< Vision::Image > output( Output output )
+	{
+		switch ( output )
+		{
+		case OUTPUT_RAW: return get( STAGE_RAW );
+		case OUTPUT_COLOR: return get( STAGE_COLOR );
+		case OUTPUT_GREY: return get( STAGE_GREY );
+		case OUTPUT_PYRAMID: return get( STAGE_PYRAMID );
+		default: return boost::shared_ptr< Vision::Image >();
+		}
+	}
+
+	/** result of a stage, computed on the first call */
+	boost::shared_ptr< Vision::Image > get( Stage stage )
+	{
+		if ( !m_bComputed[ stage ] )
+		{
+			m_images[ stage ] = compute( stage );
+			m_bComputed[ stage ] = true;
+		}
+		return m_images[ stage ];
+	}
+
+protected:
+
+	/** true if the result of a stage is already available */
+	bool available( Stage stage ) const
+	{ return m_bComputed[ stage ] && m_images[ stage ]; }
+
+	/** true if the image is the sample buffer, which may be transient */
+	bool transient( const boost::shared_ptr< Vision::Image >& pImage ) const
+	{ return m_bTransient && pImage == m_pSample; }
+
+	boost::shared_ptr< Vision::Image > compute( Stage stage )
+	{
+		FramePipeline& p( m_pipeline );
+		switch ( stage )
+		{
+		case STAGE_UPLOAD:
+			// samples shared from D3D11 textures are in GPU memory already
+			if ( m_pSample->getImageState() == Image::ImageUploadState::OnGPU )
+				return m_pSample;
+			return p.uploadSample( *m_pSample );
+
+		case STAGE_BGR:
+			return m_bGPU ? bgrOnGPU() : bgrOnCPU();
+
+		case STAGE_RAW:
+		{
+			boost::shared_ptr< Vision::Image > pBGR = get( STAGE_BGR );
+			if ( !pBGR )
+				return pBGR;
+			if ( pBGR->origin() != 0 )
+				return p.flipImage( *pBGR );
+			return transient( pBGR ) ? p.m_imagePool->clone( *pBGR ) : pBGR;
+		}
+
+		case STAGE_COLOR:
+		{
+			// the RAW image is already top-down
+			boost::shared_ptr< Vision::Image > pSource = available( STAGE_RAW ) ? get( STAGE_RAW ) : get( STAGE_BGR );
+			if ( !pSource )
+				return pSource;
+
+			// the greyscale image is converted band by band right after undistorting, while the band is in cache
+			boost::shared_ptr< Vision::Image > pGrey;
+			boost::shared_ptr< Vision::Image > pColor = p.undistortImage( pSource, transient( pSource ), m_bFuseGrey ? &pGrey : 0 );
+			if ( pGrey )
+			{
+				m_images[ STAGE_GREY ] = crop( pGrey );
+				m_bComputed[ STAGE_GREY ] = true;
+			}
+			return crop( pColor );
+		}
+
+		case STAGE_GREY_FULL:
+		{
+			// RGB24 samples are color images already
+			if ( available( STAGE_RAW ) )
+				return p.greyFromColor( *get( STAGE_RAW ) );
+			if ( available( STAGE_BGR ) || p.m_sampleFormat == SAMPLE_RGB24 )
+			{
+				boost::shared_ptr< Vision::Image > pBGR = get( STAGE_BGR );
+				return pBGR ? p.greyFromColor( *pBGR ) : pBGR;
+			}
+			return m_bGPU ? greyOnGPU() : p.greyFromSample( m_pSample, m_bTransient );
+		}
+
+		case STAGE_GREY:
+		{
+			// the color image is already resized, undistorted and cropped
+			if ( available( STAGE_COLOR ) )
+				return p.greyFromColor( *get( STAGE_COLOR ) );
+			boost::shared_ptr< Vision::Image > pGrey = get( STAGE_GREY_FULL );
+			return pGrey ? crop( p.undistortImage( pGrey, false ) ) : pGrey;
+		}
+
+		case STAGE_PYRAMID:
+		{
+			boost::shared_ptr< Vision::Image > pGrey = get( STAGE_GREY );
+			return pGrey ? p.pyramidFromGrey( *pGrey ) : pGrey;
+		}
+
+		default:
+			return boost::shared_ptr< Vision::Image >();
+		}
+	}
+
+	boost::shared_ptr< Vision::Image > bgrOnCPU()
+	{
+		if ( m_pipeline.m_sampleFormat == SAMPLE_RGB24 )
+			return m_pSample;
+
+		boost::shared_ptr< Vision::Image > pBGR = m_pipeline.decodeSample( *m_pSample );
+
+		// formats that cannot be converted on the GPU (MJPG) are uploaded after decoding
+		if ( pBGR && m_pipeline.m_autoGPUUpload && Vision::OpenCLManager::singleton().isInitialized() )
+		{
+			FrameStatistics::ScopedTimer timer( m_pipeline.m_statistics, FrameStatistics::STAGE_UPLOAD );
+			pBGR->uMat();
+		}
+		return pBGR;
+	}
+
+	boost::shared_ptr< Vision::Image > bgrOnGPU()
+	{
+		boost::shared_ptr< Vision::Image > pSample = get( STAGE_UPLOAD );
+		if ( m_pipeline.m_sampleFormat == SAMPLE_RGB24 )
+			return pSample;
+
+		FrameStatistics::ScopedTimer timer( m_pipeline.m_statistics, FrameStatistics::STAGE_CONVERT );
+
+		Vision::Image::ImageFormatProperties fmt;
+		fmt.imageFormat = Vision::Image::BGR;
+		fmt.channels = 3;
+		fmt.depth = CV_8U;
+		fmt.bitsPerPixel = 24;
+		fmt.origin = 0;
+
+		boost::shared_ptr< Vision::Image > pBGR( m_pipeline.m_imagePool->getGPUImage( m_pipeline.m_sampleWidth, m_pipeline.m_sampleHeight, fmt ) );
+		if ( !convertSampleToBGR( m_pipeline.m_sampleFormat, pSample->uMat(), pBGR->uMat() ) )
+		{
+			LOG4CPP_WARN( logger, "Unable to convert " << sampleFormatName( m_pipeline.m_sampleFormat ) << " sample on the GPU" );
+			pBGR.reset();
+		}
+		return pBGR;
+	}
+
+	boost::shared_ptr< Vision::Image > greyOnGPU()
+	{
+		boost::shared_ptr< Vision::Image > pSample = get( STAGE_UPLOAD );
+		FrameStatistics::ScopedTimer timer( m_pipeline.m_statistics, FrameStatistics::STAGE_CONVERT );
+
+		Vision::Image::ImageFormatProperties fmt;
+		fmt.imageFormat = Vision::Image::LUMINANCE;
+		fmt.channels = 1;
+		fmt.depth = CV_8U;
+		fmt.bitsPerPixel = 8;
+		fmt.origin = 0;
+
+		boost::shared_ptr< Vision::Image > pGrey( m_pipeline.m_imagePool->getGPUImage( m_pipeline.m_sampleWidth, m_pipeline.m_sampleHeight, fmt ) );
+		if ( !convertSampleToGrey( m_pipeline.m_sampleFormat, pSample->uMat(), pGrey->uMat() ) )
+		{
+			LOG4CPP_WARN( logger, "Unable to convert " << sampleFormatName( m_pipeline.m_sampleFormat ) << " sample to greyscale on the GPU" );
+			pGrey.reset();
+		}
+		return pGrey;
+	}
+
+	boost::shared_ptr< Vision::Image > crop( boost::shared_ptr< Vision::Image > pImage )
+	{
+		if ( m_region.empty() || !pImage )
+			return pImage;
+		return m_pipeline.cropImage( *pImage, m_region );
+	}
+
+	FramePipeline& m_pipeline;
+	boost::shared_ptr< Vision::Image > m_pSample;
+	bool m_bTransient;
+	bool m_bGPU;
+	bool m_bFuseGrey;
+	cv::Rect m_region;
+
+	bool m_bComputed[ STAGE_COUNT ];
+	boost::shared_ptr< Vision::Image > m_images[ STAGE_COUNT ];
+};
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::pyramidFromGrey( Vision::Image& greyImage )
+{
+	FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_PYRAMID );
+
+	Vision::Image::ImageFormatProperties fmt;
+	greyImage.getFormatProperties( fmt );
+	cv::Size size = pyramidImageSize( cv::Size( greyImage.width(), greyImage.height() ), m_pyramidLevels );
+
+	boost::shared_ptr< Vision::Image > pPyramid;
+	if ( greyImage.getImageState() == Image::ImageUploadState::OnCPUGPU || greyImage.getImageState() == Image::ImageUploadState::OnGPU )
+	{
+		pPyramid = m_imagePool->getGPUImage( size.width, size.height, fmt );
+		buildPyramid( greyImage.uMat(), pPyramid->uMat(), m_pyramidLevels );
+	}
+	else
+	{
+		pPyramid = m_imagePool->getImage( size.width, size.height, fmt );
+		buildPyramid( greyImage.Mat(), pPyramid->Mat(), m_pyramidLevels );
+	}
+	return pPyramid;
+}
+
+
+bool FramePipeline::needsGrey( const Sink& sink ) const
+{
+	return sink.isConnected( OUTPUT_GREY ) || sink.isConnected( OUTPUT_PYRAMID );
+}
+
+
+void FramePipeline::sendGrey( boost::shared_ptr< Vision::Image > pGreyImage, Sink& sink )
+{
+	if ( sink.isConnected( OUTPUT_GREY ) )
+	{
+		FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_SEND );
+		sink.send( OUTPUT_GREY, pGreyImage );
+	}
+
+	if ( sink.isConnected( OUTPUT_PYRAMID ) )
+	{
+		boost::shared_ptr< Vision::Image > pPyramid = pyramidFromGrey( *pGreyImage );
+		FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_SEND );
+		sink.send( OUTPUT_PYRAMID, pPyramid );
+	}
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::cropImage( Vision::Image& image, const cv::Rect& region )
+{
+	cv::Rect clipped = region & cv::Rect( 0, 0, image.width(), image.height() );
+	if ( clipped.empty() )
+		return boost::shared_ptr< Vision::Image >();
+
+	Vision::Image::ImageFormatProperties fmt;
+	image.getFormatProperties( fmt );
+
+	boost::shared_ptr< Vision::Image > pCrop;
+	if ( image.getImageState() == Image::ImageUploadState::OnCPUGPU || image.getImageState() == Image::ImageUploadState::OnGPU )
+	{
+		pCrop = m_imagePool->getGPUImage( clipped.width, clipped.height, fmt );
+		image.uMat()( clipped ).copyTo( pCrop->uMat() );
+	}
+	else
+	{
+		pCrop = m_imagePool->getImage( clipped.width, clipped.height, fmt );
+		image.Mat()( clipped ).copyTo( pCrop->Mat() );
+	}
+	return pCrop;
+}
+
+
+boost::shared_ptr< Vision::Image > FramePipeline::regionFromSample( Vision::Image& sampleImage, bool bGrey, const cv::Rect& targetRegion, 
+	const cv::Rect& sourceRegion, const cv::Rect& scaledRegion, boost::shared_ptr< UndistortionMap > pMap )
+{
+	Vision::Image::ImageFormatProperties fmt;
+	fmt.imageFormat = bGrey ? Vision::Image::LUMINANCE : Vision::Image::BGR;
+	fmt.channels = bGrey ? 1 : 3;
+	fmt.depth = CV_8U;
+	fmt.bitsPerPixel = bGrey ? 8 : 24;
+	fmt.origin = m_sampleFormat == SAMPLE_RGB24 ? sampleImage.origin() : 0;
+	bool bFlip = fmt.origin != 0;
+
+	// only the source region is converted, but into a buffer of the full sample size, so that the
+	// coordinates of the remap tables stay valid
+	cv::Mat source;
+	boost::shared_ptr< Vision::Image > pSource;
+	{
+		FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_CONVERT );
+		cv::Mat lumaPlane = bGrey ? sampleLumaPlane( m_sampleFormat, sampleImage.Mat(), m_sampleWidth, m_sampleHeight ) : cv::Mat();
+		if ( !bGrey && m_sampleFormat == SAMPLE_RGB24 )
+			source = sampleImage.Mat();
+		else if ( !lumaPlane.empty() )
+			source = lumaPlane;
+		else
+		{
+			pSource = m_imagePool->getImage( m_sampleWidth, m_sampleHeight, fmt );
+			cv::Mat target( pSource->Mat() );
+			bool bOk = bGrey ? 
+				convertSampleRegionToGrey( m_sampleFormat, sampleImage.Mat(), m_sampleWidth, m_sampleHeight, sourceRegion, target( sourceRegion ) ) :
+				convertSampleRegionToBGR( m_sampleFormat, sampleImage.Mat(), m_sampleWidth, m_sampleHeight, sourceRegion, target( sourceRegion ) );
+
+			// compressed samples can only be decoded as a whole
+			if ( !bOk )
+				bOk = bGrey ? convertSampleToGrey( m_sampleFormat, sampleImage.Mat(), target ) : 
+					convertSampleToBGR( m_sampleFormat, sampleImage.Mat(), target );
+			if ( !bOk )
+			{
+				LOG4CPP_WARN( logger, "Unable to convert " << sampleFormatName( m_sampleFormat ) << " sample" );
+				return boost::shared_ptr< Vision::Image >();
+			}
+			source = target;
+		}
+	}
+
+	// the remap tables flip bottom-up samples, the resize (only used for binning then) and the copy are flipped here
+	fmt.origin = 0;
+	boost::shared_ptr< Vision::Image > pResult( m_imagePool->getImage( targetRegion.width, targetRegion.height, fmt ) );
+	cv::Mat result( pResult->Mat() );
+	if ( pMap )
+	{
+		FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_UNDISTORT );
+		pMap->remap( source, result, targetRegion );
+	}
+	else if ( scaledRegion.size() != targetRegion.size() )
+	{
+		FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_RESIZE );
+		cv::resize( source( scaledRegion ), result, targetRegion.size(), 0, 0, m_binning > 1 ? cv::INTER_AREA : cv::INTER_LINEAR );
+		if ( bFlip )
+			cv::flip( result, result, 0 );
+	}
+	else if ( bFlip )
+		cv::flip( source( scaledRegion ), result, 0 );
+	else
+		source( scaledRegion ).copyTo( result );
+	return pResult;
+}
+
+
+void FramePipeline::processRegion( boost::shared_ptr< Vision::Image > pSampleImage, bool bTransient, const cv::Rect& region, Sink& sink )
+{
+	// the RAW output always is the whole frame
+	if ( sink.isConnected( OUTPUT_RAW ) )
+	{
+		boost::shared_ptr< Vision::Image > pRawImage;
+		if ( m_sampleFormat != SAMPLE_RGB24 )
+			pRawImage = decodeSample( *pSampleImage );
+		else if ( pSampleImage->origin() != 0 )
+			pRawImage = flipImage( *pSampleImage );
+		else
+			pRawImage = bTransient ? m_imagePool->clone( *pSampleImage ) : pSampleImage;
+
+		if ( pRawImage )
+		{
+			FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_SEND );
+			sink.send( OUTPUT_RAW, pRawImage );
+		}
+	}
+
+	if ( !sink.isConnected( OUTPUT_COLOR ) && !needsGrey( sink ) )
+		return;
+
+	cv::Size sourceSize( m_sampleWidth, m_sampleHeight );
+	cv::Size targetSize = outputSize( sourceSize );
+	cv::Rect targetRegion = region & cv::Rect( cv::Point( 0, 0 ), targetSize );
+	if ( targetRegion.empty() )
+	{
+		LOG4CPP_DEBUG( logger, "Region of interest is outside of the image" );
+		return;
+	}
+
+	// the part of the sample the region is computed from, the region is top-down but the sample may be bottom-up
+	bool bottomUp = m_sampleFormat == SAMPLE_RGB24 && pSampleImage->origin() != 0;
+	boost::shared_ptr< UndistortionMap > pMap = m_undistortionMaps.get( sourceSize, targetSize, bottomUp, 
+		bottomUp && sourceSize != targetSize && m_binning == 1 );
+	double sx = double( sourceSize.width ) / targetSize.width;
+	double sy = double( sourceSize.height ) / targetSize.height;
+	cv::Rect scaledRegion = cv::Rect( cv::Point( cvRound( targetRegion.x * sx ), cvRound( targetRegion.y * sy ) ), 
+		cv::Point( cvRound( targetRegion.br().x * sx ), cvRound( targetRegion.br().y * sy ) ) ) & cv::Rect( cv::Point( 0, 0 ), sourceSize );
+	if ( bottomUp )
+		scaledRegion.y = m_sampleHeight - scaledRegion.br().y;
+	cv::Rect sourceRegion = alignSampleRegion( m_sampleFormat, pMap ? pMap->sourceRegion( targetRegion ) : scaledRegion, 
+		m_sampleWidth, m_sampleHeight );
+	if ( sourceRegion.empty() || scaledRegion.empty() )
+		return;
+
+	boost::shared_ptr< Vision::Image > pColorImage;
+	if ( sink.isConnected( OUTPUT_COLOR ) )
+	{
+		pColorImage = regionFromSample( *pSampleImage, false, targetRegion, sourceRegion, scaledRegion, pMap );
+		if ( !pColorImage )
+			return;
+
+		FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_SEND );
+		sink.send( OUTPUT_COLOR, pColorImage );
+	}
+
+	if ( needsGrey( sink ) )
+	{
+		boost::shared_ptr< Vision::Image > pGreyImage;
+		if ( pColorImage )
+			pGreyImage = greyFromColor( *pColorImage );
+		else
+			pGreyImage = regionFromSample( *pSampleImage, true, targetRegion, sourceRegion, scaledRegion, pMap );
+		if ( !pGreyImage )
+			return;
+
+		sendGrey( pGreyImage, sink );
+	}
+}
+
+
+void FramePipeline::process( boost::shared_ptr< Vision::Image > pBufferImage, bool bTransient, Sink& sink )
+{
+	cv::Rect region = regionOfInterest();
+
+	// uncompressed samples are uploaded once and processed entirely with OpenCL
+	bool bGPU = m_autoGPUUpload && sampleConvertibleOnGPU( m_sampleFormat ) && Vision::OpenCLManager::singleton().isInitialized();
+	if ( !bGPU && !region.empty() )
+	{
+		processRegion( pBufferImage, bTransient, region, sink );
+		return;
+	}
+
+	// each output is handed out as soon as it is ready, the later ones reuse its intermediate images
+	bool bFuseGrey = !bGPU && banded() && sink.isConnected( OUTPUT_COLOR ) && needsGrey( sink );
+	FrameStages stages( *this, pBufferImage, bTransient, bGPU, bFuseGrey, region );
+	for ( int i = 0; i < OUTPUT_COUNT; i++ )
+	{
+		Output output = Output( i );
+		if ( !sink.isConnected( output ) )
+			continue;
+
+		boost::shared_ptr< Vision::Image > pImage = stages.output( output );
+		if ( !pImage )
+			continue;
+
+		FrameStatistics::ScopedTimer timer( m_statistics, FrameStatistics::STAGE_SEND );
+		sink.send( output, pImage );
+	}
+}
+
+} } // namespace Ubitrack::Drivers
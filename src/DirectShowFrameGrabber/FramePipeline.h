@@ -0,0 +1,216 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Per-frame image processing of the DirectShow frame grabber
+ */
+
+#ifndef __UBITRACK_DRIVERS_FRAMEPIPELINE_H_INCLUDED__
+#define __UBITRACK_DRIVERS_FRAMEPIPELINE_H_INCLUDED__
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <utVision/Image.h>
+
+#include "SampleConversion.h"
+#include "ImagePool.h"
+#include "UndistortionMap.h"
+#include "FrameStatistics.h"
+#include "BandPool.h"
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Turns a captured sample into the RAW, color and greyscale output images.
+ *
+ * Only the outputs the sink reports as connected are computed, each output is handed to the
+ * sink as soon as it is ready. Intermediate images (upload, conversion, resize and undistortion)
+ * are computed at most once per frame and shared by all outputs that need them.
+ *
+ * All outputs are top-down, bottom-up RGB24 samples are flipped within the pass that resizes,
+ * undistorts or copies them anyway. The pipeline does not depend on DirectShow, so it can also be
+ * driven with recorded or synthetic samples.
+ */
+class FramePipeline
+	: private boost::noncopyable
+{
+public:
+
+	/** the pyramid output holds the levels of the greyscale output in one image, see ImagePyramid.h */
+	enum Output { OUTPUT_RAW, OUTPUT_COLOR, OUTPUT_GREY, OUTPUT_PYRAMID, OUTPUT_COUNT };
+
+	/** receiver of the output images */
+	class Sink
+	{
+	public:
+		virtual ~Sink()
+		{}
+
+		virtual bool isConnected( Output output ) const = 0;
+
+		virtual void send( Output output, boost::shared_ptr< Vision::Image > pImage ) = 0;
+	};
+
+	FramePipeline( boost::shared_ptr< ImagePool > pImagePool, UndistortionMapCache& undistortionMaps, FrameStatistics& statistics );
+
+	/** format and frame size of the samples */
+	void setSampleFormat( SampleFormat format, int width, int height );
+
+	/** outputs larger than this are downscaled, 0 keeps the sample size */
+	void setDesiredSize( int width, int height );
+
+	/** number of levels of the pyramid output, including the greyscale image itself */
+	void setPyramidLevels( int levels );
+
+	/** average \c factor x \c factor pixel blocks of the sample into one output pixel, overrides the desired size. 1 disables binning */
+	void setBinning( int factor );
+
+	/**
+	 * restricts the color and greyscale outputs to a region of the (resized or binned) output image,
+	 * in pixels of the image buffer. Only the sample pixels needed for the region are converted and
+	 * undistorted. An empty rectangle selects the whole image. Can be called while frames are processed.
+	 */
+	void setRegionOfInterest( const cv::Rect& region );
+
+	/** current region of interest, empty for the whole image */
+	cv::Rect regionOfInterest() const;
+
+	/**
+	 * process frames on the GPU if OpenCL is available. Uncompressed samples are uploaded once and converted,
+	 * resized and undistorted there, MJPG samples are decoded on the CPU and uploaded as color image.
+	 */
+	void setGPUUpload( bool bUpload );
+
+	/**
+	 * splits the CPU conversions and the undistortion of full frames into \c bands bands of rows, processed
+	 * by the threads of \c pPool. If the greyscale image is computed from the undistorted color image, each
+	 * band is converted right after it has been undistorted. Less than 2 bands process whole frames.
+	 */
+	void setBandPool( boost::shared_ptr< BandPool > pPool, int bands );
+
+	/**
+	 * processes a sample wrapped as returned by \c sampleImageFormat.
+	 * If \c bTransient is set, the image refers to a buffer that is only valid during this call.
+	 */
+	void process( boost::shared_ptr< Vision::Image > pBufferImage, bool bTransient, Sink& sink );
+
+protected:
+
+	/** runs \c function for the rows of an image, in bands if a band pool is set */
+	void forBands( int rows, int alignment, const BandPool::BandFunction& function );
+
+	/** true if frames are processed in bands */
+	bool banded() const
+	{ return m_pBandPool && m_bands > 1; }
+
+	/** uploads a sample into a pinned GPU buffer */
+	boost::shared_ptr< Vision::Image > uploadSample( Vision::Image& sampleImage );
+
+	/** intermediate images of one frame, computed on demand */
+	class FrameStages;
+
+	/** processes only the part of a sample needed for a region of the output image */
+	void processRegion( boost::shared_ptr< Vision::Image > pSampleImage, bool bTransient, const cv::Rect& region, Sink& sink );
+
+	/**
+	 * color or greyscale image of a region of the output from a sample.
+	 * Converts \c sourceRegion of the sample, then resizes or undistorts it into the region.
+	 * \c scaledRegion is the part of the sample buffer that is resized into the region, in
+	 * buffer rows, so it is upside down for bottom-up samples.
+	 */
+	boost::shared_ptr< Vision::Image > regionFromSample( Vision::Image& sampleImage, bool bGrey, const cv::Rect& targetRegion, 
+		const cv::Rect& sourceRegion, const cv::Rect& scaledRegion, boost::shared_ptr< UndistortionMap > pMap );
+
+	/** top-down copy of a bottom-up image, on the GPU if the image is there */
+	boost::shared_ptr< Vision::Image > flipImage( Vision::Image& image );
+
+	/** pyramid image of the greyscale output, on the GPU if the image is there */
+	boost::shared_ptr< Vision::Image > pyramidFromGrey( Vision::Image& greyImage );
+
+	/** true if the greyscale image has to be computed for the greyscale or pyramid output */
+	bool needsGrey( const Sink& sink ) const;
+
+	/** sends the greyscale image and its pyramid to the connected outputs */
+	void sendGrey( boost::shared_ptr< Vision::Image > pGreyImage, Sink& sink );
+
+	/** copy of a region of an image, on the GPU if the image is there */
+	boost::shared_ptr< Vision::Image > cropImage( Vision::Image& image, const cv::Rect& region );
+
+	/** size of the output image for a sample or image of the given size */
+	cv::Size outputSize( cv::Size size ) const;
+
+	/** converts a sample in a native capture format into a BGR image, returns an empty pointer on failure */
+	boost::shared_ptr< Vision::Image > decodeSample( Vision::Image& sampleImage );
+
+	/** converts a BGR image to greyscale, on the GPU if the image is already there */
+	boost::shared_ptr< Vision::Image > greyFromColor( Vision::Image& colorImage );
+
+	/** greyscale image computed directly from the luma of a native sample, returns an empty pointer on failure */
+	boost::shared_ptr< Vision::Image > greyFromSample( boost::shared_ptr< Vision::Image > pSampleImage, bool bTransient );
+
+	/** true if the output size differs from the image size */
+	bool needsResize( const Vision::Image& image ) const;
+
+	/** resizes an image to the output size, bottom-up images are flipped */
+	boost::shared_ptr< Vision::Image > resizeImage( Vision::Image& image );
+
+	/**
+	 * resizes, undistorts and flips bottom-up images in a single pass using cached remap tables.
+	 * Returns the input itself if there is nothing to do and it is not \c bTransient.
+	 * If \c pGrey is given and a color image is undistorted in bands on the CPU, the greyscale image of
+	 * the result is computed in the same pass and returned in \c pGrey, otherwise it is left empty.
+	 */
+	boost::shared_ptr< Vision::Image > undistortImage( boost::shared_ptr< Vision::Image > pImage, bool bTransient, 
+		boost::shared_ptr< Vision::Image >* pGrey = 0 );
+
+	SampleFormat m_sampleFormat;
+	int m_sampleWidth;
+	int m_sampleHeight;
+
+	int m_desiredWidth;
+	int m_desiredHeight;
+
+	bool m_autoGPUUpload;
+
+	int m_binning;
+
+	int m_pyramidLevels;
+
+	boost::shared_ptr< BandPool > m_pBandPool;
+	int m_bands;
+
+	/** region of interest, protected by m_regionMutex */
+	cv::Rect m_region;
+	mutable boost::mutex m_regionMutex;
+
+	boost::shared_ptr< ImagePool > m_imagePool;
+	UndistortionMapCache& m_undistortionMaps;
+	FrameStatistics& m_statistics;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Bounded frame queue between the DirectShow streaming thread and the processing workers
+ */
+
+#ifndef __UBITRACK_DRIVERS_FRAMEQUEUE_H_INCLUDED__
+#define __UBITRACK_DRIVERS_FRAMEQUEUE_H_INCLUDED__
+
+#include <cstddef>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Bounded multi-producer/multi-consumer ring buffer.
+ *
+ * Pushing and popping is lock-free (sequence numbered cells). The mutex and condition are only
+ * touched when a consumer has run out of work and has to sleep until the next frame arrives.
+ *
+ * The queue holds exactly \c capacity items. The ring of cells is rounded up to a power of two
+ * internally, the capacity is enforced separately when enqueueing.
+ *
+ * If the queue is full, \c push either discards the new item (DropNewest) or evicts the oldest
+ * queued items until the new one fits (DropOldest).
+ */
+template< class T >
+class FrameQueue
+	: private boost::noncopyable
+{
+public:
+
+	enum DropPolicy { DropOldest, DropNewest };
+
+	/** constructor, at most \c capacity items (at least 1) are queued */
+	FrameQueue( std::size_t capacity, DropPolicy policy )
+		: m_policy( policy )
+		, m_capacity( capacity > 0 ? capacity : 1 )
+		, m_enqueuePos( 0 )
+		, m_dequeuePos( 0 )
+		, m_waiters( 0 )
+		, m_dropped( 0 )
+		, m_shutdown( false )
+	{
+		// the sequence numbers need at least two cells
+		std::size_t cells = 2;
+		while ( cells < m_capacity )
+			cells <<= 1;
+		m_mask = cells - 1;
+
+		m_cells.reset( new Cell[ cells ] );
+		for ( std::size_t i = 0; i < cells; i++ )
+			m_cells[ i ].sequence.store( i, boost::memory_order_relaxed );
+	}
+
+	/**
+	 * adds an item, never blocks.
+	 * @return false if an item had to be dropped because the queue was full
+	 */
+	bool push( const T& item )
+	{
+		bool bNoDrop = true;
+		if ( !tryEnqueue( item ) )
+		{
+			bNoDrop = false;
+			if ( m_policy == DropNewest )
+			{
+				m_dropped++;
+				return false;
+			}
+
+			T oldest;
+			do
+			{
+				if ( tryDequeue( oldest ) )
+					m_dropped++;
+			}
+			while ( !tryEnqueue( item ) );
+		}
+
+		if ( m_waiters.load() > 0 )
+		{
+			{ boost::mutex::scoped_lock l( m_mutex ); }
+			m_cond.notify_one();
+		}
+		return bNoDrop;
+	}
+
+	/**
+	 * removes the oldest item, blocks while the queue is empty.
+	 * @return false if the queue has been shut down
+	 */
+	bool pop( T& item )
+	{
+		if ( tryDequeue( item ) )
+			return true;
+
+		boost::mutex::scoped_lock l( m_mutex );
+		m_waiters++;
+		while ( !m_shutdown && !tryDequeue( item ) )
+			m_cond.wait( l );
+		m_waiters--;
+
+		return !m_shutdown;
+	}
+
+	/** wakes up all waiting consumers and makes \c pop fail from now on */
+	void shutdown()
+	{
+		{
+			boost::mutex::scoped_lock l( m_mutex );
+			m_shutdown = true;
+		}
+		m_cond.notify_all();
+	}
+
+	/**
+	 * removes all queued items and allows \c pop again.
+	 * @return the number of removed items
+	 */
+	std::size_t reset()
+	{
+		std::size_t removed = 0;
+		T item;
+		while ( tryDequeue( item ) )
+			removed++;
+
+		boost::mutex::scoped_lock l( m_mutex );
+		m_shutdown = false;
+		return removed;
+	}
+
+	/** number of items dropped due to overflow since construction */
+	unsigned long droppedCount() const
+	{ return m_dropped.load(); }
+
+	std::size_t capacity() const
+	{ return m_capacity; }
+
+protected:
+
+	bool tryEnqueue( const T& item )
+	{
+		std::size_t pos = m_enqueuePos.load( boost::memory_order_relaxed );
+		Cell* pCell;
+		for ( ; ; )
+		{
+			pCell = &m_cells[ pos & m_mask ];
+			std::size_t seq = pCell->sequence.load( boost::memory_order_acquire );
+			std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+			if ( diff == 0 )
+			{
+				// the dequeue position only grows, so a stale value can only overestimate the number of items
+				if ( pos - m_dequeuePos.load( boost::memory_order_acquire ) >= m_capacity )
+					return false;
+				if ( m_enqueuePos.compare_exchange_weak( pos, pos + 1, boost::memory_order_relaxed ) )
+					break;
+			}
+			else if ( diff < 0 )
+				return false;
+			else
+				pos = m_enqueuePos.load( boost::memory_order_relaxed );
+		}
+
+		pCell->data = item;
+		pCell->sequence.store( pos + 1, boost::memory_order_seq_cst );
+		return true;
+	}
+
+	bool tryDequeue( T& item )
+	{
+		std::size_t pos = m_dequeuePos.load( boost::memory_order_relaxed );
+		Cell* pCell;
+		for ( ; ; )
+		{
+			pCell = &m_cells[ pos & m_mask ];
+			std::size_t seq = pCell->sequence.load( boost::memory_order_seq_cst );
+			std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)( pos + 1 );
+			if ( diff == 0 )
+			{
+				if ( m_dequeuePos.compare_exchange_weak( pos, pos + 1, boost::memory_order_relaxed ) )
+					break;
+			}
+			else if ( diff < 0 )
+				return false;
+			else
+				pos = m_dequeuePos.load( boost::memory_order_relaxed );
+		}
+
+		item = pCell->data;
+		// release the payload (e.g. image memory) right away instead of when the cell is reused
+		pCell->data = T();
+		pCell->sequence.store( pos + m_mask + 1, boost::memory_order_release );
+		return true;
+	}
+
+	struct Cell
+	{
+		boost::atomic< std::size_t > sequence;
+		T data;
+	};
+
+	DropPolicy m_policy;
+
+	/** maximum number of queued items */
+	std::size_t m_capacity;
+
+	/** number of cells - 1 */
+	std::size_t m_mask;
+	boost::scoped_array< Cell > m_cells;
+
+	boost::atomic< std::size_t > m_enqueuePos;
+	boost::atomic< std::size_t > m_dequeuePos;
+
+	/** number of consumers sleeping in \c pop */
+	boost::atomic< int > m_waiters;
+
+	/** number of dropped items */
+	boost::atomic< unsigned long > m_dropped;
+
+	bool m_shutdown;
+	boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
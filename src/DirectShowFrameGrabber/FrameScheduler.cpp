@@ -0,0 +1,143 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Adaptive admission of captured frames by output rate and latency budget
+ */
+
+#include "FrameScheduler.h"
+
+namespace Ubitrack { namespace Drivers {
+
+/** weight of a new sample in the running average of the processing time */
+static const double PROCESSING_TIME_WEIGHT = 0.1;
+
+
+FrameScheduler::FrameScheduler()
+	: m_interval( 0 )
+	, m_budget( 0 )
+	, m_nextDue( 0 )
+	, m_lastAdmitted( 0 )
+	, m_processingTime( 0 )
+	, m_inFlight( 0 )
+	, m_workers( 1 )
+{
+}
+
+
+void FrameScheduler::setTargetRate( double fps )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_interval = fps > 0 ? Measurement::Timestamp( 1e9 / fps ) : 0;
+}
+
+
+void FrameScheduler::setLatencyBudget( double ms )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_budget = ms > 0 ? Measurement::Timestamp( ms * 1e6 ) : 0;
+}
+
+
+void FrameScheduler::setWorkers( int workers )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_workers = workers > 1 ? workers : 1;
+}
+
+
+bool FrameScheduler::admit( Measurement::Timestamp sampleTime, Measurement::Timestamp now )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+
+	// pacing by sample time, with half a frame of jitter tolerance
+	if ( m_interval > 0 && m_nextDue > 0 && sampleTime + m_interval / 2 < m_nextDue )
+		return false;
+
+	if ( m_budget > 0 )
+	{
+		Measurement::Timestamp processing = Measurement::Timestamp( m_processingTime );
+		Measurement::Timestamp age = now > sampleTime ? now - sampleTime : 0;
+		bool bStarving = m_inFlight == 0 && now - m_lastAdmitted > m_budget;
+
+		// with all workers busy, the frame would wait behind the ones in flight, which finish in rounds of m_workers
+		int rounds = ( m_inFlight + m_workers ) / m_workers;
+		if ( m_inFlight >= m_workers && rounds * processing > m_budget )
+			return false;
+
+		// the frame is already too old to be finished in time
+		if ( !bStarving && age + processing > m_budget )
+			return false;
+	}
+
+	if ( m_interval > 0 )
+		m_nextDue = ( m_nextDue > 0 && sampleTime < m_nextDue + m_interval ? m_nextDue : sampleTime ) + m_interval;
+	m_lastAdmitted = now;
+	m_inFlight++;
+	return true;
+}
+
+
+void FrameScheduler::finished( Measurement::Timestamp duration )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( m_inFlight > 0 )
+		m_inFlight--;
+	m_processingTime = m_processingTime > 0 ? 
+		( 1.0 - PROCESSING_TIME_WEIGHT ) * m_processingTime + PROCESSING_TIME_WEIGHT * duration : double( duration );
+}
+
+
+void FrameScheduler::discarded( unsigned long n )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_inFlight = m_inFlight > int( n ) ? m_inFlight - int( n ) : 0;
+}
+
+
+void FrameScheduler::reset()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_inFlight = 0;
+	m_nextDue = 0;
+	m_lastAdmitted = 0;
+}
+
+
+void FrameScheduler::resetPacing()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_nextDue = 0;
+	m_lastAdmitted = 0;
+}
+
+
+Measurement::Timestamp FrameScheduler::processingTime() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	return Measurement::Timestamp( m_processingTime );
+}
+
+} } // namespace Ubitrack::Drivers
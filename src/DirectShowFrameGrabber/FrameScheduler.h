@@ -0,0 +1,108 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Adaptive admission of captured frames by output rate and latency budget
+ */
+
+#ifndef __UBITRACK_DRIVERS_FRAMESCHEDULER_H_INCLUDED__
+#define __UBITRACK_DRIVERS_FRAMESCHEDULER_H_INCLUDED__
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <utMeasurement/Timestamp.h>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Decides for every captured frame whether it is processed or skipped.
+ *
+ * With a target rate, frames are admitted by their sample time so that the output is paced at
+ * that rate. With a latency budget, the scheduler keeps a running average of the processing time
+ * and skips frames that could not be finished within the budget, either because older frames are
+ * still being processed (by all workers) or because the frame itself has already aged too much. The skip ratio thus
+ * follows the downstream load, and while the consumers are busy the newest frame wins over stale
+ * ones. To degrade gracefully when even a single frame exceeds the budget, a frame is always
+ * admitted if nothing was admitted during the last budget period and nothing is in flight.
+ *
+ * All methods are thread-safe.
+ */
+class FrameScheduler
+	: private boost::noncopyable
+{
+public:
+
+	FrameScheduler();
+
+	/** output rate in frames per second, 0 disables pacing */
+	void setTargetRate( double fps );
+
+	/** maximum time from sample to end of processing in ms, 0 disables the budget */
+	void setLatencyBudget( double ms );
+
+	/** number of frames processed in parallel, e.g. by asynchronous processing threads */
+	void setWorkers( int workers );
+
+	bool enabled() const
+	{ return m_interval > 0 || m_budget > 0; }
+
+	/**
+	 * decides about a frame captured at \c sampleTime that arrived at \c now.
+	 * Every admitted frame must be followed by exactly one call to \c finished or \c discarded.
+	 */
+	bool admit( Measurement::Timestamp sampleTime, Measurement::Timestamp now );
+
+	/** an admitted frame has been processed, \c duration in nanoseconds */
+	void finished( Measurement::Timestamp duration );
+
+	/** \c n admitted frames were dropped before being processed */
+	void discarded( unsigned long n = 1 );
+
+	/** forgets frames in flight and the pacing state, e.g. when capturing restarts */
+	void reset();
+
+	/** forgets only the pacing state, e.g. when the capture mode and thus the sample times change */
+	void resetPacing();
+
+	/** running average of the processing time in nanoseconds */
+	Measurement::Timestamp processingTime() const;
+
+protected:
+
+	Measurement::Timestamp m_interval;
+	Measurement::Timestamp m_budget;
+
+	Measurement::Timestamp m_nextDue;
+	Measurement::Timestamp m_lastAdmitted;
+	double m_processingTime;
+	int m_inFlight;
+	int m_workers;
+
+	mutable boost::mutex m_mutex;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Per-stage timing histograms and frame drop counters of the frame grabber
+ */
+
+#include "FrameStatistics.h"
+
+#include <sstream>
+#include <iomanip>
+
+namespace Ubitrack { namespace Drivers {
+
+static const char* const stageNames[ FrameStatistics::STAGE_COUNT ] =
+	{ "delivery", "resize", "undistort", "convert", "upload", "send", "pyramid", "reconnect" };
+
+static const char* const counterNames[ FrameStatistics::COUNTER_COUNT ] =
+	{ "received", "divisor", "double", "invalid size", "queue overflow", "unmatched", "scheduler", "device lost", "static" };
+
+
+FrameStatistics::FrameStatistics( int interval )
+	: m_interval( interval )
+	, m_nextReport( 0 )
+{
+	for ( int s = 0; s < STAGE_COUNT; s++ )
+	{
+		for ( int b = 0; b < BUCKETS; b++ )
+			m_stages[ s ].buckets[ b ] = 0;
+		m_stages[ s ].total = 0;
+		m_stages[ s ].maximum = 0;
+	}
+	for ( int c = 0; c < COUNTER_COUNT; c++ )
+		m_counters[ c ] = 0;
+}
+
+
+void FrameStatistics::setInterval( int interval )
+{
+	m_interval = interval;
+	m_nextReport = 0;
+}
+
+
+void FrameStatistics::record( Stage stage, Measurement::Timestamp duration )
+{
+	Histogram& h = m_stages[ stage ];
+
+	// bucket b holds durations below 2^b microseconds
+	Measurement::Timestamp us = duration / 1000;
+	int b = 0;
+	while ( b < BUCKETS - 1 && ( Measurement::Timestamp( 1 ) << b ) <= us )
+		b++;
+	h.buckets[ b ]++;
+	h.total += duration;
+
+	unsigned long long m = h.maximum.load( boost::memory_order_relaxed );
+	while ( duration > m && !h.maximum.compare_exchange_weak( m, duration, boost::memory_order_relaxed ) )
+		;
+}
+
+
+bool FrameStatistics::reportDue( Measurement::Timestamp t )
+{
+	if ( m_interval <= 0 )
+		return false;
+
+	Measurement::Timestamp next = m_nextReport.load();
+	Measurement::Timestamp interval = Measurement::Timestamp( m_interval ) * 1000000000ULL;
+	if ( next == 0 )
+	{
+		// first call starts the window
+		m_nextReport.compare_exchange_strong( next, t + interval );
+		return false;
+	}
+	return t >= next && m_nextReport.compare_exchange_strong( next, t + interval );
+}
+
+
+std::string FrameStatistics::summary()
+{
+	std::ostringstream os;
+	os << std::fixed << std::setprecision( 2 );
+
+	for ( int c = 0; c < COUNTER_COUNT; c++ )
+		os << ( c ? ", " : "" ) << counterNames[ c ] << "=" << m_counters[ c ].exchange( 0 );
+
+	for ( int s = 0; s < STAGE_COUNT; s++ )
+	{
+		Histogram& h = m_stages[ s ];
+		unsigned long buckets[ BUCKETS ];
+		unsigned long n = 0;
+		for ( int b = 0; b < BUCKETS; b++ )
+			n += ( buckets[ b ] = h.buckets[ b ].exchange( 0 ) );
+		unsigned long long total = h.total.exchange( 0 );
+		unsigned long long maximum = h.maximum.exchange( 0 );
+		if ( n == 0 )
+			continue;
+
+		// upper bucket bounds of the percentiles
+		double p50 = 0, p99 = 0;
+		unsigned long sum = 0;
+		for ( int b = 0; b < BUCKETS; b++ )
+		{
+			sum += buckets[ b ];
+			if ( !p50 && sum * 2 >= n )
+				p50 = ( 1 << b ) / 1000.0;
+			if ( !p99 && sum * 100 >= n * 99 )
+				p99 = ( 1 << b ) / 1000.0;
+		}
+
+		os << "; " << stageNames[ s ] << ": n=" << n << " mean=" << total / 1e6 / n << "ms p50<" << p50 << 
+			"ms p99<" << p99 << "ms max=" << maximum / 1e6 << "ms";
+	}
+	return os.str();
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,147 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Per-stage timing histograms and frame drop counters of the frame grabber
+ */
+
+#ifndef __UBITRACK_DRIVERS_FRAMESTATISTICS_H_INCLUDED__
+#define __UBITRACK_DRIVERS_FRAMESTATISTICS_H_INCLUDED__
+
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <utMeasurement/Timestamp.h>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Rolling statistics of the capture pipeline.
+ *
+ * Every stage has a histogram with power-of-two microsecond buckets, counters are plain event
+ * counts. Both are atomic, so all capture and processing threads can record without locking.
+ * \c summary returns the values since the previous summary and starts a new window.
+ */
+class FrameStatistics
+	: private boost::noncopyable
+{
+public:
+
+	enum Stage
+	{
+		STAGE_DELIVERY,  ///< sample time to SampleCB
+		STAGE_RESIZE,
+		STAGE_UNDISTORT,
+		STAGE_CONVERT,   ///< colour conversion and decoding
+		STAGE_UPLOAD,    ///< GPU upload
+		STAGE_SEND,
+		STAGE_PYRAMID,
+		STAGE_RECONNECT, ///< device loss to the first frame of the rebuilt graph
+		STAGE_COUNT
+	};
+
+	enum Counter
+	{
+		COUNTER_RECEIVED,
+		COUNTER_DIVISOR,
+		COUNTER_DOUBLE_FRAME,
+		COUNTER_INVALID_SIZE,
+		COUNTER_QUEUE_OVERFLOW,
+		COUNTER_UNMATCHED,      ///< frames without partners from the other cameras of a frame set
+		COUNTER_SCHEDULER,      ///< frames skipped by the rate and latency scheduler
+		COUNTER_DEVICE_LOST,
+		COUNTER_STATIC,         ///< frames skipped by the motion gate because the scene did not change
+		COUNTER_COUNT
+	};
+
+	/** measures the lifetime of the object as one sample of a stage, if statistics are enabled */
+	class ScopedTimer
+		: private boost::noncopyable
+	{
+	public:
+		ScopedTimer( FrameStatistics& statistics, Stage stage )
+			: m_statistics( statistics )
+			, m_stage( stage )
+			, m_start( statistics.enabled() ? Measurement::now() : 0 )
+		{}
+
+		~ScopedTimer()
+		{
+			if ( m_start )
+				m_statistics.record( m_stage, Measurement::now() - m_start );
+		}
+
+	protected:
+		FrameStatistics& m_statistics;
+		Stage m_stage;
+		Measurement::Timestamp m_start;
+	};
+
+	/** @param interval seconds between summaries, 0 disables the statistics */
+	FrameStatistics( int interval = 0 );
+
+	/** enables the statistics with a new summary interval */
+	void setInterval( int interval );
+
+	bool enabled() const
+	{ return m_interval > 0; }
+
+	/** adds a duration in nanoseconds to a stage */
+	void record( Stage stage, Measurement::Timestamp duration );
+
+	/** increments an event counter */
+	void count( Counter counter, unsigned long n = 1 )
+	{ m_counters[ counter ] += n; }
+
+	/**
+	 * true exactly once per interval, for the thread that should print the summary.
+	 */
+	bool reportDue( Measurement::Timestamp t );
+
+	/** human readable summary of the current window, resets all values */
+	std::string summary();
+
+protected:
+
+	static const int BUCKETS = 24;
+
+	struct Histogram
+	{
+		boost::atomic< unsigned long > buckets[ BUCKETS ];
+		boost::atomic< unsigned long long > total;
+		boost::atomic< unsigned long long > maximum;
+	};
+
+	Histogram m_stages[ STAGE_COUNT ];
+	boost::atomic< unsigned long > m_counters[ COUNTER_COUNT ];
+
+	int m_interval;
+	boost::atomic< Measurement::Timestamp > m_nextReport;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
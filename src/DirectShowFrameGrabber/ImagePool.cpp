@@ -0,0 +1,197 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Recycling pool for the image buffers pushed by the frame grabber
+ */
+
+#include "ImagePool.h"
+
+#include <boost/weak_ptr.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+/** deleter of pooled CPU images, hands the buffer back to the pool */
+class PooledImageDeleter
+{
+public:
+	PooledImageDeleter( boost::weak_ptr< ImagePool > pPool, const ImagePool::Key& key, const cv::Mat& buffer )
+		: m_pPool( pPool )
+		, m_key( key )
+		, m_buffer( buffer )
+	{}
+
+	void operator()( Vision::Image* pImage )
+	{
+		delete pImage;
+		if ( boost::shared_ptr< ImagePool > pPool = m_pPool.lock() )
+			pPool->recycle( m_key, m_buffer );
+		m_buffer.release();
+	}
+
+protected:
+	boost::weak_ptr< ImagePool > m_pPool;
+	ImagePool::Key m_key;
+	cv::Mat m_buffer;
+};
+
+
+/** deleter of pooled GPU images, hands the buffer back to the pool */
+class PooledGPUImageDeleter
+{
+public:
+	PooledGPUImageDeleter( boost::weak_ptr< ImagePool > pPool, const ImagePool::Key& key, const cv::UMat& buffer )
+		: m_pPool( pPool )
+		, m_key( key )
+		, m_buffer( buffer )
+	{}
+
+	void operator()( Vision::Image* pImage )
+	{
+		delete pImage;
+		if ( boost::shared_ptr< ImagePool > pPool = m_pPool.lock() )
+			pPool->recycle( m_key, m_buffer );
+		m_buffer.release();
+	}
+
+protected:
+	boost::weak_ptr< ImagePool > m_pPool;
+	ImagePool::Key m_key;
+	cv::UMat m_buffer;
+};
+
+
+ImagePool::ImagePool( std::size_t highWaterMark )
+	: m_highWaterMark( highWaterMark )
+	, m_allocations( 0 )
+	, m_reuses( 0 )
+{
+}
+
+
+boost::shared_ptr< Vision::Image > ImagePool::getImage( int width, int height, const Vision::Image::ImageFormatProperties& fmt )
+{
+	Key key( width, height, CV_MAKETYPE( fmt.depth, fmt.channels ), cv::USAGE_DEFAULT );
+	cv::Mat buffer;
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		std::vector< cv::Mat >& freeList = m_freeBuffers[ key ];
+		if ( freeList.empty() )
+			m_allocations++;
+		else
+		{
+			buffer = freeList.back();
+			freeList.pop_back();
+			m_reuses++;
+		}
+	}
+
+	if ( buffer.empty() )
+		buffer.create( height, width, key.get< 2 >() );
+
+	// the image only wraps the buffer, which is owned by the deleter
+	return boost::shared_ptr< Vision::Image >( new Vision::Image( width, height, fmt, buffer.data ),
+		PooledImageDeleter( shared_from_this(), key, buffer ) );
+}
+
+
+boost::shared_ptr< Vision::Image > ImagePool::getGPUImage( int width, int height, const Vision::Image::ImageFormatProperties& fmt, 
+	cv::UMatUsageFlags usage )
+{
+	Key key( width, height, CV_MAKETYPE( fmt.depth, fmt.channels ), usage );
+	cv::UMat buffer;
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		std::vector< cv::UMat >& freeList = m_freeGPUBuffers[ key ];
+		if ( freeList.empty() )
+			m_allocations++;
+		else
+		{
+			buffer = freeList.back();
+			freeList.pop_back();
+			m_reuses++;
+		}
+	}
+
+	if ( buffer.empty() )
+		buffer.create( height, width, key.get< 2 >(), usage );
+
+	boost::shared_ptr< Vision::Image > pImage( new Vision::Image( buffer ), PooledGPUImageDeleter( shared_from_this(), key, buffer ) );
+	pImage->setFormatProperties( fmt );
+	return pImage;
+}
+
+
+boost::shared_ptr< Vision::Image > ImagePool::clone( Vision::Image& image )
+{
+	Vision::Image::ImageFormatProperties fmt;
+	image.getFormatProperties( fmt );
+
+	boost::shared_ptr< Vision::Image > pCopy( getImage( image.width(), image.height(), fmt ) );
+	cv::Mat target( pCopy->Mat() );
+	image.Mat().copyTo( target );
+	return pCopy;
+}
+
+
+unsigned long ImagePool::allocations() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	return m_allocations;
+}
+
+
+unsigned long ImagePool::reuses() const
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	return m_reuses;
+}
+
+
+void ImagePool::recycle( const Key& key, const cv::Mat& buffer )
+{
+	// somebody kept a cv::Mat header on the buffer, it must not be handed out again
+	if ( !buffer.u || buffer.u->refcount > 1 )
+		return;
+
+	boost::mutex::scoped_lock l( m_mutex );
+	std::vector< cv::Mat >& freeList = m_freeBuffers[ key ];
+	if ( freeList.size() < m_highWaterMark )
+		freeList.push_back( buffer );
+}
+
+
+void ImagePool::recycle( const Key& key, const cv::UMat& buffer )
+{
+	if ( !buffer.u || buffer.u->urefcount > 1 )
+		return;
+
+	boost::mutex::scoped_lock l( m_mutex );
+	std::vector< cv::UMat >& freeList = m_freeGPUBuffers[ key ];
+	if ( freeList.size() < m_highWaterMark )
+		freeList.push_back( buffer );
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,108 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Recycling pool for the image buffers pushed by the frame grabber
+ */
+
+#ifndef __UBITRACK_DRIVERS_IMAGEPOOL_H_INCLUDED__
+#define __UBITRACK_DRIVERS_IMAGEPOOL_H_INCLUDED__
+
+#include <map>
+#include <vector>
+#include <cstddef>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <utVision/Image.h>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Hands out images whose buffers go back into the pool when the last reference is released.
+ *
+ * Buffers are kept per width, height and OpenCV type (depth and channels). At most \c highWaterMark
+ * unused buffers are kept for each key, the rest is freed. A pool must be created with
+ * boost::shared_ptr, images that outlive it simply free their buffer.
+ */
+class ImagePool
+	: public boost::enable_shared_from_this< ImagePool >
+	, private boost::noncopyable
+{
+public:
+
+	/** constructor, a high water mark of 0 disables recycling */
+	ImagePool( std::size_t highWaterMark );
+
+	/** returns an image in CPU memory with the given size and format, the content is undefined */
+	boost::shared_ptr< Vision::Image > getImage( int width, int height, const Vision::Image::ImageFormatProperties& fmt );
+
+	/**
+	 * returns an image in GPU memory (cv::UMat) with the given size and format, the content is undefined.
+	 * Buffers with a different \c usage (e.g. cv::USAGE_ALLOCATE_HOST_MEMORY for pinned upload buffers) are pooled separately.
+	 */
+	boost::shared_ptr< Vision::Image > getGPUImage( int width, int height, const Vision::Image::ImageFormatProperties& fmt, 
+		cv::UMatUsageFlags usage = cv::USAGE_DEFAULT );
+
+	/** returns a copy of an image (CPU memory) */
+	boost::shared_ptr< Vision::Image > clone( Vision::Image& image );
+
+	/** number of buffers allocated since construction */
+	unsigned long allocations() const;
+
+	/** number of requests served with a recycled buffer */
+	unsigned long reuses() const;
+
+protected:
+
+	/** width, height, OpenCV type and cv::UMatUsageFlags */
+	typedef boost::tuple< int, int, int, int > Key;
+
+	friend class PooledImageDeleter;
+	friend class PooledGPUImageDeleter;
+
+	void recycle( const Key& key, const cv::Mat& buffer );
+	void recycle( const Key& key, const cv::UMat& buffer );
+
+	std::size_t m_highWaterMark;
+
+	std::map< Key, std::vector< cv::Mat > > m_freeBuffers;
+	std::map< Key, std::vector< cv::UMat > > m_freeGPUBuffers;
+
+	unsigned long m_allocations;
+	unsigned long m_reuses;
+
+	mutable boost::mutex m_mutex;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Image pyramids stored as a single image
+ */
+
+#include "ImagePyramid.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+/** size of the next pyramid level, as computed by cv::pyrDown */
+static cv::Size nextLevelSize( cv::Size size )
+{
+	return cv::Size( ( size.width + 1 ) / 2, ( size.height + 1 ) / 2 );
+}
+
+
+cv::Size pyramidImageSize( cv::Size base, int levels )
+{
+	if ( levels <= 1 )
+		return base;
+	return cv::Size( base.width + nextLevelSize( base ).width, base.height );
+}
+
+
+cv::Rect pyramidLevelRect( cv::Size base, int level )
+{
+	if ( level <= 0 )
+		return cv::Rect( cv::Point( 0, 0 ), base );
+
+	cv::Size size = nextLevelSize( base );
+	int y = 0;
+	for ( int i = 1; i < level; i++ )
+	{
+		y += size.height;
+		size = nextLevelSize( size );
+	}
+	return cv::Rect( cv::Point( base.width, y ), size );
+}
+
+
+cv::Size pyramidBaseSize( cv::Size pyramidSize, int levels )
+{
+	// W + ( W + 1 ) / 2 is 3W / 2 for even and ( 3W + 1 ) / 2 for odd widths
+	if ( levels <= 1 )
+		return pyramidSize;
+	return cv::Size( 2 * pyramidSize.width / 3, pyramidSize.height );
+}
+
+
+void pyramidLevels( const cv::Mat& pyramid, int levels, std::vector< cv::Mat >& levelViews )
+{
+	cv::Size base = pyramidBaseSize( pyramid.size(), levels );
+	levelViews.resize( levels > 0 ? levels : 0 );
+	for ( int i = 0; i < levels; i++ )
+		levelViews[ i ] = pyramid( pyramidLevelRect( base, i ) );
+}
+
+
+void buildPyramid( const cv::Mat& base, cv::Mat pyramid, int levels )
+{
+	// each level is computed from the previous one in place, the views never reallocate
+	base.copyTo( pyramid( pyramidLevelRect( base.size(), 0 ) ) );
+	for ( int i = 1; i < levels; i++ )
+	{
+		cv::Mat target = pyramid( pyramidLevelRect( base.size(), i ) );
+		cv::pyrDown( pyramid( pyramidLevelRect( base.size(), i - 1 ) ), target, target.size() );
+	}
+}
+
+
+void buildPyramid( const cv::UMat& base, cv::UMat pyramid, int levels )
+{
+	base.copyTo( pyramid( pyramidLevelRect( base.size(), 0 ) ) );
+	for ( int i = 1; i < levels; i++ )
+	{
+		cv::UMat target = pyramid( pyramidLevelRect( base.size(), i ) );
+		cv::pyrDown( pyramid( pyramidLevelRect( base.size(), i - 1 ) ), target, target.size() );
+	}
+}
+
+} } // namespace Ubitrack::Drivers
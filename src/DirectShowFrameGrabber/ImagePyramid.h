@@ -0,0 +1,70 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Image pyramids stored as a single image
+ */
+
+#ifndef __UBITRACK_DRIVERS_IMAGEPYRAMID_H_INCLUDED__
+#define __UBITRACK_DRIVERS_IMAGEPYRAMID_H_INCLUDED__
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Layout of a pyramid in one image.
+ *
+ * Level 0 (the full resolution image, W x H) is at the top left, the smaller levels are stacked
+ * below each other right of it, starting at the top. Every level has the size cv::pyrDown produces
+ * from the previous one, so the image is W + ( W + 1 ) / 2 pixels wide and H pixels high. The pixels
+ * below the smaller levels are undefined.
+ */
+
+/** size of the image holding \c levels levels (including the full resolution) of an image of size \c base */
+cv::Size pyramidImageSize( cv::Size base, int levels );
+
+/** area of a level in the pyramid image */
+cv::Rect pyramidLevelRect( cv::Size base, int level );
+
+/** size of the full resolution level of a pyramid image */
+cv::Size pyramidBaseSize( cv::Size pyramidSize, int levels );
+
+/**
+ * views of the levels of a pyramid image, e.g. for cv::calcOpticalFlowPyrLK.
+ * No pixels are copied, the views refer to the buffer of \c pyramid.
+ */
+void pyramidLevels( const cv::Mat& pyramid, int levels, std::vector< cv::Mat >& levelViews );
+
+/** computes the levels of \c base into \c pyramid, which must be allocated with pyramidImageSize */
+void buildPyramid( const cv::Mat& base, cv::Mat pyramid, int levels );
+
+/** computes the levels with OpenCL, like \c buildPyramid */
+void buildPyramid( const cv::UMat& base, cv::UMat pyramid, int levels );
+
+} } // namespace Ubitrack::Drivers
+
+#endif
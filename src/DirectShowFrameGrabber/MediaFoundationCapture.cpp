@@ -0,0 +1,650 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Capture backend based on the Media Foundation source reader
+ */
+
+#include "MediaFoundationCapture.h"
+
+#include <vector>
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+#include <mferror.h>
+#include <d3d11.h>
+#include <d3d10.h>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <log4cpp/Category.hh>
+#include <utUtil/Exception.h>
+
+#include "AutoComPtr.h"
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+namespace Ubitrack { namespace Drivers {
+
+/** maps a Media Foundation video subtype to the corresponding sample format */
+static SampleFormat sampleFormatFromSubtype( const GUID& subtype )
+{
+	if ( subtype == MFVideoFormat_RGB24 )
+		return SAMPLE_RGB24;
+	if ( subtype == MFVideoFormat_YUY2 )
+		return SAMPLE_YUY2;
+	if ( subtype == MFVideoFormat_NV12 )
+		return SAMPLE_NV12;
+	if ( subtype == MFVideoFormat_MJPG )
+		return SAMPLE_MJPG;
+	return SAMPLE_UNKNOWN;
+}
+
+/** string attribute of a device activation object, empty if it is not set */
+static std::string attributeString( IMFAttributes* pAttributes, REFGUID key )
+{
+	WCHAR* s = 0;
+	UINT32 length;
+	if ( FAILED( pAttributes->GetAllocatedString( key, &s, &length ) ) )
+		return std::string();
+
+	char buf[ 512 ];
+	if ( !WideCharToMultiByte( CP_ACP, 0, s, -1, buf, sizeof( buf ), 0, 0 ) )
+		buf[ 0 ] = 0;
+	CoTaskMemFree( s );
+	return buf;
+}
+
+/**
+ * finds a video capture device with the same rules as the DirectShow enumeration and activates its media source.
+ * \c sSelectedCamera is left empty for the fallback to the first device.
+ */
+static void findDevice( const std::string& name, const std::string& devicePath, bool bFallback,
+	AutoComPtr< IMFMediaSource >& pSource, std::string& sSelectedCamera )
+{
+	AutoComPtr< IMFAttributes > pAttributes;
+	if ( FAILED( MFCreateAttributes( &pAttributes.p, 1 ) ) || 
+		FAILED( pAttributes->SetGUID( MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE, MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID ) ) )
+		UBITRACK_THROW( "Unable to create device attributes" );
+
+	IMFActivate** ppDevices = 0;
+	UINT32 count = 0;
+	if ( FAILED( MFEnumDeviceSources( pAttributes, &ppDevices, &count ) ) )
+		UBITRACK_THROW( "Unable to enumerate video capture devices" );
+
+	int iSelected = -1;
+	for ( UINT32 i = 0; i < count; i++ )
+	{
+		std::string sName = attributeString( ppDevices[ i ], MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME );
+		std::string sPath = attributeString( ppDevices[ i ], MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK );
+		LOG4CPP_INFO( logger, "Possible capture device: " << sName << " device path: " << sPath );
+
+		if ( iSelected < 0 && !name.empty() && sName.find( name ) != std::string::npos &&
+			( devicePath.empty() || sPath.find( devicePath ) != std::string::npos ) )
+		{
+			iSelected = i;
+			sSelectedCamera = sName;
+		}
+	}
+	if ( iSelected < 0 && bFallback && count > 0 )
+		iSelected = 0;
+
+	HRESULT hr = iSelected >= 0 ? ppDevices[ iSelected ]->ActivateObject( __uuidof( IMFMediaSource ), reinterpret_cast< void** >( &pSource.p ) ) : E_FAIL;
+	for ( UINT32 i = 0; i < count; i++ )
+		ppDevices[ i ]->Release();
+	CoTaskMemFree( ppDevices );
+
+	if ( count == 0 )
+		UBITRACK_THROW( "No video capture device found" );
+	if ( iSelected < 0 )
+		UBITRACK_THROW( "Video capture device not found: " + name );
+	if ( FAILED( hr ) )
+		UBITRACK_THROW( "Unable to activate video capture device" );
+}
+
+/** a native media type of the camera */
+struct NativeType
+{
+	DWORD index;
+	SampleFormat format;
+	bool h264;
+	UINT32 width;
+	UINT32 height;
+
+	/** frame interval range in 100ns units */
+	long long minInterval;
+	long long maxInterval;
+
+	bool compressed() const
+	{ return h264 || format == SAMPLE_MJPG; }
+};
+
+/** reads the properties of a native media type, false if the subtype cannot be captured */
+static bool nativeTypeInfo( IMFMediaType* pType, DWORD index, NativeType& type )
+{
+	GUID subtype;
+	if ( FAILED( pType->GetGUID( MF_MT_SUBTYPE, &subtype ) ) || FAILED( MFGetAttributeSize( pType, MF_MT_FRAME_SIZE, &type.width, &type.height ) ) )
+		return false;
+
+	type.index = index;
+	type.h264 = subtype == MFVideoFormat_H264;
+	type.format = sampleFormatFromSubtype( subtype );
+	if ( type.format == SAMPLE_UNKNOWN && !type.h264 )
+		return false;
+
+	UINT32 num = 0;
+	UINT32 den = 0;
+	MFGetAttributeRatio( pType, MF_MT_FRAME_RATE, &num, &den );
+	type.minInterval = type.maxInterval = num ? 10000000LL * den / num : 0;
+	if ( SUCCEEDED( MFGetAttributeRatio( pType, MF_MT_FRAME_RATE_RANGE_MAX, &num, &den ) ) && num )
+		type.minInterval = 10000000LL * den / num;
+	if ( SUCCEEDED( MFGetAttributeRatio( pType, MF_MT_FRAME_RATE_RANGE_MIN, &num, &den ) ) && num )
+		type.maxInterval = 10000000LL * den / num;
+	if ( type.maxInterval < type.minInterval )
+		type.maxInterval = type.minInterval;
+	return true;
+}
+
+/**
+ * selects the native type with the requested size and pixel format, scored like the DirectShow capture modes:
+ * 1. reaches the requested frame rate, 2. throughput in pixels/s, 3. preferred pixel format. With hardware decoding 
+ * the compressed streams are preferred, H.264 is only used then.
+ * @return the position in \c types, -1 if no type matches
+ */
+static int selectNativeType( const std::vector< NativeType >& types, const MediaFoundationSettings& settings, long long& bestInterval )
+{
+	int iBest = -1;
+	bool bBestReachesRate = false;
+	double fBestThroughput = 0;
+	bool bBestPreferred = false;
+	for ( int i = 0; i < (int)types.size(); i++ )
+	{
+		const NativeType& type = types[ i ];
+		bool bSizeOk = ( settings.width <= 0 || (int)type.width == settings.width ) && 
+			( settings.height <= 0 || (int)type.height == settings.height );
+		bool bFormatOk = settings.pixelFormat == SAMPLE_UNKNOWN ? ( !type.h264 || settings.hardwareDecode ) : 
+			( !type.h264 && type.format == settings.pixelFormat );
+		if ( !bSizeOk || !bFormatOk )
+			continue;
+
+		long long interval = type.minInterval;
+		if ( settings.frameRate > 0 )
+		{
+			interval = (long long)( 1e7 / settings.frameRate + 0.5 );
+			if ( interval < type.minInterval )
+				interval = type.minInterval;
+			if ( interval > type.maxInterval )
+				interval = type.maxInterval;
+		}
+
+		double fps = interval > 0 ? 1e7 / interval : 0;
+		bool bReachesRate = settings.frameRate <= 0 || fps >= settings.frameRate * 0.99;
+		double fThroughput = fps * type.width * type.height;
+		bool bPreferred = settings.hardwareDecode ? type.compressed() : 
+			( settings.nativeFormats ? type.format != SAMPLE_RGB24 : type.format == SAMPLE_RGB24 );
+
+		bool bBetter = iBest < 0;
+		if ( !bBetter && bReachesRate != bBestReachesRate )
+			bBetter = bReachesRate;
+		else if ( !bBetter && fThroughput != fBestThroughput )
+			bBetter = fThroughput > fBestThroughput;
+		else if ( !bBetter )
+			bBetter = bPreferred && !bBestPreferred;
+
+		if ( bBetter )
+		{
+			iBest = i;
+			bBestReachesRate = bReachesRate;
+			fBestThroughput = fThroughput;
+			bBestPreferred = bPreferred;
+			bestInterval = interval;
+		}
+	}
+	return iBest;
+}
+
+/** creates a D3D11 device for the decoders of the source reader, false if there is no hardware device */
+static bool createDeviceManager( ID3D11Device* pShared, AutoComPtr< ID3D11Device >& pDevice, AutoComPtr< IMFDXGIDeviceManager >& pManager )
+{
+	D3D_FEATURE_LEVEL level;
+	if ( pShared )
+	{
+		pDevice.p = pShared;
+		pShared->AddRef();
+	}
+	else if ( FAILED( D3D11CreateDevice( 0, D3D_DRIVER_TYPE_HARDWARE, 0, D3D11_CREATE_DEVICE_VIDEO_SUPPORT, 0, 0, 
+		D3D11_SDK_VERSION, &pDevice.p, &level, 0 ) ) )
+		return false;
+
+	// the decoders and the reader use the device from their own threads
+	AutoComPtr< ID3D10Multithread > pMultithread;
+	if ( SUCCEEDED( pDevice.QueryInterface( pMultithread ) ) )
+		pMultithread->SetMultithreadProtected( TRUE );
+
+	UINT token;
+	return SUCCEEDED( MFCreateDXGIDeviceManager( &token, &pManager.p ) ) && SUCCEEDED( pManager->ResetDevice( pDevice, token ) );
+}
+
+/** deleter unlocking and releasing the media buffer of a sample */
+struct MediaBufferUnlocker
+{
+	void operator()( IMFMediaBuffer* pBuffer )
+	{
+		pBuffer->Unlock();
+		pBuffer->Release();
+	}
+};
+
+/** deleter releasing a sample, which returns its texture to the decoder */
+struct SampleReleaser
+{
+	void operator()( IMFSample* pSample )
+	{ pSample->Release(); }
+};
+
+
+/**
+ * receives the callbacks of the asynchronous source reader and owns the reader, the media source and the D3D11 device.
+ * The mutex is held while a sample is delivered, so that \c shutdown waits for a callback in progress.
+ */
+class MediaFoundationCapture::Reader
+	: public IMFSourceReaderCallback
+{
+public:
+
+	Reader( Callback callback )
+		: m_bRunning( false )
+		, m_bLost( false )
+		, m_bTextures( false )
+		, m_width( 0 )
+		, m_height( 0 )
+		, m_refCount( 1 )
+		, m_callback( callback )
+		, m_bPending( false )
+		, m_bStop( false )
+	{}
+
+	/** asks for the next sample if running and no request is pending, m_mutex must be locked */
+	void requestSample()
+	{
+		if ( !m_bRunning || m_bPending || m_bStop || m_bLost )
+			return;
+
+		HRESULT hr = m_pSourceReader->ReadSample( (DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0, 0, 0, 0, 0 );
+		if ( FAILED( hr ) )
+		{
+			LOG4CPP_WARN( logger, "Requesting a sample failed: " << std::hex << hr );
+			m_bLost = true;
+		}
+		else
+			m_bPending = true;
+	}
+
+	void start()
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		m_bRunning = true;
+		requestSample();
+	}
+
+	void pause()
+	{ m_bRunning = false; }
+
+	/** stops the callbacks and releases the reader, which also holds a reference to this object */
+	void shutdown()
+	{
+		{
+			boost::mutex::scoped_lock l( m_mutex );
+			m_bStop = true;
+		}
+		m_pSourceReader.Release();
+		if ( m_pSource )
+			m_pSource->Shutdown();
+		m_pSource.Release();
+		m_pDeviceManager.Release();
+		m_pDevice.Release();
+	}
+
+	// IUnknown
+	STDMETHODIMP QueryInterface( REFIID riid, void** ppvObject )
+	{
+		if ( !ppvObject )
+			return E_POINTER;
+		if ( riid == __uuidof( IUnknown ) || riid == __uuidof( IMFSourceReaderCallback ) )
+		{
+			*ppvObject = static_cast< IMFSourceReaderCallback* >( this );
+			AddRef();
+			return S_OK;
+		}
+		*ppvObject = 0;
+		return E_NOINTERFACE;
+	}
+
+	STDMETHODIMP_(ULONG) AddRef()
+	{ return InterlockedIncrement( &m_refCount ); }
+
+	STDMETHODIMP_(ULONG) Release()
+	{
+		ULONG n = InterlockedDecrement( &m_refCount );
+		if ( n == 0 )
+			delete this;
+		return n;
+	}
+
+	// IMFSourceReaderCallback
+	STDMETHODIMP OnReadSample( HRESULT hrStatus, DWORD dwStreamIndex, DWORD dwStreamFlags, LONGLONG llTimestamp, IMFSample* pSample )
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		m_bPending = false;
+		if ( m_bStop )
+			return S_OK;
+
+		if ( FAILED( hrStatus ) || ( dwStreamFlags & ( MF_SOURCE_READERF_ERROR | MF_SOURCE_READERF_ENDOFSTREAM ) ) )
+		{
+			LOG4CPP_WARN( logger, "Capture stream failed: status=" << std::hex << hrStatus << ", flags=" << dwStreamFlags );
+			m_bLost = true;
+			return S_OK;
+		}
+
+		if ( pSample && m_bRunning )
+			deliver( pSample );
+
+		requestSample();
+		return S_OK;
+	}
+
+	STDMETHODIMP OnFlush( DWORD )
+	{ return S_OK; }
+
+	STDMETHODIMP OnEvent( DWORD, IMFMediaEvent* )
+	{ return S_OK; }
+
+	AutoComPtr< IMFMediaSource > m_pSource;
+	AutoComPtr< IMFSourceReader > m_pSourceReader;
+	AutoComPtr< ID3D11Device > m_pDevice;
+	AutoComPtr< IMFDXGIDeviceManager > m_pDeviceManager;
+
+	boost::atomic< bool > m_bRunning;
+	boost::atomic< bool > m_bLost;
+
+	/** deliver NV12 textures instead of locked buffers */
+	boost::atomic< bool > m_bTextures;
+	int m_width;
+	int m_height;
+
+protected:
+
+	~Reader()
+	{}
+
+	void deliver( IMFSample* pSample )
+	{
+		Measurement::Timestamp now = Measurement::now();
+
+		MediaFoundationSample sample;
+		sample.pTexture = 0;
+		sample.subresource = 0;
+		if ( !( m_bTextures && textureSample( pSample, sample ) ) && !lockedSample( pSample, sample ) )
+			return;
+
+		// the device timestamp is taken at capture on the QPC based clock of MFGetSystemTime, the sample time is only relative to the start
+		UINT64 deviceTime;
+		sample.time = now;
+		if ( SUCCEEDED( pSample->GetUINT64( MFSampleExtension_DeviceTimestamp, &deviceTime ) ) )
+		{
+			LONGLONG age = MFGetSystemTime() - LONGLONG( deviceTime );
+			if ( age > 0 && Measurement::Timestamp( age ) * 100 < now )
+				sample.time = now - Measurement::Timestamp( age ) * 100;
+		}
+
+		if ( !m_callback( sample ) && sample.pTexture )
+		{
+			LOG4CPP_WARN( logger, "Texture samples rejected, reading decoded frames back to host memory" );
+			m_bTextures = false;
+		}
+	}
+
+	/** locks the buffer of a sample in host memory */
+	bool lockedSample( IMFSample* pSample, MediaFoundationSample& sample )
+	{
+		// a single buffer is returned as it is, 2D buffers with padded rows are copied into the contiguous layout
+		AutoComPtr< IMFMediaBuffer > pBuffer;
+		BYTE* pData;
+		DWORD length;
+		if ( FAILED( pSample->ConvertToContiguousBuffer( &pBuffer.p ) ) || FAILED( pBuffer->Lock( &pData, 0, &length ) ) )
+		{
+			LOG4CPP_INFO( logger, "Unable to lock sample buffer" );
+			return false;
+		}
+
+		sample.pData = pData;
+		sample.length = length;
+		pBuffer->AddRef();
+		sample.buffer.reset( (IMFMediaBuffer*)pBuffer, MediaBufferUnlocker() );
+		return true;
+	}
+
+	/** wraps the decoded texture of a sample, the texture stays with the decoder until the sample is released */
+	bool textureSample( IMFSample* pSample, MediaFoundationSample& sample )
+	{
+		AutoComPtr< IMFMediaBuffer > pBuffer;
+		AutoComPtr< IMFDXGIBuffer > pDXGIBuffer;
+		AutoComPtr< ID3D11Texture2D > pTexture;
+		UINT subresource;
+		if ( FAILED( pSample->GetBufferByIndex( 0, &pBuffer.p ) ) || FAILED( pBuffer.QueryInterface( pDXGIBuffer ) ) || 
+			FAILED( pDXGIBuffer->GetResource( __uuidof( ID3D11Texture2D ), (void**)&pTexture.p ) ) || 
+			FAILED( pDXGIBuffer->GetSubresourceIndex( &subresource ) ) )
+			return false;
+
+		// decoders may allocate textures larger than the frame, e.g. with the height aligned to macroblocks
+		D3D11_TEXTURE2D_DESC desc;
+		pTexture->GetDesc( &desc );
+		if ( desc.Format != DXGI_FORMAT_NV12 || int( desc.Width ) < m_width || int( desc.Height ) < m_height )
+			return false;
+
+		// the sample holds a reference to the texture through its buffer
+		sample.pTexture = pTexture;
+		sample.subresource = subresource;
+		sample.pData = 0;
+		sample.length = std::size_t( m_width ) * m_height * 3 / 2;
+		pSample->AddRef();
+		sample.buffer.reset( pSample, SampleReleaser() );
+		return true;
+	}
+
+	LONG m_refCount;
+	Callback m_callback;
+
+	bool m_bPending;
+	bool m_bStop;
+	boost::mutex m_mutex;
+};
+
+
+MediaFoundationCapture::MediaFoundationCapture( const std::string& name, const std::string& devicePath, bool bFallback,
+	const MediaFoundationSettings& settings, Callback callback )
+	: m_pReader( 0 )
+	, m_format( SAMPLE_UNKNOWN )
+	, m_width( 0 )
+	, m_height( 0 )
+	, m_bottomUp( false )
+{
+	if ( FAILED( MFStartup( MF_VERSION, MFSTARTUP_NOSOCKET ) ) )
+		UBITRACK_THROW( "Unable to start Media Foundation" );
+
+	m_pReader = new Reader( callback );
+	try
+	{
+		findDevice( name, devicePath, bFallback, m_pReader->m_pSource, m_deviceName );
+		LOG4CPP_INFO( logger, "Using camera: " << m_deviceName << " (Media Foundation)" );
+
+		// the reader inserts decoders and converters for the requested output type
+		AutoComPtr< IMFAttributes > pAttributes;
+		MFCreateAttributes( &pAttributes.p, 4 );
+		pAttributes->SetUnknown( MF_SOURCE_READER_ASYNC_CALLBACK, m_pReader );
+		pAttributes->SetUINT32( MF_SOURCE_READER_ENABLE_ADVANCED_VIDEO_PROCESSING, TRUE );
+		if ( settings.hardwareDecode )
+		{
+			pAttributes->SetUINT32( MF_READWRITE_ENABLE_HARDWARE_TRANSFORMS, TRUE );
+			if ( createDeviceManager( settings.pDevice, m_pReader->m_pDevice, m_pReader->m_pDeviceManager ) )
+				pAttributes->SetUnknown( MF_SOURCE_READER_D3D_MANAGER, m_pReader->m_pDeviceManager );
+			else
+				LOG4CPP_WARN( logger, "No D3D11 video device, decoding without DXGI surfaces" );
+		}
+
+		if ( FAILED( MFCreateSourceReaderFromMediaSource( m_pReader->m_pSource, pAttributes, &m_pReader->m_pSourceReader.p ) ) )
+			UBITRACK_THROW( "Unable to create source reader" );
+		IMFSourceReader* pSourceReader = m_pReader->m_pSourceReader;
+		const DWORD stream = (DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM;
+
+		// native media types of the camera
+		std::vector< NativeType > types;
+		AutoComPtr< IMFMediaType > pType;
+		for ( DWORD i = 0; SUCCEEDED( pSourceReader->GetNativeMediaType( stream, i, &pType.p ) ); i++ )
+		{
+			NativeType type;
+			if ( nativeTypeInfo( pType, i, type ) )
+			{
+				types.push_back( type );
+				LOG4CPP_INFO( logger, "Media type " << i << ": fps=" << ( type.minInterval > 0 ? 1e7 / type.minInterval : 0 ) << 
+					", width=" << type.width << ", height=" << type.height << ", type=" << ( type.h264 ? "H264" : sampleFormatName( type.format ) ) );
+			}
+			pType.Release();
+		}
+
+		long long interval = 0;
+		int iBest = selectNativeType( types, settings, interval );
+		bool bDecode = false;
+		if ( iBest < 0 )
+			LOG4CPP_WARN( logger, "No media type matches the requested size and pixel format, using the driver default" );
+		else if ( SUCCEEDED( pSourceReader->GetNativeMediaType( stream, types[ iBest ].index, &pType.p ) ) )
+		{
+			if ( interval > 0 )
+				MFSetAttributeRatio( pType, MF_MT_FRAME_RATE, 10000000, UINT32( interval ) );
+			if ( FAILED( pSourceReader->SetCurrentMediaType( stream, 0, pType ) ) )
+				LOG4CPP_WARN( logger, "Unable to set the selected media type" );
+			else
+			{
+				LOG4CPP_INFO( logger, "Selected media type " << types[ iBest ].index << ": " << types[ iBest ].width << "x" << types[ iBest ].height << 
+					" @ " << ( interval > 0 ? 1e7 / interval : 0 ) << " fps" );
+				bDecode = types[ iBest ].h264 || ( types[ iBest ].format == SAMPLE_MJPG && ( settings.hardwareDecode || !settings.nativeFormats ) );
+			}
+			pType.Release();
+		}
+
+		// without native formats the frames are converted to RGB24 like in the DirectShow graph, NV12 if there is no converter
+		GUID currentSubtype = GUID_NULL;
+		if ( SUCCEEDED( pSourceReader->GetCurrentMediaType( stream, &pType.p ) ) )
+			pType->GetGUID( MF_MT_SUBTYPE, &currentSubtype );
+		pType.Release();
+		SampleFormat currentFormat = sampleFormatFromSubtype( currentSubtype );
+		if ( bDecode || currentFormat == SAMPLE_UNKNOWN || ( !settings.nativeFormats && currentFormat != SAMPLE_RGB24 ) )
+		{
+			GUID subtypes[] = { settings.nativeFormats ? MFVideoFormat_NV12 : MFVideoFormat_RGB24, MFVideoFormat_NV12 };
+			bool bSet = false;
+			for ( int i = 0; i < 2 && !bSet; i++ )
+			{
+				AutoComPtr< IMFMediaType > pOutputType;
+				bSet = SUCCEEDED( MFCreateMediaType( &pOutputType.p ) ) &&
+					SUCCEEDED( pOutputType->SetGUID( MF_MT_MAJOR_TYPE, MFMediaType_Video ) ) &&
+					SUCCEEDED( pOutputType->SetGUID( MF_MT_SUBTYPE, subtypes[ i ] ) ) &&
+					SUCCEEDED( pSourceReader->SetCurrentMediaType( stream, 0, pOutputType ) );
+			}
+			if ( !bSet )
+				UBITRACK_THROW( "Unable to set the output format of the source reader" );
+		}
+
+		// the format actually delivered
+		GUID subtype;
+		UINT32 width, height;
+		if ( FAILED( pSourceReader->GetCurrentMediaType( stream, &pType.p ) ) || FAILED( pType->GetGUID( MF_MT_SUBTYPE, &subtype ) ) ||
+			FAILED( MFGetAttributeSize( pType, MF_MT_FRAME_SIZE, &width, &height ) ) || sampleFormatFromSubtype( subtype ) == SAMPLE_UNKNOWN )
+			UBITRACK_THROW( "Unsupported MEDIATYPE" );
+		m_format = sampleFormatFromSubtype( subtype );
+		m_width = width;
+		m_height = height;
+
+		// negative strides denote bottom-up images, the default depends on the format
+		LONG stride = 0;
+		if ( FAILED( pType->GetUINT32( MF_MT_DEFAULT_STRIDE, (UINT32*)&stride ) ) )
+			MFGetStrideForBitmapInfoHeader( subtype.Data1, width, &stride );
+		m_bottomUp = m_format == SAMPLE_RGB24 && stride < 0;
+
+		m_pReader->m_width = m_width;
+		m_pReader->m_height = m_height;
+		setTextureSamples( settings.textureSamples );
+
+		LOG4CPP_INFO( logger, "Image dimensions: " << m_width << "x" << m_height << " format: " << sampleFormatName( m_format ) << 
+			( bDecode ? ( m_pReader->m_pDeviceManager ? ", decoded on the GPU" : ", decoded" ) : "" ) );
+	}
+	catch ( ... )
+	{
+		m_pReader->shutdown();
+		m_pReader->Release();
+		MFShutdown();
+		throw;
+	}
+}
+
+
+MediaFoundationCapture::~MediaFoundationCapture()
+{
+	m_pReader->shutdown();
+	m_pReader->Release();
+	MFShutdown();
+}
+
+
+void MediaFoundationCapture::start()
+{
+	m_pReader->start();
+}
+
+
+void MediaFoundationCapture::pause()
+{
+	m_pReader->pause();
+}
+
+
+IUnknown* MediaFoundationCapture::device()
+{
+	return m_pReader->m_pSource;
+}
+
+
+bool MediaFoundationCapture::lost() const
+{
+	return m_pReader->m_bLost;
+}
+
+
+void MediaFoundationCapture::setTextureSamples( bool bTextures )
+{
+	// textures are only there if the frames are decoded to NV12 on the device
+	m_pReader->m_bTextures = bTextures && m_format == SAMPLE_NV12 && m_pReader->m_pDeviceManager;
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,183 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Capture backend based on the Media Foundation source reader
+ */
+
+#ifndef __UBITRACK_DRIVERS_MEDIAFOUNDATIONCAPTURE_H_INCLUDED__
+#define __UBITRACK_DRIVERS_MEDIAFOUNDATIONCAPTURE_H_INCLUDED__
+
+#include <cstddef>
+#include <string>
+
+#include <utUtil/CleanWindows.h>
+#include <objbase.h>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <utMeasurement/Timestamp.h>
+
+#include "SampleConversion.h"
+
+struct ID3D11Device;
+struct ID3D11Texture2D;
+
+namespace Ubitrack { namespace Drivers {
+
+/** settings for configuring a Media Foundation capture device */
+struct MediaFoundationSettings
+{
+	MediaFoundationSettings()
+		: width( 0 )
+		, height( 0 )
+		, frameRate( 0 )
+		, pixelFormat( SAMPLE_UNKNOWN )
+		, nativeFormats( false )
+		, hardwareDecode( true )
+		, pDevice( 0 )
+		, textureSamples( false )
+	{}
+
+	int width;
+	int height;
+	double frameRate;
+	SampleFormat pixelFormat;
+	bool nativeFormats;
+
+	/** decode compressed camera streams (MJPG, H.264) with hardware transforms on a D3D11 device */
+	bool hardwareDecode;
+
+	/** D3D11 device to decode on, e.g. the one of the OpenCL context, a new device is created if 0 */
+	ID3D11Device* pDevice;
+
+	/** deliver decoded NV12 frames as textures instead of reading them back to host memory */
+	bool textureSamples;
+};
+
+/** a sample delivered by the source reader */
+struct MediaFoundationSample
+{
+	/** capture time on the local clock */
+	Measurement::Timestamp time;
+
+	unsigned char* pData;
+	std::size_t length;
+
+	/**
+	 * texture holding the decoded NV12 frame if texture samples are enabled, \c pData is 0 then,
+	 * \c length is the size the frame would have in host memory
+	 */
+	ID3D11Texture2D* pTexture;
+	unsigned subresource;
+
+	/** keeps the media buffer locked (or the texture alive), \c pData is valid as long as a copy of this pointer exists */
+	boost::shared_ptr< void > buffer;
+};
+
+/**
+ * Video capture device opened with an asynchronous IMFSourceReader.
+ *
+ * The reader calls back on a Media Foundation work queue thread, and a new sample is only requested
+ * after the previous one has been delivered, so the callback is never entered concurrently. Compressed
+ * camera streams are decoded by the reader to NV12 (or RGB24 without native formats), using hardware
+ * decoders on a D3D11 device if \c hardwareDecode is set. Uncompressed streams are delivered as they
+ * come from the camera if native formats are allowed.
+ *
+ * Errors of the stream, e.g. an unplugged camera, stop the sample requests and set the \c lost flag,
+ * the owner is expected to poll it and to replace the object.
+ */
+class MediaFoundationCapture
+	: private boost::noncopyable
+{
+public:
+
+	/**
+	 * receives the samples. Returning false for a texture sample switches to samples in host memory,
+	 * e.g. when the texture cannot be shared.
+	 */
+	typedef boost::function< bool ( const MediaFoundationSample& ) > Callback;
+
+	/**
+	 * opens the first video capture device whose name contains \c name and whose device path (symbolic link)
+	 * contains \c devicePath. If none matches, the first device is used if \c bFallback is set.
+	 * @throws Util::Exception if there is no device or it cannot be configured
+	 */
+	MediaFoundationCapture( const std::string& name, const std::string& devicePath, bool bFallback,
+		const MediaFoundationSettings& settings, Callback callback );
+
+	/** stops the reader, waits until a callback in progress has returned */
+	~MediaFoundationCapture();
+
+	/** starts requesting samples */
+	void start();
+
+	/** stops requesting samples, a request in progress is still delivered */
+	void pause();
+
+	/** format of the delivered samples */
+	SampleFormat format() const
+	{ return m_format; }
+
+	int width() const
+	{ return m_width; }
+
+	int height() const
+	{ return m_height; }
+
+	/** RGB24 rows are stored bottom-up */
+	bool bottomUp() const
+	{ return m_bottomUp; }
+
+	/** friendly name of the opened device */
+	const std::string& deviceName() const
+	{ return m_deviceName; }
+
+	/** the media source, which provides IAMCameraControl and IAMVideoProcAmp */
+	IUnknown* device();
+
+	/** true after the stream has failed, no samples are delivered anymore */
+	bool lost() const;
+
+	/** switches between texture samples and samples in host memory, takes effect with the next sample */
+	void setTextureSamples( bool bTextures );
+
+protected:
+
+	class Reader;
+
+	/** COM object receiving the reader callbacks, reference counted */
+	Reader* m_pReader;
+
+	SampleFormat m_format;
+	int m_width;
+	int m_height;
+	bool m_bottomUp;
+	std::string m_deviceName;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
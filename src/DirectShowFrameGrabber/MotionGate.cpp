@@ -0,0 +1,77 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Skipping of captured frames of a static scene
+ */
+
+#include "MotionGate.h"
+
+namespace Ubitrack { namespace Drivers {
+
+MotionGate::MotionGate()
+	: m_threshold( 0 )
+	, m_keepAlive( 0 )
+	, m_gridSize( 32 )
+	, m_lastAdmitted( 0 )
+{
+}
+
+
+void MotionGate::configure( double threshold, double keepAlive, int gridSize )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_threshold = threshold > 0 ? threshold : 0;
+	m_keepAlive = keepAlive > 0 ? Measurement::Timestamp( keepAlive * 1e6 ) : 0;
+	m_gridSize = gridSize > 0 ? gridSize : 1;
+	m_reference.release();
+}
+
+
+bool MotionGate::admit( SampleFormat format, const cv::Mat& sample, int width, int height, Measurement::Timestamp t )
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( m_threshold <= 0 || !sampleLumaGrid( format, sample, width, height, m_gridSize, m_grid ) )
+		return true;
+
+	if ( !m_reference.empty() && !( m_keepAlive > 0 && t > m_lastAdmitted && t - m_lastAdmitted >= m_keepAlive ) )
+	{
+		cv::absdiff( m_grid, m_reference, m_difference );
+		if ( cv::sum( m_difference )[ 0 ] < m_threshold * m_grid.total() )
+			return false;
+	}
+
+	m_grid.copyTo( m_reference );
+	m_lastAdmitted = t;
+	return true;
+}
+
+
+void MotionGate::reset()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	m_reference.release();
+}
+
+} } // namespace Ubitrack::Drivers
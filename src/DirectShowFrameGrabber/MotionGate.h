@@ -0,0 +1,94 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Skipping of captured frames of a static scene
+ */
+
+#ifndef __UBITRACK_DRIVERS_MOTIONGATE_H_INCLUDED__
+#define __UBITRACK_DRIVERS_MOTIONGATE_H_INCLUDED__
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <opencv2/core/core.hpp>
+#include <utMeasurement/Timestamp.h>
+
+#include "SampleConversion.h"
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Decides for every captured frame whether the scene has changed enough to be processed.
+ *
+ * The luma of a coarse grid of the sample (see sampleLumaGrid) is compared with the grid of the last
+ * admitted frame, not the previous one, so slow changes accumulate until they pass the threshold.
+ * The metric is the mean absolute difference in grey levels (0-255), computed with the vectorized
+ * cv::absdiff and cv::sum. A frame is always admitted if none has been admitted for the keep-alive
+ * interval, so that consumers keep getting frames of a static scene. Compressed samples (MJPG)
+ * cannot be inspected cheaply and are always admitted.
+ *
+ * All methods are thread-safe.
+ */
+class MotionGate
+	: private boost::noncopyable
+{
+public:
+
+	MotionGate();
+
+	/**
+	 * \c threshold is the minimum mean luma change, 0 disables the gate. \c keepAlive is in ms, 0 admits
+	 * no frame of a static scene. \c gridSize is the number of grid points per row and column.
+	 */
+	void configure( double threshold, double keepAlive, int gridSize );
+
+	bool enabled() const
+	{ return m_threshold > 0; }
+
+	/** decides about a wrapped sample captured at \c t */
+	bool admit( SampleFormat format, const cv::Mat& sample, int width, int height, Measurement::Timestamp t );
+
+	/** forgets the last admitted frame, so that the next one is admitted, e.g. when the format has changed */
+	void reset();
+
+protected:
+
+	double m_threshold;
+	Measurement::Timestamp m_keepAlive;
+	int m_gridSize;
+
+	/** grid of the last admitted frame, empty if there is none */
+	cv::Mat m_reference;
+	Measurement::Timestamp m_lastAdmitted;
+
+	/** grid and difference of the current frame, kept to avoid allocations */
+	cv::Mat m_grid;
+	cv::Mat m_difference;
+
+	boost::mutex m_mutex;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
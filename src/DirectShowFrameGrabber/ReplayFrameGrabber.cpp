@@ -0,0 +1,228 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Replays recordings of the DirectShowFrameGrabber through its processing pipeline
+ */
+
+#include "ReplayFrameGrabber.h"
+
+#include <boost/bind.hpp>
+#include <log4cpp/Category.hh>
+#include <utVision/Undistortion.h>
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+namespace Ubitrack { namespace Drivers {
+
+ReplayFrameGrabber::ReplayFrameGrabber( const std::string& sName, boost::shared_ptr< Graph::UTQLSubgraph > subgraph )
+	: Dataflow::Component( sName )
+	, m_speed( 1.0 )
+	, m_loop( false )
+	, m_recordedTimestamps( false )
+	, m_bStop( false )
+	, m_outPort( "Output", *this )
+	, m_colorOutPort( "ColorOutput", *this )
+	, m_outPortRAW( "OutputRAW", *this )
+	, m_pyramidOutPort( "PyramidOutput", *this )
+	, m_intrinsicsPort( "Intrinsics", *this, boost::bind( &ReplayFrameGrabber::getIntrinsic, this, _1 ) )
+{
+	m_fileName = subgraph->m_DataflowAttributes.getAttributeString( "file" );
+	subgraph->m_DataflowAttributes.getAttributeData( "replaySpeed", m_speed );
+	m_loop = subgraph->m_DataflowAttributes.getAttributeString( "loop" ) == "true";
+	m_recordedTimestamps = subgraph->m_DataflowAttributes.getAttributeString( "recordedTimestamps" ) == "true";
+
+	m_pReader.reset( new SampleReader( m_fileName ) );
+	const RecordingFormat& format = m_pReader->format();
+	LOG4CPP_INFO( logger, "Replaying " << sampleFormatName( format.format ) << " " << format.width << "x" << format.height << 
+		" samples from " << m_fileName );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "statisticsInterval" ) )
+	{
+		int statisticsInterval = 0;
+		subgraph->m_DataflowAttributes.getAttributeData( "statisticsInterval", statisticsInterval );
+		m_statistics.setInterval( statisticsInterval );
+	}
+
+	boost::scoped_ptr< Vision::Undistortion > undistorter;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "cameraModelFile" ) )
+		undistorter.reset( new Vision::Undistortion( subgraph->m_DataflowAttributes.getAttributeString( "cameraModelFile" ) ) );
+	else
+		undistorter.reset( new Vision::Undistortion( subgraph->m_DataflowAttributes.getAttributeString( "intrinsicMatrixFile" ), 
+			subgraph->m_DataflowAttributes.getAttributeString( "distortionFile" ) ) );
+	m_undistortionMaps.reset( new UndistortionMapCache( undistorter->getIntrinsics() ) );
+
+	int imagePoolSize = 4;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "imagePoolSize" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "imagePoolSize", imagePoolSize );
+	m_imagePool.reset( new ImagePool( imagePoolSize > 0 ? imagePoolSize : 0 ) );
+
+	int width = 0;
+	int height = 0;
+	subgraph->m_DataflowAttributes.getAttributeData( "imageWidth", width );
+	subgraph->m_DataflowAttributes.getAttributeData( "imageHeight", height );
+
+	m_pipeline.reset( new FramePipeline( m_imagePool, *m_undistortionMaps, m_statistics ) );
+	m_pipeline->setSampleFormat( format.format, format.width, format.height );
+	m_pipeline->setDesiredSize( width, height );
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "binning" ) )
+	{
+		int binning = 1;
+		subgraph->m_DataflowAttributes.getAttributeData( "binning", binning );
+		m_pipeline->setBinning( binning );
+	}
+
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "pyramidLevels" ) )
+	{
+		int levels = 4;
+		subgraph->m_DataflowAttributes.getAttributeData( "pyramidLevels", levels );
+		m_pipeline->setPyramidLevels( levels );
+	}
+
+	int bandThreads = 0;
+	if ( subgraph->m_DataflowAttributes.hasAttribute( "parallelThreads" ) )
+		subgraph->m_DataflowAttributes.getAttributeData( "parallelThreads", bandThreads );
+	if ( bandThreads > 0 )
+	{
+		int bands = 0;
+		if ( subgraph->m_DataflowAttributes.hasAttribute( "parallelBands" ) )
+			subgraph->m_DataflowAttributes.getAttributeData( "parallelBands", bands );
+		m_pipeline->setBandPool( BandPool::get( bandThreads ), bands > 0 ? bands : 2 * ( bandThreads + 1 ) );
+	}
+}
+
+
+ReplayFrameGrabber::~ReplayFrameGrabber()
+{
+	m_bStop = true;
+	if ( m_pThread )
+		m_pThread->join();
+}
+
+
+void ReplayFrameGrabber::start()
+{
+	if ( !m_running )
+	{
+		m_bStop = false;
+		m_pThread.reset( new boost::thread( boost::bind( &ReplayFrameGrabber::replayThread, this ) ) );
+	}
+	Component::start();
+}
+
+
+void ReplayFrameGrabber::stop()
+{
+	if ( m_pThread )
+	{
+		m_bStop = true;
+		m_pThread->join();
+		m_pThread.reset();
+	}
+	Component::stop();
+}
+
+
+Dataflow::PushSupplier< Measurement::ImageMeasurement >& ReplayFrameGrabber::outputPort( FramePipeline::Output output )
+{
+	switch ( output )
+	{
+	case FramePipeline::OUTPUT_RAW: return m_outPortRAW;
+	case FramePipeline::OUTPUT_COLOR: return m_colorOutPort;
+	case FramePipeline::OUTPUT_PYRAMID: return m_pyramidOutPort;
+	default: return m_outPort;
+	}
+}
+
+
+void ReplayFrameGrabber::replayThread()
+{
+	const RecordingFormat& format = m_pReader->format();
+	std::vector< char > data;
+	Measurement::Timestamp firstTime = 0;
+	Measurement::Timestamp startTime = 0;
+	bool bFirst = true;
+	bool bSamplesInPass = false;
+
+	while ( !m_bStop )
+	{
+		Measurement::Timestamp t;
+		if ( !m_pReader->next( t, data ) )
+		{
+			if ( !m_loop || !bSamplesInPass )
+			{
+				LOG4CPP_INFO( logger, "End of recording " << m_fileName );
+				return;
+			}
+			m_pReader->rewind();
+			bFirst = true;
+			bSamplesInPass = false;
+			continue;
+		}
+		bSamplesInPass = true;
+
+		// keep the recorded intervals, scaled by the replay speed
+		Measurement::Timestamp now = Measurement::now();
+		if ( bFirst )
+		{
+			firstTime = t;
+			startTime = now;
+			bFirst = false;
+		}
+		Measurement::Timestamp due = now;
+		if ( m_speed > 0 )
+		{
+			due = startTime + Measurement::Timestamp( ( t > firstTime ? t - firstTime : 0 ) / m_speed );
+			// short sleeps, so that stop does not wait for long pauses in the recording
+			while ( !m_bStop && ( now = Measurement::now() ) < due )
+			{
+				Measurement::Timestamp wait = due - now < 10000000 ? due - now : 10000000;
+				boost::this_thread::sleep( boost::posix_time::microseconds( long( wait / 1000 ) ) );
+			}
+		}
+
+		m_statistics.count( FrameStatistics::COUNTER_RECEIVED );
+		if ( m_statistics.reportDue( Measurement::now() ) )
+			LOG4CPP_INFO( logger, getName() << " statistics: " << m_statistics.summary() );
+
+		if ( data.empty() || data.size() < minimumSampleSize( format.format, format.width, format.height ) )
+		{
+			m_statistics.count( FrameStatistics::COUNTER_INVALID_SIZE );
+			continue;
+		}
+
+		Vision::Image::ImageFormatProperties fmt;
+		int imageWidth, imageHeight;
+		sampleImageFormat( format.format, format.width, format.height, format.bottomUp, data.size(), fmt, imageWidth, imageHeight );
+		boost::shared_ptr< Vision::Image > pSample( new Vision::Image( imageWidth, imageHeight, fmt, &data[ 0 ] ) );
+
+		// the read buffer is reused for the next sample
+		PortSink sink( *this, m_recordedTimestamps ? t : due );
+		m_pipeline->process( pSample, true, sink );
+	}
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,146 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Replays recordings of the DirectShowFrameGrabber through its processing pipeline
+ */
+
+#ifndef __UBITRACK_DRIVERS_REPLAYFRAMEGRABBER_H_INCLUDED__
+#define __UBITRACK_DRIVERS_REPLAYFRAMEGRABBER_H_INCLUDED__
+
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <utDataflow/PushSupplier.h>
+#include <utDataflow/PullSupplier.h>
+#include <utDataflow/Component.h>
+#include <utMeasurement/Measurement.h>
+#include <utVision/Image.h>
+
+#include "SampleRecording.h"
+#include "ImagePool.h"
+#include "UndistortionMap.h"
+#include "FrameStatistics.h"
+#include "FramePipeline.h"
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * @ingroup vision_components
+ * Plays back a file written with the \c recordingFile attribute of the DirectShowFrameGrabber.
+ *
+ * The recorded samples go through the same pipeline as live frames, so resizing, binning,
+ * undistortion and all output ports behave like those of the grabber.
+ *
+ * @par Input Ports
+ * None.
+ *
+ * @par Output Ports
+ * \c Output, \c ColorOutput, \c OutputRAW and \c PyramidOutput push ports of type Ubitrack::Measurement::ImageMeasurement
+ * and the \c Intrinsics pull port of type Ubitrack::Measurement::Matrix3x3.
+ *
+ * @par Configuration
+ * \c file, \c replaySpeed (1 is the recorded rate, 0 as fast as possible), \c loop and
+ * \c recordedTimestamps (send the recorded instead of the current timestamps).
+ */
+class ReplayFrameGrabber
+	: public Dataflow::Component
+{
+public:
+
+	/** constructor, opens the recording */
+	ReplayFrameGrabber( const std::string& sName, boost::shared_ptr< Graph::UTQLSubgraph > subgraph );
+
+	/** destructor, stops the replay */
+	~ReplayFrameGrabber();
+
+	/** starts the replay */
+	void start();
+
+	/** stops the replay, the next start continues with the next sample */
+	void stop();
+
+protected:
+
+	/** forwards the pipeline outputs of one frame to the ports */
+	class PortSink
+		: public FramePipeline::Sink
+	{
+	public:
+		PortSink( ReplayFrameGrabber& grabber, Measurement::Timestamp t )
+			: m_grabber( grabber )
+			, m_time( t )
+		{}
+
+		bool isConnected( FramePipeline::Output output ) const
+		{ return m_grabber.outputPort( output ).isConnected(); }
+
+		void send( FramePipeline::Output output, boost::shared_ptr< Vision::Image > pImage )
+		{ m_grabber.outputPort( output ).send( Measurement::ImageMeasurement( m_time, pImage ) ); }
+
+	protected:
+		ReplayFrameGrabber& m_grabber;
+		Measurement::Timestamp m_time;
+	};
+
+	/** port of a pipeline output */
+	Dataflow::PushSupplier< Measurement::ImageMeasurement >& outputPort( FramePipeline::Output output );
+
+	/** handler method for incoming pull requests */
+	Measurement::Matrix3x3 getIntrinsic( Measurement::Timestamp t )
+	{ return Measurement::Matrix3x3( t, m_undistortionMaps->intrinsics().matrix ); }
+
+	/** thread method, sends the samples at their recorded pace */
+	void replayThread();
+
+	std::string m_fileName;
+	double m_speed;
+	bool m_loop;
+	bool m_recordedTimestamps;
+
+	boost::scoped_ptr< SampleReader > m_pReader;
+	boost::scoped_ptr< boost::thread > m_pThread;
+	boost::atomic< bool > m_bStop;
+
+	FrameStatistics m_statistics;
+	boost::shared_ptr< ImagePool > m_imagePool;
+	boost::scoped_ptr< UndistortionMapCache > m_undistortionMaps;
+	boost::scoped_ptr< FramePipeline > m_pipeline;
+
+	// the ports
+	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_outPort;
+	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_colorOutPort;
+	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_outPortRAW;
+	Dataflow::PushSupplier< Measurement::ImageMeasurement > m_pyramidOutPort;
+	Dataflow::PullSupplier< Measurement::Matrix3x3 > m_intrinsicsPort;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
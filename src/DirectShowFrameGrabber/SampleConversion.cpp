@@ -0,0 +1,361 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Conversion of native DirectShow sample formats
+ */
+
+#include "SampleConversion.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+const char* sampleFormatName( SampleFormat format )
+{
+	switch ( format )
+	{
+	case SAMPLE_RGB24: return "RGB24";
+	case SAMPLE_YUY2: return "YUY2";
+	case SAMPLE_NV12: return "NV12";
+	case SAMPLE_MJPG: return "MJPG";
+	default: return "?";
+	}
+}
+
+
+SampleFormat sampleFormatFromName( const std::string& name )
+{
+	for ( int i = 0; i < SAMPLE_UNKNOWN; i++ )
+		if ( name == sampleFormatName( SampleFormat( i ) ) )
+			return SampleFormat( i );
+	return SAMPLE_UNKNOWN;
+}
+
+
+std::size_t minimumSampleSize( SampleFormat format, int width, int height )
+{
+	switch ( format )
+	{
+	case SAMPLE_RGB24: return std::size_t( width ) * height * 3;
+	case SAMPLE_YUY2: return std::size_t( width ) * height * 2;
+	case SAMPLE_NV12: return std::size_t( width ) * height * 3 / 2;
+	default: return 1;
+	}
+}
+
+
+void sampleImageFormat( SampleFormat format, int width, int height, bool bottomUp, std::size_t sampleLength,
+	Vision::Image::ImageFormatProperties& fmt, int& imageWidth, int& imageHeight )
+{
+	fmt.depth = CV_8U;
+	fmt.origin = 0;
+	imageWidth = width;
+	imageHeight = height;
+
+	switch ( format )
+	{
+	case SAMPLE_RGB24:
+		// DIBs are bottom-up unless the driver delivers top-down rows
+		fmt.imageFormat = Vision::Image::BGR;
+		fmt.channels = 3;
+		fmt.bitsPerPixel = 24;
+		fmt.origin = bottomUp ? 1 : 0;
+		break;
+
+	case SAMPLE_YUY2:
+		// packed Y0 U Y1 V, as expected by cv::COLOR_YUV2BGR_YUY2
+		fmt.imageFormat = Vision::Image::YUV422;
+		fmt.channels = 2;
+		fmt.bitsPerPixel = 16;
+		break;
+
+	case SAMPLE_NV12:
+		// full resolution Y plane followed by the interleaved, subsampled UV plane
+		fmt.imageFormat = Vision::Image::RAW;
+		fmt.channels = 1;
+		fmt.bitsPerPixel = 8;
+		imageHeight = height * 3 / 2;
+		break;
+
+	default:
+		// compressed bitstream as a single row of bytes
+		fmt.imageFormat = Vision::Image::RAW;
+		fmt.channels = 1;
+		fmt.bitsPerPixel = 8;
+		imageWidth = int( sampleLength );
+		imageHeight = 1;
+		break;
+	}
+}
+
+
+bool convertSampleToBGR( SampleFormat format, const cv::Mat& sample, cv::Mat bgr )
+{
+	const uchar* pTarget = bgr.data;
+
+	// OpenCV's colour conversions use vectorized (SSE2/AVX2) and multithreaded code paths
+	switch ( format )
+	{
+	case SAMPLE_RGB24:
+		sample.copyTo( bgr );
+		break;
+
+	case SAMPLE_YUY2:
+		cv::cvtColor( sample, bgr, cv::COLOR_YUV2BGR_YUY2 );
+		break;
+
+	case SAMPLE_NV12:
+		cv::cvtColor( sample, bgr, cv::COLOR_YUV2BGR_NV12 );
+		break;
+
+	case SAMPLE_MJPG:
+		// decodes directly into bgr, as long as the size of the JPEG matches
+		cv::imdecode( sample, cv::IMREAD_COLOR, &bgr );
+		break;
+
+	default:
+		return false;
+	}
+
+	// a different size would have reallocated the target
+	return bgr.data == pTarget && pTarget != 0;
+}
+
+cv::Rect alignSampleRegion( SampleFormat format, const cv::Rect& region, int width, int height )
+{
+	cv::Rect frame( 0, 0, width, height );
+	if ( format != SAMPLE_YUY2 && format != SAMPLE_NV12 )
+		return region & frame;
+
+	// YUY2 shares chroma between two pixels of a row, NV12 between 2x2 pixels
+	int x0 = region.x & ~1;
+	int x1 = ( region.x + region.width + 1 ) & ~1;
+	int y0 = region.y;
+	int y1 = region.y + region.height;
+	if ( format == SAMPLE_NV12 )
+	{
+		y0 &= ~1;
+		y1 = ( y1 + 1 ) & ~1;
+	}
+	return cv::Rect( x0, y0, x1 - x0, y1 - y0 ) & frame;
+}
+
+
+bool convertSampleRegionToBGR( SampleFormat format, const cv::Mat& sample, int width, int height, const cv::Rect& region, cv::Mat bgr )
+{
+	const uchar* pTarget = bgr.data;
+
+	switch ( format )
+	{
+	case SAMPLE_RGB24:
+		sample( region ).copyTo( bgr );
+		break;
+
+	case SAMPLE_YUY2:
+		cv::cvtColor( sample( region ), bgr, cv::COLOR_YUV2BGR_YUY2 );
+		break;
+
+	case SAMPLE_NV12:
+	{
+		// the converter needs both planes in one buffer, copying them is much cheaper than converting the whole frame
+		cv::Mat planes( region.height * 3 / 2, region.width, CV_8UC1 );
+		sample( region ).copyTo( planes.rowRange( 0, region.height ) );
+		sample( cv::Rect( region.x, height + region.y / 2, region.width, region.height / 2 ) ).copyTo( planes.rowRange( region.height, planes.rows ) );
+		cv::cvtColor( planes, bgr, cv::COLOR_YUV2BGR_NV12 );
+		break;
+	}
+
+	default:
+		return false;
+	}
+
+	return bgr.data == pTarget && pTarget != 0;
+}
+
+
+bool convertSampleRegionToGrey( SampleFormat format, const cv::Mat& sample, int width, int height, const cv::Rect& region, cv::Mat grey )
+{
+	const uchar* pTarget = grey.data;
+
+	switch ( format )
+	{
+	case SAMPLE_RGB24:
+		cv::cvtColor( sample( region ), grey, cv::COLOR_BGR2GRAY );
+		break;
+
+	case SAMPLE_YUY2:
+		cv::cvtColor( sample( region ), grey, cv::COLOR_YUV2GRAY_YUY2 );
+		break;
+
+	case SAMPLE_NV12:
+		sample( region ).copyTo( grey );
+		break;
+
+	default:
+		return false;
+	}
+
+	return grey.data == pTarget && pTarget != 0;
+}
+
+
+bool sampleConvertibleOnGPU( SampleFormat format )
+{
+	return format == SAMPLE_RGB24 || format == SAMPLE_YUY2 || format == SAMPLE_NV12;
+}
+
+
+bool convertSampleToBGR( SampleFormat format, const cv::UMat& sample, cv::UMat bgr )
+{
+	const cv::UMatData* pTarget = bgr.u;
+
+	// with UMat arguments OpenCV enqueues its OpenCL kernels without waiting for the result
+	switch ( format )
+	{
+	case SAMPLE_RGB24:
+		sample.copyTo( bgr );
+		break;
+
+	case SAMPLE_YUY2:
+		cv::cvtColor( sample, bgr, cv::COLOR_YUV2BGR_YUY2 );
+		break;
+
+	case SAMPLE_NV12:
+		cv::cvtColor( sample, bgr, cv::COLOR_YUV2BGR_NV12 );
+		break;
+
+	default:
+		return false;
+	}
+
+	return bgr.u == pTarget && pTarget != 0;
+}
+
+
+cv::Mat sampleLumaPlane( SampleFormat format, const cv::Mat& sample, int width, int height )
+{
+	if ( format != SAMPLE_NV12 || sample.cols != width || sample.rows < height )
+		return cv::Mat();
+	return sample.rowRange( 0, height );
+}
+
+
+bool convertSampleToGrey( SampleFormat format, const cv::Mat& sample, cv::Mat grey )
+{
+	const uchar* pTarget = grey.data;
+
+	switch ( format )
+	{
+	case SAMPLE_RGB24:
+		cv::cvtColor( sample, grey, cv::COLOR_BGR2GRAY );
+		break;
+
+	case SAMPLE_YUY2:
+		// just picks every second byte
+		cv::cvtColor( sample, grey, cv::COLOR_YUV2GRAY_YUY2 );
+		break;
+
+	case SAMPLE_NV12:
+		sample.rowRange( 0, grey.rows ).copyTo( grey );
+		break;
+
+	case SAMPLE_MJPG:
+		// libjpeg only decodes the luma channel and skips the color conversion
+		cv::imdecode( sample, cv::IMREAD_GRAYSCALE, &grey );
+		break;
+
+	default:
+		return false;
+	}
+
+	return grey.data == pTarget && pTarget != 0;
+}
+
+bool sampleLumaGrid( SampleFormat format, const cv::Mat& sample, int width, int height, int gridSize, cv::Mat& grid )
+{
+	if ( format == SAMPLE_MJPG || format == SAMPLE_UNKNOWN || width <= 0 || height <= 0 || gridSize <= 0 )
+		return false;
+
+	grid.create( gridSize, gridSize, CV_8UC1 );
+	for ( int i = 0; i < gridSize; i++ )
+	{
+		const uchar* pRow = sample.ptr< uchar >( int( ( 2 * i + 1 ) * (long long)height / ( 2 * gridSize ) ) );
+		uchar* pGrid = grid.ptr< uchar >( i );
+		for ( int j = 0; j < gridSize; j++ )
+		{
+			int x = int( ( 2 * j + 1 ) * (long long)width / ( 2 * gridSize ) );
+			switch ( format )
+			{
+			case SAMPLE_RGB24:
+				pGrid[ j ] = uchar( ( 29 * pRow[ 3 * x ] + 150 * pRow[ 3 * x + 1 ] + 77 * pRow[ 3 * x + 2 ] ) >> 8 );
+				break;
+			case SAMPLE_YUY2:
+				pGrid[ j ] = pRow[ 2 * x ];
+				break;
+			default:
+				pGrid[ j ] = pRow[ x ];
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+double sampleMeanLuma( SampleFormat format, const cv::Mat& sample, int width, int height, int gridSize )
+{
+	cv::Mat grid;
+	if ( !sampleLumaGrid( format, sample, width, height, gridSize, grid ) )
+		return -1;
+	return cv::mean( grid )[ 0 ];
+}
+
+bool convertSampleToGrey( SampleFormat format, const cv::UMat& sample, cv::UMat grey )
+{
+	const cv::UMatData* pTarget = grey.u;
+
+	switch ( format )
+	{
+	case SAMPLE_RGB24:
+		cv::cvtColor( sample, grey, cv::COLOR_BGR2GRAY );
+		break;
+
+	case SAMPLE_YUY2:
+		cv::cvtColor( sample, grey, cv::COLOR_YUV2GRAY_YUY2 );
+		break;
+
+	case SAMPLE_NV12:
+		sample.rowRange( 0, grey.rows ).copyTo( grey );
+		break;
+
+	default:
+		return false;
+	}
+
+	return grey.u == pTarget && pTarget != 0;
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,138 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Conversion of native DirectShow sample formats (YUY2, NV12, MJPG) to BGR and greyscale images
+ */
+
+#ifndef __UBITRACK_DRIVERS_SAMPLECONVERSION_H_INCLUDED__
+#define __UBITRACK_DRIVERS_SAMPLECONVERSION_H_INCLUDED__
+
+#include <cstddef>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <utVision/Image.h>
+
+namespace Ubitrack { namespace Drivers {
+
+/** pixel formats the sample grabber can be connected with */
+enum SampleFormat
+{
+	SAMPLE_RGB24,
+	SAMPLE_YUY2,
+	SAMPLE_NV12,
+	SAMPLE_MJPG,
+	SAMPLE_UNKNOWN
+};
+
+/** human readable name of a sample format */
+const char* sampleFormatName( SampleFormat format );
+
+/** sample format with the given name, SAMPLE_UNKNOWN if there is none */
+SampleFormat sampleFormatFromName( const std::string& name );
+
+/** minimum number of bytes of a valid sample, 1 for compressed formats */
+std::size_t minimumSampleSize( SampleFormat format, int width, int height );
+
+/**
+ * image format properties for wrapping a sample buffer into a Vision::Image.
+ * The dimensions of the wrapped image (which are not the frame dimensions for NV12 and MJPG)
+ * are returned in \c imageWidth and \c imageHeight. \c bottomUp tells if RGB24 rows are stored
+ * bottom-up (the DIB default) or top-down (negative biHeight), the other formats are always top-down.
+ */
+void sampleImageFormat( SampleFormat format, int width, int height, bool bottomUp, std::size_t sampleLength,
+	Vision::Image::ImageFormatProperties& fmt, int& imageWidth, int& imageHeight );
+
+/**
+ * converts a wrapped sample into a 3-channel BGR image.
+ * \c bgr must already be allocated with the frame size, the result is written into its buffer.
+ * @return false if the sample could not be decoded
+ */
+bool convertSampleToBGR( SampleFormat format, const cv::Mat& sample, cv::Mat bgr );
+
+/**
+ * widens a region of the frame so that it can be cut out of a sample without splitting chroma samples
+ * (even coordinates for YUY2 and NV12), clipped to the frame
+ */
+cv::Rect alignSampleRegion( SampleFormat format, const cv::Rect& region, int width, int height );
+
+/**
+ * converts a region of a wrapped sample into a BGR image, only the pixels of the region are touched.
+ * \c bgr must already be allocated with the region size, the region must be aligned by \c alignSampleRegion.
+ * @return false if the format cannot be converted partially (MJPG) or the sample could not be decoded
+ */
+bool convertSampleRegionToBGR( SampleFormat format, const cv::Mat& sample, int width, int height, const cv::Rect& region, cv::Mat bgr );
+
+/**
+ * converts a region of a wrapped sample into a greyscale image, like \c convertSampleRegionToBGR.
+ * @return false if the format cannot be converted partially (MJPG) or the sample could not be decoded
+ */
+bool convertSampleRegionToGrey( SampleFormat format, const cv::Mat& sample, int width, int height, const cv::Rect& region, cv::Mat grey );
+
+/** true if samples of this format can be converted with OpenCL kernels (all but MJPG) */
+bool sampleConvertibleOnGPU( SampleFormat format );
+
+/**
+ * converts an uploaded sample into a 3-channel BGR image on the GPU.
+ * \c bgr must already be allocated with the frame size. The kernels are only enqueued, the call
+ * does not wait for them to finish.
+ * @return false if the sample format cannot be converted on the GPU
+ */
+bool convertSampleToBGR( SampleFormat format, const cv::UMat& sample, cv::UMat bgr );
+
+/**
+ * luma plane of a sample as a view into the sample buffer, for formats that store it separately (NV12).
+ * @return an empty matrix for all other formats
+ */
+cv::Mat sampleLumaPlane( SampleFormat format, const cv::Mat& sample, int width, int height );
+
+/**
+ * converts a wrapped sample into a 1-channel greyscale image without a color intermediate.
+ * \c grey must already be allocated with the frame size, the result is written into its buffer.
+ * @return false if the sample could not be decoded
+ */
+bool convertSampleToGrey( SampleFormat format, const cv::Mat& sample, cv::Mat grey );
+
+/**
+ * luma of \c gridSize x \c gridSize pixels of a wrapped sample, evenly spread over the frame, into \c grid (CV_8UC1).
+ * @return false for compressed formats (MJPG)
+ */
+bool sampleLumaGrid( SampleFormat format, const cv::Mat& sample, int width, int height, int gridSize, cv::Mat& grid );
+
+/**
+ * mean brightness (0-255) of a wrapped sample, estimated from the \c gridSize x \c gridSize pixels of \c sampleLumaGrid.
+ * @return a negative value for compressed formats (MJPG)
+ */
+double sampleMeanLuma( SampleFormat format, const cv::Mat& sample, int width, int height, int gridSize );
+
+/**
+ * converts an uploaded sample into a 1-channel greyscale image on the GPU, like \c convertSampleToBGR.
+ * @return false if the sample format cannot be converted on the GPU
+ */
+bool convertSampleToGrey( SampleFormat format, const cv::UMat& sample, cv::UMat grey );
+
+} } // namespace Ubitrack::Drivers
+
+#endif
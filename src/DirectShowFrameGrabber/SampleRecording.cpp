@@ -0,0 +1,194 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Recording and reading of native capture samples with their timestamps
+ */
+
+#include "SampleRecording.h"
+
+#include <sstream>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <log4cpp/Category.hh>
+#include <utUtil/Exception.h>
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+namespace Ubitrack { namespace Drivers {
+
+static const char s_magic[ 8 ] = { 'U', 'T', 'D', 'S', 'R', 'E', 'C', '1' };
+
+/** large writes keep the disk streaming */
+static const std::size_t s_fileBufferSize = 4 * 1024 * 1024;
+
+static void writeLE( std::ostream& os, boost::uint64_t value, int bytes )
+{
+	char buf[ 8 ];
+	for ( int i = 0; i < bytes; i++ )
+		buf[ i ] = char( ( value >> ( 8 * i ) ) & 0xFF );
+	os.write( buf, bytes );
+}
+
+static bool readLE( std::istream& is, boost::uint64_t& value, int bytes )
+{
+	unsigned char buf[ 8 ];
+	if ( !is.read( reinterpret_cast< char* >( buf ), bytes ) )
+		return false;
+	value = 0;
+	for ( int i = 0; i < bytes; i++ )
+		value |= boost::uint64_t( buf[ i ] ) << ( 8 * i );
+	return true;
+}
+
+
+SampleRecorder::SampleRecorder( const std::string& fileName, const RecordingFormat& format, std::size_t queueSize )
+	: m_format( format )
+	, m_fileBuffer( new char[ s_fileBufferSize ] )
+	, m_queue( queueSize > 0 ? queueSize : 1, FrameQueue< Sample >::DropNewest )
+	, m_maxBuffers( m_queue.capacity() + 2 )
+{
+	m_file.rdbuf()->pubsetbuf( m_fileBuffer.get(), s_fileBufferSize );
+	m_file.open( fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+	if ( !m_file )
+		UBITRACK_THROW( "Unable to create recording " + fileName );
+
+	m_file.write( s_magic, sizeof( s_magic ) );
+	m_file << sampleFormatName( format.format ) << " " << format.width << " " << format.height << " " << ( format.bottomUp ? 1 : 0 ) << "\n";
+
+	m_pThread.reset( new boost::thread( boost::bind( &SampleRecorder::writeThread, this ) ) );
+	LOG4CPP_INFO( logger, "Recording " << sampleFormatName( format.format ) << " " << format.width << "x" << format.height << 
+		" samples to " << fileName );
+}
+
+
+SampleRecorder::~SampleRecorder()
+{
+	// the writer empties the queue before it stops
+	m_queue.shutdown();
+	m_pThread->join();
+	m_file.close();
+
+	if ( droppedCount() )
+		LOG4CPP_WARN( logger, "Recording dropped " << droppedCount() << " samples" );
+}
+
+
+bool SampleRecorder::record( Measurement::Timestamp t, const void* pData, std::size_t length )
+{
+	Sample sample;
+	sample.time = t;
+	sample.data = getBuffer();
+	sample.data->assign( static_cast< const char* >( pData ), static_cast< const char* >( pData ) + length );
+	return m_queue.push( sample );
+}
+
+
+void SampleRecorder::writeThread()
+{
+	Sample sample;
+	while ( m_queue.pop( sample ) )
+	{
+		writeLE( m_file, boost::uint64_t( sample.time ), 8 );
+		writeLE( m_file, boost::uint64_t( sample.data->size() ), 4 );
+		m_file.write( &( *sample.data )[ 0 ], sample.data->size() );
+		recycle( sample.data );
+		sample.data.reset();
+
+		if ( !m_file )
+		{
+			LOG4CPP_ERROR( logger, "Writing the recording failed, stopped recording" );
+			return;
+		}
+	}
+}
+
+
+boost::shared_ptr< std::vector< char > > SampleRecorder::getBuffer()
+{
+	boost::mutex::scoped_lock l( m_bufferMutex );
+	if ( m_freeBuffers.empty() )
+		return boost::shared_ptr< std::vector< char > >( new std::vector< char > );
+
+	boost::shared_ptr< std::vector< char > > pBuffer = m_freeBuffers.back();
+	m_freeBuffers.pop_back();
+	return pBuffer;
+}
+
+
+void SampleRecorder::recycle( boost::shared_ptr< std::vector< char > > pBuffer )
+{
+	boost::mutex::scoped_lock l( m_bufferMutex );
+	if ( m_freeBuffers.size() < m_maxBuffers )
+		m_freeBuffers.push_back( pBuffer );
+}
+
+
+
+SampleReader::SampleReader( const std::string& fileName )
+	: m_file( fileName.c_str(), std::ios::in | std::ios::binary )
+{
+	char magic[ sizeof( s_magic ) ];
+	if ( !m_file.read( magic, sizeof( magic ) ) || !std::equal( magic, magic + sizeof( magic ), s_magic ) )
+		UBITRACK_THROW( "Not a sample recording: " + fileName );
+
+	std::string header;
+	std::getline( m_file, header );
+	std::istringstream is( header );
+	std::string formatName;
+	int bottomUp = 0;
+	is >> formatName >> m_format.width >> m_format.height >> bottomUp;
+	m_format.format = sampleFormatFromName( formatName );
+	m_format.bottomUp = bottomUp != 0;
+	if ( !is || m_format.format == SAMPLE_UNKNOWN || m_format.width <= 0 || m_format.height <= 0 )
+		UBITRACK_THROW( "Invalid header in sample recording " + fileName + ": " + header );
+
+	m_firstSample = m_file.tellg();
+}
+
+
+bool SampleReader::next( Measurement::Timestamp& t, std::vector< char >& data )
+{
+	boost::uint64_t time, length;
+	if ( !readLE( m_file, time, 8 ) || !readLE( m_file, length, 4 ) )
+		return false;
+
+	data.resize( std::size_t( length ) );
+	if ( length && !m_file.read( &data[ 0 ], std::streamsize( length ) ) )
+		return false;
+
+	t = Measurement::Timestamp( time );
+	return true;
+}
+
+
+void SampleReader::rewind()
+{
+	m_file.clear();
+	m_file.seekg( m_firstSample );
+}
+
+} } // namespace Ubitrack::Drivers
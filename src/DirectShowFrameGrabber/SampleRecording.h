@@ -0,0 +1,170 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Recording and reading of native capture samples with their timestamps
+ */
+
+#ifndef __UBITRACK_DRIVERS_SAMPLERECORDING_H_INCLUDED__
+#define __UBITRACK_DRIVERS_SAMPLERECORDING_H_INCLUDED__
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <utMeasurement/Timestamp.h>
+
+#include "SampleConversion.h"
+#include "FrameQueue.h"
+
+namespace Ubitrack { namespace Drivers {
+
+/** format of the samples of a recording */
+struct RecordingFormat
+{
+	RecordingFormat()
+		: format( SAMPLE_UNKNOWN )
+		, width( 0 )
+		, height( 0 )
+		, bottomUp( false )
+	{}
+
+	RecordingFormat( SampleFormat f, int w, int h, bool b )
+		: format( f )
+		, width( w )
+		, height( h )
+		, bottomUp( b )
+	{}
+
+	bool operator==( const RecordingFormat& other ) const
+	{ return format == other.format && width == other.width && height == other.height && bottomUp == other.bottomUp; }
+
+	SampleFormat format;
+	int width;
+	int height;
+	bool bottomUp;
+};
+
+/**
+ * Writes the samples of a capture stream unchanged (e.g. MJPG passthrough) into a file.
+ *
+ * The file starts with the magic "UTDSREC1" and a text line "<format> <width> <height> <bottomUp>",
+ * followed by one record per sample: the timestamp in ns (int64), the sample length in bytes
+ * (uint32) and the sample data, all little-endian.
+ *
+ * \c record only copies the sample into a recycled buffer and queues it, a dedicated thread writes
+ * the queue to the file, so the capture thread never waits for the disk. If the disk cannot keep
+ * up, new samples are dropped and counted.
+ */
+class SampleRecorder
+	: private boost::noncopyable
+{
+public:
+
+	/** opens the file and starts the writer thread, throws if the file cannot be created */
+	SampleRecorder( const std::string& fileName, const RecordingFormat& format, std::size_t queueSize );
+
+	/** writes the queued samples and closes the file */
+	~SampleRecorder();
+
+	const RecordingFormat& format() const
+	{ return m_format; }
+
+	/**
+	 * queues a copy of a sample, never blocks.
+	 * @return false if the sample was dropped because the queue is full
+	 */
+	bool record( Measurement::Timestamp t, const void* pData, std::size_t length );
+
+	/** number of samples dropped since the start */
+	unsigned long droppedCount() const
+	{ return m_queue.droppedCount(); }
+
+protected:
+
+	struct Sample
+	{
+		Measurement::Timestamp time;
+		boost::shared_ptr< std::vector< char > > data;
+	};
+
+	/** writer thread method */
+	void writeThread();
+
+	/** a buffer of a written sample, or a new one */
+	boost::shared_ptr< std::vector< char > > getBuffer();
+
+	void recycle( boost::shared_ptr< std::vector< char > > pBuffer );
+
+	RecordingFormat m_format;
+	std::ofstream m_file;
+	boost::scoped_array< char > m_fileBuffer;
+
+	FrameQueue< Sample > m_queue;
+	boost::scoped_ptr< boost::thread > m_pThread;
+
+	std::size_t m_maxBuffers;
+	std::vector< boost::shared_ptr< std::vector< char > > > m_freeBuffers;
+	boost::mutex m_bufferMutex;
+};
+
+
+/** Reads the samples of a file written by SampleRecorder */
+class SampleReader
+	: private boost::noncopyable
+{
+public:
+
+	/** opens the file and reads the header, throws if it is not a recording */
+	SampleReader( const std::string& fileName );
+
+	const RecordingFormat& format() const
+	{ return m_format; }
+
+	/**
+	 * reads the next sample.
+	 * @return false at the end of the file or if the last record is incomplete
+	 */
+	bool next( Measurement::Timestamp& t, std::vector< char >& data );
+
+	/** continues with the first sample */
+	void rewind();
+
+protected:
+	RecordingFormat m_format;
+	std::ifstream m_file;
+	std::streampos m_firstSample;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Priority, MMCSS task and CPU affinity of the capture and processing threads
+ */
+
+#include "ThreadSettings.h"
+
+#include <sstream>
+
+#include <utUtil/CleanWindows.h>
+#include <avrt.h>
+
+#include <log4cpp/Category.hh>
+#include <utUtil/Exception.h>
+
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Vision.DirectShowFrameGrabber" ) );
+
+namespace Ubitrack { namespace Drivers {
+
+static const struct
+{
+	const char* name;
+	int priority;
+} s_priorities[] = {
+	{ "idle", THREAD_PRIORITY_IDLE },
+	{ "lowest", THREAD_PRIORITY_LOWEST },
+	{ "belowNormal", THREAD_PRIORITY_BELOW_NORMAL },
+	{ "normal", THREAD_PRIORITY_NORMAL },
+	{ "aboveNormal", THREAD_PRIORITY_ABOVE_NORMAL },
+	{ "highest", THREAD_PRIORITY_HIGHEST },
+	{ "timeCritical", THREAD_PRIORITY_TIME_CRITICAL }
+};
+
+
+ThreadSettings::ThreadSettings()
+	: m_bPriority( false )
+	, m_priority( THREAD_PRIORITY_NORMAL )
+	, m_affinity( 0 )
+{}
+
+
+void ThreadSettings::setPriority( const std::string& name )
+{
+	m_bPriority = false;
+	if ( name.empty() || name == "default" )
+		return;
+
+	for ( std::size_t i = 0; i < sizeof( s_priorities ) / sizeof( s_priorities[ 0 ] ); i++ )
+		if ( name == s_priorities[ i ].name )
+		{
+			m_bPriority = true;
+			m_priority = s_priorities[ i ].priority;
+			return;
+		}
+	UBITRACK_THROW( "Unsupported thread priority: " + name );
+}
+
+
+void ThreadSettings::setTask( const std::string& task )
+{
+	m_task = task;
+}
+
+
+void ThreadSettings::setAffinity( const std::string& mask )
+{
+	m_affinity = 0;
+	if ( mask.empty() )
+		return;
+
+	std::istringstream is( mask );
+	if ( mask.size() > 2 && mask[ 0 ] == '0' && ( mask[ 1 ] == 'x' || mask[ 1 ] == 'X' ) )
+	{
+		is.ignore( 2 );
+		is >> std::hex;
+	}
+	if ( !( is >> m_affinity ) || !is.eof() )
+		UBITRACK_THROW( "Invalid affinity mask: " + mask );
+}
+
+
+std::string ThreadSettings::describe() const
+{
+	std::ostringstream os;
+	os << "priority=";
+	if ( m_bPriority )
+		os << m_priority;
+	else
+		os << "default";
+	if ( !m_task.empty() )
+		os << ", task=" << m_task;
+	if ( m_affinity )
+		os << ", affinity=0x" << std::hex << m_affinity;
+	return os.str();
+}
+
+
+void* ThreadSettings::apply( const std::string& threadName ) const
+{
+	if ( !enabled() )
+		return 0;
+
+	HANDLE hThread = GetCurrentThread();
+	if ( m_bPriority && !SetThreadPriority( hThread, m_priority ) )
+		LOG4CPP_WARN( logger, threadName << ": unable to set thread priority " << m_priority << ", error " << GetLastError() );
+
+	if ( m_affinity && !SetThreadAffinityMask( hThread, DWORD_PTR( m_affinity ) ) )
+		LOG4CPP_WARN( logger, threadName << ": unable to set affinity mask 0x" << std::hex << m_affinity << std::dec << ", error " << GetLastError() );
+
+	// MMCSS boosts the thread into the realtime range while it is registered for the task
+	HANDLE hTask = 0;
+	if ( !m_task.empty() )
+	{
+		DWORD taskIndex = 0;
+		hTask = AvSetMmThreadCharacteristicsA( m_task.c_str(), &taskIndex );
+		if ( !hTask )
+			LOG4CPP_WARN( logger, threadName << ": unable to register for MMCSS task " << m_task << ", error " << GetLastError() );
+	}
+
+	LOG4CPP_INFO( logger, threadName << ": thread settings " << describe() );
+	return hTask;
+}
+
+
+void ThreadSettings::revert( void* hTask )
+{
+	if ( hTask )
+		AvRevertMmThreadCharacteristics( hTask );
+}
+
+
+void CallbackThreadSettings::update( const std::string& threadName )
+{
+	if ( !m_settings.enabled() )
+		return;
+
+	// usually the callbacks come from the same thread
+	unsigned long thread = GetCurrentThreadId();
+	if ( m_lastThread.exchange( thread ) == thread )
+		return;
+
+	boost::mutex::scoped_lock l( m_mutex );
+	if ( m_threads.find( thread ) == m_threads.end() )
+		m_threads[ thread ] = m_settings.apply( threadName + " streaming thread" );
+}
+
+
+void CallbackThreadSettings::reset()
+{
+	boost::mutex::scoped_lock l( m_mutex );
+	for ( std::map< unsigned long, void* >::iterator it = m_threads.begin(); it != m_threads.end(); it++ )
+		ThreadSettings::revert( it->second );
+	m_threads.clear();
+
+	// thread ids are reused, the next callback must look up its thread again
+	m_lastThread = 0;
+}
+
+} } // namespace Ubitrack::Drivers
@@ -0,0 +1,157 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+/**
+ * @ingroup vision_components
+ * @file
+ * Priority, MMCSS task and CPU affinity of the capture and processing threads
+ */
+
+#ifndef __UBITRACK_DRIVERS_THREADSETTINGS_H_INCLUDED__
+#define __UBITRACK_DRIVERS_THREADSETTINGS_H_INCLUDED__
+
+#include <map>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * Scheduling settings for a thread: a Win32 thread priority, a Multimedia Class Scheduler Service
+ * (MMCSS) task like "Capture" or "Pro Audio", and a CPU affinity mask. Settings that are not set leave
+ * the thread as it is.
+ */
+class ThreadSettings
+{
+public:
+
+	ThreadSettings();
+
+	/**
+	 * sets the priority by name: idle, lowest, belowNormal, normal, aboveNormal, highest, timeCritical,
+	 * or "default" to keep the priority.
+	 * @throws Util::Exception for other names
+	 */
+	void setPriority( const std::string& name );
+
+	/** sets the MMCSS task the thread is registered for, empty for none */
+	void setTask( const std::string& task );
+
+	/**
+	 * sets the affinity mask, given in decimal or hexadecimal with 0x prefix. Empty or 0 keeps the affinity.
+	 * @throws Util::Exception if the mask cannot be parsed
+	 */
+	void setAffinity( const std::string& mask );
+
+	/** true if any setting is set */
+	bool enabled() const
+	{ return m_bPriority || !m_task.empty() || m_affinity != 0; }
+
+	/** human readable summary for log messages */
+	std::string describe() const;
+
+	/**
+	 * applies the settings to the calling thread, failures are logged.
+	 * @return the MMCSS registration handle to be passed to \c revert, 0 if there is none
+	 */
+	void* apply( const std::string& threadName ) const;
+
+	/** undoes the MMCSS registration of \c apply */
+	static void revert( void* hTask );
+
+protected:
+
+	bool m_bPriority;
+	int m_priority;
+	std::string m_task;
+	boost::uint64_t m_affinity;
+};
+
+
+/** applies thread settings while a thread owned by the component runs, e.g. a processing worker */
+class ScopedThreadSettings
+	: private boost::noncopyable
+{
+public:
+
+	ScopedThreadSettings( const ThreadSettings& settings, const std::string& threadName )
+		: m_hTask( settings.apply( threadName ) )
+	{}
+
+	~ScopedThreadSettings()
+	{ ThreadSettings::revert( m_hTask ); }
+
+protected:
+
+	void* m_hTask;
+};
+
+
+/**
+ * applies thread settings to the threads calling back into the component, which are not owned by it
+ * (the DirectShow streaming thread, Media Foundation work queue threads). The settings are applied once
+ * to every thread that calls back, Media Foundation alternates between the threads of its pool.
+ * The MMCSS registrations are kept until \c reset or the destruction.
+ */
+class CallbackThreadSettings
+	: private boost::noncopyable
+{
+public:
+
+	CallbackThreadSettings()
+		: m_lastThread( 0 )
+	{}
+
+	~CallbackThreadSettings()
+	{ reset(); }
+
+	void configure( const ThreadSettings& settings )
+	{ m_settings = settings; }
+
+	const ThreadSettings& settings() const
+	{ return m_settings; }
+
+	/** called at the start of each callback */
+	void update( const std::string& threadName );
+
+	/** undoes the MMCSS registrations, called when no more callbacks come, e.g. after the capture stopped */
+	void reset();
+
+protected:
+
+	ThreadSettings m_settings;
+
+	/** id of the thread of the last callback, which is known to be set up */
+	boost::atomic< unsigned long > m_lastThread;
+
+	/** MMCSS registration handles of the threads the settings were applied to */
+	std::map< unsigned long, void* > m_threads;
+	boost::mutex m_mutex;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Remap tables combining downscaling and undistortion
+ */
+
+#include "UndistortionMap.h"
+
+#include <boost/bind.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace Ubitrack { namespace Drivers {
+
+UndistortionMap::UndistortionMap( const Math::CameraIntrinsics< double >& intrinsics, cv::Size sourceSize, cv::Size targetSize, bool bottomUp )
+	: m_sourceSize( sourceSize )
+	, m_targetSize( targetSize )
+	, m_bottomUp( bottomUp )
+{
+	// compensate for the left-handed OpenCV coordinate frame
+	cv::Matx33d K;
+	for ( int r = 0; r < 3; r++ )
+		for ( int c = 0; c < 3; c++ )
+			K( r, c ) = intrinsics.matrix( r, c ) * ( c == 2 ? -1.0 : 1.0 );
+
+	// opencv order: k1, k2, p1, p2, k3, k4, k5, k6
+	cv::Mat_< double > coeffs = cv::Mat_< double >::zeros( 1, 8 );
+	const int radialIndex[ 6 ] = { 0, 1, 4, 5, 6, 7 };
+	for ( std::size_t i = 0; i < intrinsics.radial_size && i < 6; i++ )
+		coeffs( 0, radialIndex[ i ] ) = intrinsics.radial_params( i );
+	coeffs( 0, 2 ) = intrinsics.tangential_params( 0 );
+	coeffs( 0, 3 ) = intrinsics.tangential_params( 1 );
+
+	// the intrinsics assume a bottom-up image, the target is top-down
+	K( 1, 2 ) = targetSize.height - 1 - K( 1, 2 );
+	coeffs( 0, 2 ) *= -1.0;
+
+	// undistortion table in target coordinates
+	if ( hasDistortion( intrinsics ) )
+		cv::initUndistortRectifyMap( K, coeffs, cv::Mat(), K, targetSize, CV_32FC1, m_mapX, m_mapY );
+	else
+	{
+		m_mapX.create( targetSize, CV_32FC1 );
+		m_mapY.create( targetSize, CV_32FC1 );
+		for ( int y = 0; y < targetSize.height; y++ )
+			for ( int x = 0; x < targetSize.width; x++ )
+			{
+				m_mapX.at< float >( y, x ) = float( x );
+				m_mapY.at< float >( y, x ) = float( y );
+			}
+	}
+
+	// scale the lookup positions to the source image (pixel centers), and read the rows of
+	// bottom-up sources in reverse
+	double sx = double( sourceSize.width ) / targetSize.width;
+	double sy = double( sourceSize.height ) / targetSize.height;
+	if ( sx != 1.0 )
+		m_mapX.convertTo( m_mapX, CV_32F, sx, 0.5 * sx - 0.5 );
+	if ( bottomUp )
+		m_mapY.convertTo( m_mapY, CV_32F, -sy, sourceSize.height - 1 - ( 0.5 * sy - 0.5 ) );
+	else if ( sy != 1.0 )
+		m_mapY.convertTo( m_mapY, CV_32F, sy, 0.5 * sy - 0.5 );
+
+	cv::convertMaps( m_mapX, m_mapY, m_map1, m_map2, CV_16SC2 );
+}
+
+
+void UndistortionMap::remap( const cv::Mat& source, cv::Mat target ) const
+{
+	cv::remap( source, target, m_map1, m_map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+}
+
+
+void UndistortionMap::remap( const cv::UMat& source, cv::UMat target ) const
+{
+	{
+		boost::mutex::scoped_lock l( m_uploadMutex );
+		if ( m_uMapX.empty() )
+		{
+			m_mapX.copyTo( m_uMapX );
+			m_mapY.copyTo( m_uMapY );
+		}
+	}
+	cv::remap( source, target, m_uMapX, m_uMapY, cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+}
+
+
+void UndistortionMap::remap( const cv::Mat& source, cv::Mat target, const cv::Rect& targetRegion ) const
+{
+	cv::remap( source, target, m_map1( targetRegion ), m_map2( targetRegion ), cv::INTER_LINEAR, cv::BORDER_CONSTANT );
+}
+
+
+cv::Rect UndistortionMap::sourceRegion( const cv::Rect& targetRegion ) const
+{
+	double minX, maxX, minY, maxY;
+	cv::minMaxLoc( m_mapX( targetRegion ), &minX, &maxX );
+	cv::minMaxLoc( m_mapY( targetRegion ), &minY, &maxY );
+
+	// bilinear interpolation also reads the next pixel
+	cv::Rect region( int( cvFloor( minX ) ), int( cvFloor( minY ) ), 
+		int( cvFloor( maxX ) - cvFloor( minX ) ) + 2, int( cvFloor( maxY ) - cvFloor( minY ) ) + 2 );
+	return region & cv::Rect( cv::Point( 0, 0 ), m_sourceSize );
+}
+
+
+bool UndistortionMap::hasDistortion( const Math::CameraIntrinsics< double >& intrinsics )
+{
+	for ( std::size_t i = 0; i < intrinsics.radial_size && i < 6; i++ )
+		if ( intrinsics.radial_params( i ) != 0.0 )
+			return true;
+	return intrinsics.tangential_params( 0 ) != 0.0 || intrinsics.tangential_params( 1 ) != 0.0;
+}
+
+
+
+UndistortionMapCache::UndistortionMapCache( const Math::CameraIntrinsics< double >& intrinsics )
+	: m_bPending( false )
+	, m_bStop( false )
+{
+	boost::shared_ptr< Snapshot > pSnapshot( new Snapshot );
+	pSnapshot->intrinsics = intrinsics;
+	pSnapshot->bDistortion = UndistortionMap::hasDistortion( intrinsics );
+	m_pSnapshot = pSnapshot;
+}
+
+
+UndistortionMapCache::~UndistortionMapCache()
+{
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		m_bStop = true;
+	}
+	m_cond.notify_all();
+	if ( m_pThread )
+		m_pThread->join();
+}
+
+
+boost::shared_ptr< UndistortionMap > UndistortionMapCache::get( cv::Size sourceSize, cv::Size targetSize, bool bottomUp, bool bResample )
+{
+	boost::shared_ptr< const Snapshot > pSnapshot = boost::atomic_load( &m_pSnapshot );
+	if ( !pSnapshot->bDistortion && !bResample )
+		return boost::shared_ptr< UndistortionMap >();
+
+	for ( std::size_t i = 0; i < pSnapshot->maps.size(); i++ )
+		if ( pSnapshot->maps[ i ]->matches( sourceSize, targetSize, bottomUp ) )
+			return pSnapshot->maps[ i ];
+
+	// first frame of this size: build it here and add it to the snapshot
+	boost::shared_ptr< UndistortionMap > pMap( new UndistortionMap( pSnapshot->intrinsics, sourceSize, targetSize, bottomUp ) );
+	for ( ; ; )
+	{
+		boost::shared_ptr< Snapshot > pExtended( new Snapshot( *pSnapshot ) );
+		pExtended->maps.push_back( pMap );
+		boost::shared_ptr< const Snapshot > pExpected = pSnapshot;
+		if ( boost::atomic_compare_exchange( &m_pSnapshot, &pExpected, boost::shared_ptr< const Snapshot >( pExtended ) ) )
+			break;
+
+		// another thread published in the meantime; if the intrinsics changed, our map is stale anyway
+		pSnapshot = pExpected;
+		if ( !pSnapshot->bDistortion && !bResample )
+			return boost::shared_ptr< UndistortionMap >();
+		for ( std::size_t i = 0; i < pSnapshot->maps.size(); i++ )
+			if ( pSnapshot->maps[ i ]->matches( sourceSize, targetSize, bottomUp ) )
+				return pSnapshot->maps[ i ];
+		pMap.reset( new UndistortionMap( pSnapshot->intrinsics, sourceSize, targetSize, bottomUp ) );
+	}
+	return pMap;
+}
+
+
+Math::CameraIntrinsics< double > UndistortionMapCache::intrinsics() const
+{
+	return boost::atomic_load( &m_pSnapshot )->intrinsics;
+}
+
+
+void UndistortionMapCache::update( const Math::CameraIntrinsics< double >& intrinsics )
+{
+	{
+		boost::mutex::scoped_lock l( m_mutex );
+		m_pending = intrinsics;
+		m_bPending = true;
+		if ( !m_pThread )
+			m_pThread.reset( new boost::thread( boost::bind( &UndistortionMapCache::buildThread, this ) ) );
+	}
+	m_cond.notify_one();
+}
+
+
+void UndistortionMapCache::buildThread()
+{
+	for ( ; ; )
+	{
+		Math::CameraIntrinsics< double > intrinsics;
+		{
+			boost::mutex::scoped_lock l( m_mutex );
+			while ( !m_bStop && !m_bPending )
+				m_cond.wait( l );
+			if ( m_bStop )
+				return;
+			intrinsics = m_pending;
+			m_bPending = false;
+		}
+
+		boost::shared_ptr< Snapshot > pSnapshot( new Snapshot );
+		pSnapshot->intrinsics = intrinsics;
+		pSnapshot->bDistortion = UndistortionMap::hasDistortion( intrinsics );
+
+		// prebuild the tables for all sizes in use, the capture path keeps the old ones meanwhile.
+		// Without distortion, only the tables that resize bottom-up images are still needed
+		boost::shared_ptr< const Snapshot > pCurrent = boost::atomic_load( &m_pSnapshot );
+		for ( std::size_t i = 0; i < pCurrent->maps.size(); i++ )
+		{
+			const UndistortionMap& old = *pCurrent->maps[ i ];
+			if ( pSnapshot->bDistortion || ( old.bottomUp() && old.sourceSize() != old.targetSize() ) )
+				pSnapshot->maps.push_back( boost::shared_ptr< UndistortionMap >( new UndistortionMap( intrinsics,
+					old.sourceSize(), old.targetSize(), old.bottomUp() ) ) );
+		}
+
+		boost::atomic_store( &m_pSnapshot, boost::shared_ptr< const Snapshot >( pSnapshot ) );
+	}
+}
+
+} } // namespace Ubitrack::Drivers
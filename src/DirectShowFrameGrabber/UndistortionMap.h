@@ -0,0 +1,171 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup vision_components
+ * @file
+ * Remap tables combining downscaling and undistortion
+ */
+
+#ifndef __UBITRACK_DRIVERS_UNDISTORTIONMAP_H_INCLUDED__
+#define __UBITRACK_DRIVERS_UNDISTORTIONMAP_H_INCLUDED__
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <utMath/CameraIntrinsics.h>
+
+namespace Ubitrack { namespace Drivers {
+
+/**
+ * A remap table that resizes an image from the source to the target size and removes the lens
+ * distortion in the same pass. Bottom-up sources are flipped as well, the target is always top-down.
+ *
+ * The intrinsics refer to the target size, as they did when the image was first resized and then
+ * undistorted. Without distortion, the table only resizes and flips. The tables are built once in
+ * the constructor, remapping is thread-safe.
+ */
+class UndistortionMap
+	: private boost::noncopyable
+{
+public:
+
+	/**
+	 * builds the tables.
+	 * @param bottomUp true if the source rows are stored bottom-up (origin == 1)
+	 */
+	UndistortionMap( const Math::CameraIntrinsics< double >& intrinsics, cv::Size sourceSize, cv::Size targetSize, bool bottomUp );
+
+	/** true if the map was built for these parameters */
+	bool matches( cv::Size sourceSize, cv::Size targetSize, bool bottomUp ) const
+	{ return sourceSize == m_sourceSize && targetSize == m_targetSize && bottomUp == m_bottomUp; }
+
+	cv::Size sourceSize() const
+	{ return m_sourceSize; }
+
+	cv::Size targetSize() const
+	{ return m_targetSize; }
+
+	bool bottomUp() const
+	{ return m_bottomUp; }
+
+	/** remaps on the CPU, \c target must be allocated with the target size */
+	void remap( const cv::Mat& source, cv::Mat target ) const;
+
+	/** remaps with OpenCL, \c target must be allocated with the target size */
+	void remap( const cv::UMat& source, cv::UMat target ) const;
+
+	/**
+	 * remaps only a region of the target image, \c target must be allocated with the region size.
+	 * Only the source pixels inside \c sourceRegion( targetRegion ) are read.
+	 */
+	void remap( const cv::Mat& source, cv::Mat target, const cv::Rect& targetRegion ) const;
+
+	/** bounding box of the source pixels needed for a region of the target image, including the interpolation neighbours */
+	cv::Rect sourceRegion( const cv::Rect& targetRegion ) const;
+
+	/** true if the intrinsics have any distortion coefficients */
+	static bool hasDistortion( const Math::CameraIntrinsics< double >& intrinsics );
+
+protected:
+	cv::Size m_sourceSize;
+	cv::Size m_targetSize;
+	bool m_bottomUp;
+
+	/** fixed point tables for the CPU */
+	cv::Mat m_map1;
+	cv::Mat m_map2;
+
+	/** floating point tables, uploaded on first use */
+	cv::Mat m_mapX;
+	cv::Mat m_mapY;
+	mutable cv::UMat m_uMapX;
+	mutable cv::UMat m_uMapY;
+	mutable boost::mutex m_uploadMutex;
+};
+
+
+/**
+ * Remap tables for the current intrinsics, with non-blocking updates.
+ *
+ * The intrinsics and their tables form an immutable snapshot that readers take with an atomic
+ * shared_ptr load. New intrinsics are handed to a background thread which builds tables for
+ * all sizes already in use and then publishes the new snapshot, so the capture path never waits
+ * for a table to be rebuilt. Bursts of updates are coalesced, only the latest one is built.
+ */
+class UndistortionMapCache
+	: private boost::noncopyable
+{
+public:
+
+	UndistortionMapCache( const Math::CameraIntrinsics< double >& intrinsics );
+
+	/** stops the background thread */
+	~UndistortionMapCache();
+
+	/**
+	 * remap table for the given sizes. If the intrinsics have no distortion, a table is only returned
+	 * if \c bResample is set, it then just resizes and flips, otherwise the pointer is empty.
+	 * Only the first request for a new size builds its table in the calling thread.
+	 */
+	boost::shared_ptr< UndistortionMap > get( cv::Size sourceSize, cv::Size targetSize, bool bottomUp, bool bResample = false );
+
+	/** intrinsics of the current snapshot */
+	Math::CameraIntrinsics< double > intrinsics() const;
+
+	/** schedules new intrinsics, returns immediately */
+	void update( const Math::CameraIntrinsics< double >& intrinsics );
+
+protected:
+
+	struct Snapshot
+	{
+		Math::CameraIntrinsics< double > intrinsics;
+		bool bDistortion;
+		std::vector< boost::shared_ptr< UndistortionMap > > maps;
+	};
+
+	/** background thread method */
+	void buildThread();
+
+	/** current snapshot, only accessed with boost::atomic_load/atomic_store */
+	boost::shared_ptr< const Snapshot > m_pSnapshot;
+
+	boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+	Math::CameraIntrinsics< double > m_pending;
+	bool m_bPending;
+	bool m_bStop;
+	boost::scoped_ptr< boost::thread > m_pThread;
+};
+
+} } // namespace Ubitrack::Drivers
+
+#endif
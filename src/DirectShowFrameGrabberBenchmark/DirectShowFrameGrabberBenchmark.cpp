@@ -0,0 +1,439 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @file
+ * Standalone benchmark of the DirectShowFrameGrabber image pipeline.
+ *
+ * Replays recorded (any file cv::VideoCapture can open) or synthetic frames through the
+ * FramePipeline of the component for all combinations of sample format, resolution, connected
+ * outputs and GPU upload, and reports frame rate, latency percentiles and buffer allocations
+ * per frame. With \c --live, a dataflow containing the real component is run instead; set the
+ * \c statisticsInterval attribute of the frame grabber to get its timing summary in the log.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <utMath/CameraIntrinsics.h>
+#include <utUtil/Logging.h>
+#include <utVision/Image.h>
+#include <utVision/OpenCLManager.h>
+#ifdef HAVE_UTFACADE
+	#include <utFacade/AdvancedFacade.h>
+#endif
+
+#include "FramePipeline.h"
+
+using namespace Ubitrack;
+using namespace Ubitrack::Drivers;
+
+namespace {
+
+/** sink that only counts and releases the images, like the ports without consumers would */
+class BenchmarkSink
+	: public FramePipeline::Sink
+{
+public:
+	BenchmarkSink( bool bRaw, bool bColor, bool bGrey )
+	{
+		m_connected[ FramePipeline::OUTPUT_RAW ] = bRaw;
+		m_connected[ FramePipeline::OUTPUT_COLOR ] = bColor;
+		m_connected[ FramePipeline::OUTPUT_GREY ] = bGrey;
+		m_connected[ FramePipeline::OUTPUT_PYRAMID ] = false;
+	}
+
+	bool isConnected( FramePipeline::Output output ) const
+	{ return m_connected[ output ]; }
+
+	void send( FramePipeline::Output, boost::shared_ptr< Vision::Image > )
+	{}
+
+protected:
+	bool m_connected[ FramePipeline::OUTPUT_COUNT ];
+};
+
+struct OutputCombination
+{
+	const char* name;
+	bool bRaw;
+	bool bColor;
+	bool bGrey;
+};
+
+const OutputCombination outputCombinations[] = {
+	{ "RAW", true, false, false },
+	{ "Color", false, true, false },
+	{ "Grey", false, false, true },
+	{ "Color+Grey", false, true, true },
+	{ "RAW+Color+Grey", true, true, true }
+};
+
+/** encodes a BGR frame the way the camera would deliver it */
+void encodeSample( SampleFormat format, const cv::Mat& bgr, std::vector< uchar >& sample )
+{
+	int w = bgr.cols;
+	int h = bgr.rows;
+	switch ( format )
+	{
+	case SAMPLE_RGB24:
+	{
+		// DirectShow RGB24 is bottom-up
+		sample.resize( w * h * 3 );
+		cv::Mat flipped( h, w, CV_8UC3, &sample[ 0 ] );
+		cv::flip( bgr, flipped, 0 );
+		break;
+	}
+	case SAMPLE_YUY2:
+	{
+		cv::Mat yuv;
+		cv::cvtColor( bgr, yuv, cv::COLOR_BGR2YUV );
+		sample.resize( w * h * 2 );
+		for ( int y = 0; y < h; y++ )
+		{
+			const uchar* pSrc = yuv.ptr( y );
+			uchar* pDst = &sample[ y * w * 2 ];
+			for ( int x = 0; x + 1 < w; x += 2, pSrc += 6, pDst += 4 )
+			{
+				pDst[ 0 ] = pSrc[ 0 ];
+				pDst[ 1 ] = uchar( ( pSrc[ 1 ] + pSrc[ 4 ] + 1 ) / 2 );
+				pDst[ 2 ] = pSrc[ 3 ];
+				pDst[ 3 ] = uchar( ( pSrc[ 2 ] + pSrc[ 5 ] + 1 ) / 2 );
+			}
+		}
+		break;
+	}
+	case SAMPLE_NV12:
+	{
+		cv::Mat i420;
+		cv::cvtColor( bgr, i420, cv::COLOR_BGR2YUV_I420 );
+		sample.resize( w * h * 3 / 2 );
+		memcpy( &sample[ 0 ], i420.data, w * h );
+		const uchar* pU = i420.data + w * h;
+		const uchar* pV = pU + ( w / 2 ) * ( h / 2 );
+		uchar* pUV = &sample[ w * h ];
+		for ( int i = 0; i < ( w / 2 ) * ( h / 2 ); i++ )
+		{
+			pUV[ 2 * i ] = pU[ i ];
+			pUV[ 2 * i + 1 ] = pV[ i ];
+		}
+		break;
+	}
+	case SAMPLE_MJPG:
+		cv::imencode( ".jpg", bgr, sample );
+		break;
+	default:
+		sample.clear();
+	}
+}
+
+/** a moderately distorted camera, in Ubitrack conventions, for the given image size */
+Math::CameraIntrinsics< double > syntheticIntrinsics( cv::Size size, bool bDistortion )
+{
+	Math::CameraIntrinsics< double > intrinsics;
+	Math::Matrix< double, 3, 3 > K = Math::Matrix< double, 3, 3 >::identity();
+	K( 0, 0 ) = 0.9 * size.width;
+	K( 1, 1 ) = 0.9 * size.width;
+	K( 0, 2 ) = -0.5 * ( size.width - 1 );
+	K( 1, 2 ) = -0.5 * ( size.height - 1 );
+	K( 2, 2 ) = -1.0;
+	intrinsics.matrix = K;
+
+	intrinsics.radial_size = 2;
+	for ( int i = 0; i < 6; i++ )
+		intrinsics.radial_params( i ) = 0.0;
+	intrinsics.tangential_params( 0 ) = 0.0;
+	intrinsics.tangential_params( 1 ) = 0.0;
+	if ( bDistortion )
+	{
+		intrinsics.radial_params( 0 ) = -0.25;
+		intrinsics.radial_params( 1 ) = 0.08;
+		intrinsics.tangential_params( 0 ) = 0.001;
+		intrinsics.tangential_params( 1 ) = -0.0005;
+	}
+	return intrinsics;
+}
+
+cv::Size parseSize( const std::string& s )
+{
+	cv::Size size( 0, 0 );
+	std::size_t x = s.find( 'x' );
+	if ( x != std::string::npos )
+		size = cv::Size( atoi( s.substr( 0, x ).c_str() ), atoi( s.substr( x + 1 ).c_str() ) );
+	return size;
+}
+
+double percentile( std::vector< double >& values, double p )
+{
+	if ( values.empty() )
+		return 0;
+	std::size_t n = std::size_t( p * ( values.size() - 1 ) + 0.5 );
+	std::nth_element( values.begin(), values.begin() + n, values.end() );
+	return values[ n ];
+}
+
+void usage()
+{
+	std::cout << "usage: DirectShowFrameGrabberBenchmark [options]\n"
+		"  -n <frames>        frames per run (default 300)\n"
+		"  -i <file>          replay frames from a video or image file instead of synthetic frames\n"
+		"  -s <WxH,...>       sample resolutions (default 640x480,1280x720,1920x1080)\n"
+		"  -o <WxH>           desired output size, larger samples are downscaled (default: sample size)\n"
+		"  -f <fmt,...>       sample formats (default RGB24,YUY2,NV12,MJPG)\n"
+		"  -b <factor>        bin factor x factor pixels, overrides -o\n"
+		"  -r <x,y,w,h>       only process this region of the output image\n"
+		"  --gpu              additionally run with GPU upload\n"
+		"  --no-undistort     skip the undistortion\n"
+		"  -t <threads>       process the CPU stages in row bands with this many pool threads (default 0)\n"
+		"  --bands <n>        row bands per frame with -t (default 2 x (threads + 1))\n"
+		"  --live <dfg>       run a dataflow with a live DirectShowFrameGrabber\n"
+		"  --components <dir> component directory for --live\n"
+		"  --seconds <n>      duration of the --live run (default 10)\n";
+}
+
+std::vector< std::string > split( const std::string& s )
+{
+	std::vector< std::string > parts;
+	std::istringstream is( s );
+	std::string part;
+	while ( std::getline( is, part, ',' ) )
+		if ( !part.empty() )
+			parts.push_back( part );
+	return parts;
+}
+
+} // anonymous namespace
+
+
+int main( int argc, char** argv )
+{
+	int nFrames = 300;
+	std::string inputFile;
+	std::vector< std::string > sizes = split( "640x480,1280x720,1920x1080" );
+	std::vector< std::string > formats = split( "RGB24,YUY2,NV12,MJPG" );
+	cv::Size outputSize( 0, 0 );
+	int binning = 1;
+	cv::Rect region;
+	bool bGPU = false;
+	bool bDistortion = true;
+	int bandThreads = 0;
+	int bands = 0;
+	std::string liveDataflow;
+	std::string componentDir;
+	int liveSeconds = 10;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		std::string arg( argv[ i ] );
+		bool bHasValue = i + 1 < argc;
+		if ( arg == "-n" && bHasValue )
+			nFrames = atoi( argv[ ++i ] );
+		else if ( arg == "-i" && bHasValue )
+			inputFile = argv[ ++i ];
+		else if ( arg == "-s" && bHasValue )
+			sizes = split( argv[ ++i ] );
+		else if ( arg == "-o" && bHasValue )
+			outputSize = parseSize( argv[ ++i ] );
+		else if ( arg == "-f" && bHasValue )
+			formats = split( argv[ ++i ] );
+		else if ( arg == "-b" && bHasValue )
+			binning = atoi( argv[ ++i ] );
+		else if ( arg == "-r" && bHasValue )
+		{
+			std::vector< std::string > values = split( argv[ ++i ] );
+			if ( values.size() == 4 )
+				region = cv::Rect( atoi( values[ 0 ].c_str() ), atoi( values[ 1 ].c_str() ), 
+					atoi( values[ 2 ].c_str() ), atoi( values[ 3 ].c_str() ) );
+		}
+		else if ( arg == "--gpu" )
+			bGPU = true;
+		else if ( arg == "--no-undistort" )
+			bDistortion = false;
+		else if ( arg == "-t" && bHasValue )
+			bandThreads = atoi( argv[ ++i ] );
+		else if ( arg == "--bands" && bHasValue )
+			bands = atoi( argv[ ++i ] );
+		else if ( arg == "--live" && bHasValue )
+			liveDataflow = argv[ ++i ];
+		else if ( arg == "--components" && bHasValue )
+			componentDir = argv[ ++i ];
+		else if ( arg == "--seconds" && bHasValue )
+			liveSeconds = atoi( argv[ ++i ] );
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	Util::initLogging();
+
+	if ( !liveDataflow.empty() )
+	{
+#ifdef HAVE_UTFACADE
+		Facade::AdvancedFacade facade( componentDir );
+		facade.loadDataflow( liveDataflow );
+		facade.startDataflow();
+		boost::this_thread::sleep( boost::posix_time::seconds( liveSeconds ) );
+		facade.stopDataflow();
+		return 0;
+#else
+		std::cerr << "--live requires the benchmark to be built with utfacade" << std::endl;
+		return 1;
+#endif
+	}
+
+	// source frames
+	std::vector< cv::Mat > sourceFrames;
+	if ( !inputFile.empty() )
+	{
+		cv::VideoCapture capture( inputFile );
+		cv::Mat frame;
+		while ( sourceFrames.size() < 100 && capture.read( frame ) )
+			sourceFrames.push_back( frame.clone() );
+		if ( sourceFrames.empty() )
+		{
+			std::cerr << "Unable to read frames from " << inputFile << std::endl;
+			return 1;
+		}
+	}
+	else
+	{
+		cv::Mat frame( 1080, 1920, CV_8UC3 );
+		cv::randu( frame, cv::Scalar::all( 0 ), cv::Scalar::all( 255 ) );
+		cv::GaussianBlur( frame, frame, cv::Size( 9, 9 ), 3 );
+		sourceFrames.push_back( frame );
+	}
+
+	std::vector< bool > gpuModes( 1, false );
+	if ( bGPU )
+	{
+		Vision::OpenCLManager& oclManager = Vision::OpenCLManager::singleton();
+		if ( oclManager.isEnabled() )
+		{
+			oclManager.activate();
+			if ( oclManager.isInitialized() )
+				gpuModes.push_back( true );
+		}
+		if ( gpuModes.size() == 1 )
+			std::cerr << "OpenCL is not available, skipping the GPU runs" << std::endl;
+	}
+
+	std::cout << std::left << std::setw( 8 ) << "format" << std::setw( 11 ) << "size" << std::setw( 16 ) << "outputs" <<
+		std::setw( 5 ) << "gpu" << std::right << std::setw( 10 ) << "fps" << std::setw( 10 ) << "p50 ms" <<
+		std::setw( 10 ) << "p99 ms" << std::setw( 12 ) << "allocs/frm" << std::endl;
+
+	for ( std::size_t iFormat = 0; iFormat < formats.size(); iFormat++ )
+	for ( std::size_t iSize = 0; iSize < sizes.size(); iSize++ )
+	{
+		SampleFormat format = sampleFormatFromName( formats[ iFormat ] );
+		cv::Size size = parseSize( sizes[ iSize ] );
+		if ( format == SAMPLE_UNKNOWN || size.width <= 0 || size.height <= 0 )
+		{
+			std::cerr << "Skipping " << formats[ iFormat ] << " " << sizes[ iSize ] << std::endl;
+			continue;
+		}
+
+		// pre-encode the samples, so that only the pipeline is measured
+		std::vector< std::vector< uchar > > samples( sourceFrames.size() );
+		for ( std::size_t i = 0; i < sourceFrames.size(); i++ )
+		{
+			cv::Mat resized;
+			cv::resize( sourceFrames[ i ], resized, size );
+			encodeSample( format, resized, samples[ i ] );
+		}
+
+		cv::Size targetSize = outputSize.width > 0 && outputSize.height > 0 ? outputSize : size;
+		if ( binning > 1 )
+			targetSize = cv::Size( size.width / binning, size.height / binning );
+
+		for ( std::size_t iOutputs = 0; iOutputs < sizeof( outputCombinations ) / sizeof( outputCombinations[ 0 ] ); iOutputs++ )
+		for ( std::size_t iGPU = 0; iGPU < gpuModes.size(); iGPU++ )
+		{
+			const OutputCombination& outputs = outputCombinations[ iOutputs ];
+			boost::shared_ptr< ImagePool > pImagePool( new ImagePool( 4 ) );
+			UndistortionMapCache undistortionMaps( syntheticIntrinsics( targetSize, bDistortion ) );
+			FrameStatistics statistics;
+			FramePipeline pipeline( pImagePool, undistortionMaps, statistics );
+			pipeline.setSampleFormat( format, size.width, size.height );
+			pipeline.setDesiredSize( outputSize.width, outputSize.height );
+			pipeline.setGPUUpload( gpuModes[ iGPU ] );
+			pipeline.setBinning( binning );
+			pipeline.setRegionOfInterest( region );
+			if ( bandThreads > 0 )
+				pipeline.setBandPool( BandPool::get( bandThreads ), bands > 0 ? bands : 2 * ( bandThreads + 1 ) );
+			BenchmarkSink sink( outputs.bRaw, outputs.bColor, outputs.bGrey );
+
+			// warm up the pool and the remap tables
+			const int nWarmup = 10;
+			std::vector< double > latencies;
+			latencies.reserve( nFrames );
+			unsigned long allocationsBefore = 0;
+			int64 startTicks = 0;
+			for ( int iFrame = 0; iFrame < nWarmup + nFrames; iFrame++ )
+			{
+				if ( iFrame == nWarmup )
+				{
+					allocationsBefore = pImagePool->allocations();
+					startTicks = cv::getTickCount();
+				}
+
+				std::vector< uchar >& sample = samples[ iFrame % samples.size() ];
+				Vision::Image::ImageFormatProperties fmt;
+				int imageWidth, imageHeight;
+				sampleImageFormat( format, size.width, size.height, true, sample.size(), fmt, imageWidth, imageHeight );
+				boost::shared_ptr< Vision::Image > pSample( new Vision::Image( imageWidth, imageHeight, fmt, &sample[ 0 ] ) );
+
+				int64 t0 = cv::getTickCount();
+				pipeline.process( pSample, true, sink );
+				if ( iFrame >= nWarmup )
+					latencies.push_back( ( cv::getTickCount() - t0 ) * 1000.0 / cv::getTickFrequency() );
+			}
+			double seconds = ( cv::getTickCount() - startTicks ) / cv::getTickFrequency();
+			unsigned long allocations = pImagePool->allocations() - allocationsBefore;
+
+			std::cout << std::left << std::setw( 8 ) << formats[ iFormat ] << std::setw( 11 ) << sizes[ iSize ] << 
+				std::setw( 16 ) << outputs.name << std::setw( 5 ) << ( gpuModes[ iGPU ] ? "on" : "off" ) << std::right << 
+				std::fixed << std::setprecision( 1 ) << std::setw( 10 ) << ( seconds > 0 ? nFrames / seconds : 0 ) << 
+				std::setprecision( 2 ) << std::setw( 10 ) << percentile( latencies, 0.5 ) << 
+				std::setw( 10 ) << percentile( latencies, 0.99 ) << 
+				std::setw( 12 ) << double( allocations ) / ( nFrames > 0 ? nFrames : 1 ) << std::endl;
+		}
+	}
+
+	return 0;
+}